@@ -0,0 +1,183 @@
+/* acct.c - per-process CPU accounting
+ *
+ * Every process carries a timestamp (acct_stamp) and the mode it is in. Each
+ * charge adds the time since the stamp to utime or stime. The mode flips at
+ * system call entry and exit; interrupts taken in user mode are charged as
+ * user time. Time spent by other processes or halted in sched_block is never
+ * charged: the clock of a process is restarted whenever it gets the CPU back.
+ */
+
+#include "acct.h"
+#include "lib.h"
+#include "clock.h"
+#include "smp.h"
+#include "scheduler.h"
+#include "terminal.h"
+
+/* acct_init_process
+ *   DESCRIPTION: zeroes the counters of a process that is about to start
+ *   INPUT: pcb -- new process
+ *          name -- program name
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: starts the process's clock in user mode
+ */
+void acct_init_process(pcb_t * pcb, const int8_t * name) {
+    pcb->utime_ns = 0;
+    pcb->stime_ns = 0;
+    pcb->nvcsw = 0;
+    pcb->nivcsw = 0;
+    pcb->nsyscalls = 0;
+    pcb->acct_mode = ACCT_USER;
+    strncpy((int8_t*)pcb->name, name, FILE_NAME_SIZE - 1);
+    pcb->name[FILE_NAME_SIZE - 1] = '\0';
+    pcb->acct_stamp = clock_ns();
+}
+
+/* acct_charge
+ *   DESCRIPTION: adds the time since the process was last charged to its user or
+ *                system time
+ *   INPUT: pcb -- the running process
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: moves acct_stamp to now
+ */
+void acct_charge(pcb_t * pcb) {
+    uint64_t now = clock_ns();
+
+    if (now > pcb->acct_stamp) {
+        if (pcb->acct_mode == ACCT_USER)
+            pcb->utime_ns += now - pcb->acct_stamp;
+        else
+            pcb->stime_ns += now - pcb->acct_stamp;
+    }
+    pcb->acct_stamp = now;
+}
+
+/* acct_resume
+ *   DESCRIPTION: the process runs again after others did (or the CPU was halted)
+ *   INPUT: pcb -- process getting the CPU
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: moves acct_stamp to now
+ */
+void acct_resume(pcb_t * pcb) {
+    pcb->acct_stamp = clock_ns();
+}
+
+/* acct_switch
+ *   DESCRIPTION: charges the process leaving the CPU and counts the switch as voluntary
+ *                if it blocked, as a preemption otherwise
+ *   INPUT: prev -- process leaving the CPU, NULL if the CPU was idle
+ *          next -- process getting the CPU
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void acct_switch(pcb_t * prev, pcb_t * next) {
+    if (prev != NULL) {
+        acct_charge(prev);
+        if (prev->state == PROC_BLOCKED)
+            prev->nvcsw++;
+        else
+            prev->nivcsw++;
+    }
+    acct_resume(next);
+}
+
+/* acct_syscall_enter
+ *   DESCRIPTION: the running process trapped into the kernel with int 0x80
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: charges user time, switches to system time
+ */
+void acct_syscall_enter(void) {
+    pcb_t * pcb;
+
+    if (terminal[cur_active_terminal].active != TERMINAL_ACTIVE)
+        return;
+    pcb = get_pcb_ptr();
+    acct_charge(pcb);
+    pcb->acct_mode = ACCT_SYS;
+    pcb->nsyscalls++;
+}
+
+/* acct_syscall_exit
+ *   DESCRIPTION: the running process is about to return to user space from a system call
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: charges system time, switches to user time
+ */
+void acct_syscall_exit(void) {
+    pcb_t * pcb;
+
+    if (terminal[cur_active_terminal].active != TERMINAL_ACTIVE)
+        return;
+    pcb = get_pcb_ptr();
+    acct_charge(pcb);
+    pcb->acct_mode = ACCT_USER;
+}
+
+/* proc_stats
+ *   DESCRIPTION: system call that reports every live process, lowest process number first.
+ *                The caller's own time is brought up to date first; processes running on
+ *                other CPUs are at most one tick behind.
+ *   INPUT: buf -- user buffer for an array of proc_stat_t
+ *          nbytes -- size of buf
+ *   OUTPUT: none
+ *   RETURN VALUE: number of entries copied, -1 on a bad buffer
+ *   SIDE EFFECT: none
+ */
+int32_t proc_stats(void* buf, int32_t nbytes) {
+    proc_stat_t * out = (proc_stat_t *)buf;
+    proc_stat_t stat;
+    pcb_t * pcb;
+    uint64_t ns;
+    uint32_t flags;
+    int32_t n = 0;
+    uint32_t i;
+
+    if (nbytes < (int32_t)sizeof(proc_stat_t) || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    cli_and_save(flags);
+    acct_charge(get_pcb_ptr());
+
+    for (i = 0; i < NUM_MAX_PROCESSES && (n + 1) * (int32_t)sizeof(proc_stat_t) <= nbytes; i++) {
+        if (pid_array[i] == FREE)
+            continue;
+        pcb = get_pcb_ptr_process(i);
+
+        stat.pid = pcb->process_number;
+        stat.parent = pcb->parent_process_number;
+        stat.term = (pcb->term != NULL) ? pcb->term->id : 0;
+        stat.level = pcb->sched_level;
+        stat.nvcsw = pcb->nvcsw;
+        stat.nivcsw = pcb->nivcsw;
+        stat.nsyscalls = pcb->nsyscalls;
+        memcpy(stat.name, pcb->name, FILE_NAME_SIZE);
+
+        ns = pcb->utime_ns;
+        div64_32(&ns, NS_PER_MS);
+        stat.utime_ms = (uint32_t)ns;
+        ns = pcb->stime_ns;
+        div64_32(&ns, NS_PER_MS);
+        stat.stime_ms = (uint32_t)ns;
+
+        if (pcb->term == NULL || (uint8_t)pcb->term->apn != pcb->process_number)
+            stat.state = PROC_STAT_WAITING;
+        else if (pcb->state == PROC_BLOCKED)
+            stat.state = PROC_STAT_BLOCKED;
+        else if (term_cpu[pcb->term->id] != NO_CPU)
+            stat.state = PROC_STAT_RUNNING;
+        else
+            stat.state = PROC_STAT_RUNNABLE;
+
+        memcpy(&out[n++], &stat, sizeof(proc_stat_t));
+    }
+    restore_flags(flags);
+
+    return n;
+}
@@ -0,0 +1,55 @@
+#ifndef ACCT_H_
+#define ACCT_H_
+
+#include "types.h"
+#include "syscalls.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+/* what the running process is charged for (pcb_t acct_mode) */
+#define ACCT_USER			0
+#define ACCT_SYS			1
+
+/* proc_stat_t state */
+#define PROC_STAT_RUNNING	0			/* on a CPU right now */
+#define PROC_STAT_RUNNABLE	1			/* waiting for a CPU */
+#define PROC_STAT_BLOCKED	2			/* asleep on a wait queue */
+#define PROC_STAT_WAITING	3			/* waiting for a child to halt */
+
+/* one process as reported by the proc_stats system call */
+typedef struct {
+	uint32_t pid;
+	uint32_t parent;
+	uint32_t term;
+	uint32_t state;
+	uint32_t level;				/* MLFQ level */
+	uint32_t utime_ms;
+	uint32_t stime_ms;
+	uint32_t nvcsw;				/* gave up the CPU by blocking */
+	uint32_t nivcsw;			/* preempted */
+	uint32_t nsyscalls;
+	uint8_t name[FILE_NAME_SIZE];
+} proc_stat_t;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* zeroes a new process's counters, it starts out in user mode */
+void acct_init_process(pcb_t * pcb, const int8_t * name);
+
+/* charges the time since the last charge to the mode the process is in */
+void acct_charge(pcb_t * pcb);
+
+/* restarts the clock of a process without charging it (it was not running) */
+void acct_resume(pcb_t * pcb);
+
+/* prev leaves the CPU (may be NULL), next starts running on it */
+void acct_switch(pcb_t * prev, pcb_t * next);
+
+/* system call entry and exit, called from system_call_handler */
+void acct_syscall_enter(void);
+void acct_syscall_exit(void);
+
+
+/* system call: copies a proc_stat_t per live process */
+int32_t proc_stats(void* buf, int32_t nbytes);
+
+#endif
@@ -0,0 +1,161 @@
+#include "apic.h"
+#include "clock.h"
+#include "lib.h"
+#include "paging.h"
+#include "scheduler.h"
+
+/* ============================== GLOBAL VARIABLES ======================START= */
+/* set by apic_init once the timer is calibrated and can drive the scheduler */
+uint8_t apic_timer_ready = 0;
+
+/* local APIC registers, identity mapped by apic_init */
+static volatile uint32_t * lapic = NULL;
+/* timer counts in one scheduler tick (1 / SET_FREQ seconds) */
+static uint32_t apic_counts_per_tick = 0;
+/* =============================================================================END= */
+
+
+/* apic_read / apic_write
+ *   DESCRIPTION: access a local APIC register by its byte offset
+ */
+static inline uint32_t apic_read(uint32_t reg) {
+    return lapic[reg >> 2];
+}
+
+static inline void apic_write(uint32_t reg, uint32_t val) {
+    lapic[reg >> 2] = val;
+}
+
+/* apic_init
+ *   DESCRIPTION: finds the local APIC through CPUID and IA32_APIC_BASE, maps its registers
+ *                uncached and software-enables it. The timer's rate depends on the bus clock,
+ *                so it is counted down over a CALIBRATE_MS window of PIT channel 2 first.
+ *                Device IRQs stay on the 8259 until smp_init finds an IO APIC.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: maps the 4MB region holding the APIC, busy-waits CALIBRATE_MS with interrupts off
+ */
+void apic_init(void) {
+    uint32_t a, b, c, d;
+    uint32_t lo, hi;
+    uint32_t flags;
+    uint32_t counted;
+
+    cpuid(CPUID_FEATURES, a, b, c, d);
+    if (!(d & CPUID_EDX_APIC))
+        return;
+
+    rdmsr(APIC_BASE_MSR, lo, hi);
+    mmio_map(lo & APIC_BASE_MASK);
+    lapic = (volatile uint32_t *)(lo & APIC_BASE_MASK);
+
+    apic_write(APIC_SVR, APIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    apic_write(APIC_TPR, 0);
+    apic_write(APIC_TIMER_DIV, APIC_DIV_16);
+    apic_write(APIC_LVT_TIMER, APIC_LVT_MASKED | APIC_TIMER_VECTOR);
+
+    cli_and_save(flags);
+    pit_delay_start(CALIBRATE_MS);
+    apic_write(APIC_TIMER_INIT, APIC_COUNT_MAX);
+    pit_delay_wait();
+    counted = APIC_COUNT_MAX - apic_read(APIC_TIMER_CUR);
+    apic_write(APIC_TIMER_INIT, 0);
+    restore_flags(flags);
+
+    apic_counts_per_tick = (counted / CALIBRATE_MS) * (1000 / SET_FREQ);
+    if (apic_counts_per_tick == 0)
+        return;
+
+    apic_write(APIC_LVT_TIMER, APIC_TIMER_VECTOR);
+    apic_timer_ready = 1;
+}
+
+/* apic_ap_init
+ *   DESCRIPTION: enables the local APIC of an application processor. Every APIC sits at the
+ *                same address and runs its timer off the same bus clock, so the mapping and
+ *                calibration apic_init did on the boot processor are reused.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: the timer is left stopped until tick_program arms it
+ */
+void apic_ap_init(void) {
+    apic_write(APIC_SVR, APIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    apic_write(APIC_TPR, 0);
+    apic_write(APIC_TIMER_DIV, APIC_DIV_16);
+    apic_write(APIC_LVT_TIMER, APIC_TIMER_VECTOR);
+}
+
+/* apic_id
+ *   DESCRIPTION: reads this processor's local APIC ID
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: APIC ID, 0 when there is no APIC
+ *   SIDE EFFECT: none
+ */
+uint32_t apic_id(void) {
+    if (lapic == NULL)
+        return 0;
+    return apic_read(APIC_ID) >> APIC_ID_SHIFT;
+}
+
+/* apic_send_ipi
+ *   DESCRIPTION: sends an inter-processor interrupt and waits until the APIC accepted it
+ *   INPUT: dest -- APIC ID of the target processor
+ *          icr -- low word of the interrupt command (delivery mode and vector)
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void apic_send_ipi(uint32_t dest, uint32_t icr) {
+    apic_write(APIC_ICR_HIGH, dest << APIC_ID_SHIFT);
+    apic_write(APIC_ICR_LOW, icr);
+    while (apic_read(APIC_ICR_LOW) & APIC_ICR_PENDING);
+}
+
+/* apic_eoi
+ *   DESCRIPTION: signals end of interrupt to the local APIC
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: the APIC may deliver the next interrupt
+ */
+void apic_eoi(void) {
+    apic_write(APIC_EOI, 0);
+}
+
+/* apic_timer_oneshot
+ *   DESCRIPTION: arms the timer to interrupt once on APIC_TIMER_VECTOR
+ *   INPUT: ticks -- scheduler ticks until the interrupt, at most apic_timer_max_ticks()
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: replaces any pending count
+ */
+void apic_timer_oneshot(uint32_t ticks) {
+    apic_write(APIC_LVT_TIMER, APIC_TIMER_VECTOR);
+    apic_write(APIC_TIMER_INIT, ticks * apic_counts_per_tick);
+}
+
+/* apic_timer_periodic
+ *   DESCRIPTION: makes the timer interrupt every scheduler tick, used when TICKLESS is off
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: replaces any pending count
+ */
+void apic_timer_periodic(void) {
+    apic_write(APIC_LVT_TIMER, APIC_TIMER_PERIODIC | APIC_TIMER_VECTOR);
+    apic_write(APIC_TIMER_INIT, apic_counts_per_tick);
+}
+
+/* apic_timer_max_ticks
+ *   DESCRIPTION: longest one-shot the 32 bit initial count register allows
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: number of scheduler ticks
+ *   SIDE EFFECT: none
+ */
+uint32_t apic_timer_max_ticks(void) {
+    return APIC_COUNT_MAX / apic_counts_per_tick;
+}
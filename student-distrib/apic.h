@@ -0,0 +1,70 @@
+#ifndef APIC_H_
+#define APIC_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+#define APIC_BASE_MSR		0x1B		/* IA32_APIC_BASE */
+#define APIC_BASE_MASK		0xFFFFF000	/* physical base address bits of IA32_APIC_BASE */
+
+/* local APIC register offsets */
+#define APIC_ID				0x020
+#define APIC_TPR			0x080		/* task priority */
+#define APIC_EOI			0x0B0
+#define APIC_SVR			0x0F0		/* spurious interrupt vector */
+#define APIC_LVT_TIMER		0x320
+#define APIC_TIMER_INIT		0x380		/* initial count */
+#define APIC_TIMER_CUR		0x390		/* current count */
+#define APIC_TIMER_DIV		0x3E0		/* divide configuration */
+#define APIC_ICR_LOW		0x300		/* interrupt command, writing it sends the IPI */
+#define APIC_ICR_HIGH		0x310		/* interrupt command destination */
+
+#define APIC_SVR_ENABLE		0x100		/* APIC software enable */
+#define APIC_LVT_MASKED		0x10000
+#define APIC_TIMER_PERIODIC	0x20000		/* LVT timer mode, one-shot when clear */
+#define APIC_DIV_16			0x3
+#define APIC_COUNT_MAX		0xFFFFFFFF
+#define APIC_ID_SHIFT		24			/* APIC ID and ICR destination live in bits 31:24 */
+#define APIC_ICR_PENDING	0x1000		/* delivery status: IPI not accepted yet */
+#define APIC_ICR_FIXED		0x4000		/* fixed delivery, level assert */
+
+#define APIC_TIMER_VECTOR		0x30	/* above the 8259's 0x20 ~ 0x2F */
+#define APIC_RESCHED_VECTOR		0x31	/* IPI: look at the run queue again */
+#define APIC_SPURIOUS_VECTOR	0xFF
+
+#ifndef ASM
+
+/* ======================================================================= */
+
+/* set by apic_init once the timer is calibrated and can drive the scheduler */
+extern uint8_t apic_timer_ready;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* map and enable the local APIC, calibrate its timer against the PIT */
+void apic_init(void);
+
+/* enable an application processor's local APIC with the boot processor's calibration */
+void apic_ap_init(void);
+
+/* local APIC ID of this processor */
+uint32_t apic_id(void);
+
+/* send an inter-processor interrupt (ICR low word icr) to the given APIC ID */
+void apic_send_ipi(uint32_t dest, uint32_t icr);
+
+/* signal end of interrupt to the local APIC */
+void apic_eoi(void);
+
+/* fire the timer interrupt once, after the given number of scheduler ticks */
+void apic_timer_oneshot(uint32_t ticks);
+
+/* fire the timer interrupt every scheduler tick */
+void apic_timer_periodic(void);
+
+/* longest one-shot in scheduler ticks */
+uint32_t apic_timer_max_ticks(void);
+
+#endif /* ASM */
+
+#endif
@@ -0,0 +1,158 @@
+#include "clock.h"
+#include "lib.h"
+#include "scheduler.h"
+
+/* ============================== GLOBAL VARIABLES ======================START= */
+/* set by clock_init when the TSC is usable */
+uint8_t clock_has_tsc = 0;
+/* TSC rate measured by clock_init */
+uint32_t tsc_khz = 0;
+
+/* TSC cycles to nanoseconds, scaled by 2^CLOCK_SHIFT */
+static uint32_t clock_mult = 0;
+/* TSC value clock_ns counts from */
+static uint64_t tsc_base = 0;
+/* =============================================================================END= */
+
+
+/* clock_init
+ *   DESCRIPTION: checks for a time stamp counter and measures its rate over a CALIBRATE_MS
+ *                window of PIT channel 2. The rate is turned into a multiplier so clock_ns
+ *                converts cycles to nanoseconds with a multiply and a shift.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: busy-waits CALIBRATE_MS with interrupts off, uses PIT channel 2
+ */
+void clock_init(void) {
+    uint32_t a, b, c, d;
+    uint32_t flags;
+    uint64_t start, end;
+    uint64_t scaled;
+    uint32_t delta;
+
+    cpuid(CPUID_FEATURES, a, b, c, d);
+    if (!(d & CPUID_EDX_TSC))
+        return;
+
+    cli_and_save(flags);
+    pit_delay_start(CALIBRATE_MS);
+    start = rdtsc();
+    pit_delay_wait();
+    end = rdtsc();
+    restore_flags(flags);
+
+    /* a few ms worth of cycles always fit 32 bits */
+    delta = (uint32_t)(end - start);
+    if (delta == 0)
+        return;
+
+    tsc_khz = delta / CALIBRATE_MS;
+    scaled = (uint64_t)(CALIBRATE_MS * NS_PER_MS) << CLOCK_SHIFT;
+    div64_32(&scaled, delta);
+    clock_mult = (uint32_t)scaled;
+
+    tsc_base = end;
+    clock_has_tsc = 1;
+}
+
+/* clock_ns
+ *   DESCRIPTION: monotonic time since clock_init. Falls back to the scheduler's tick
+ *                accounting (SET_FREQ resolution) on CPUs without a TSC.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: nanoseconds since boot
+ *   SIDE EFFECT: none
+ */
+uint64_t clock_ns(void) {
+    uint64_t cycles;
+    uint32_t lo, hi;
+
+    if (!clock_has_tsc)
+        return (uint64_t)tickless_stats.elapsed * (NS_PER_SEC / SET_FREQ);
+
+    /* split the 64 x 32 bit product so nothing overflows */
+    cycles = rdtsc() - tsc_base;
+    lo = (uint32_t)cycles;
+    hi = (uint32_t)(cycles >> 32);
+    return (((uint64_t)lo * clock_mult) >> CLOCK_SHIFT) +
+           (((uint64_t)hi * clock_mult) << (32 - CLOCK_SHIFT));
+}
+
+/* div64_32
+ *   DESCRIPTION: 64 by 32 bit division without libgcc: the high half is divided first and
+ *                its remainder carried into a divl on the low half.
+ *   INPUT: n -- dividend, replaced by the quotient
+ *          base -- divisor, must not be 0
+ *   OUTPUT: *n = *n / base
+ *   RETURN VALUE: *n % base
+ *   SIDE EFFECT: none
+ */
+uint32_t div64_32(uint64_t* n, uint32_t base) {
+    uint32_t hi = (uint32_t)(*n >> 32);
+    uint32_t lo = (uint32_t)(*n);
+    uint32_t q_hi, q_lo, rem;
+
+    q_hi = hi / base;
+    rem = hi % base;
+    asm("divl %4"
+        : "=a"(q_lo), "=d"(rem)
+        : "a"(lo), "d"(rem), "rm"(base));
+
+    *n = ((uint64_t)q_hi << 32) | q_lo;
+    return rem;
+}
+
+/* pit_delay_start
+ *   DESCRIPTION: loads PIT channel 2 in mode 0 so its output goes high after ms milliseconds.
+ *                Channel 2 is not wired to an IRQ, so this doesn't disturb the scheduler tick.
+ *   INPUT: ms -- length of the window, at most PIT_MAX_COUNT counts (~54 ms)
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: turns the speaker off and the channel 2 gate on
+ */
+void pit_delay_start(uint32_t ms) {
+    uint32_t count = (CLK_FREQ / 1000) * ms;
+
+    if (count > PIT_MAX_COUNT)
+        count = PIT_MAX_COUNT;
+
+    outb((inb(PIT_GATE_PORT) & ~PIT_SPEAKER_ON) | PIT_GATE_ON, PIT_GATE_PORT);
+    outb(PIT_CH2_ONESHOT, PIT_CMD_PORT);
+    outb(count & LSB_MASK, PIT_CHANNEL_2);
+    outb(count >> MSB_MASK, PIT_CHANNEL_2);
+}
+
+/* pit_delay_wait
+ *   DESCRIPTION: spins until PIT channel 2 reached terminal count
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void pit_delay_wait(void) {
+    while (!(inb(PIT_GATE_PORT) & PIT_CH2_OUT));
+}
+
+/* gettime
+ *   DESCRIPTION: system call that reports the time since boot
+ *   INPUT: buf -- user buffer for a timespec_t
+ *          nbytes -- size of buf
+ *   OUTPUT: none
+ *   RETURN VALUE: number of bytes copied, -1 on a bad buffer
+ *   SIDE EFFECT: none
+ */
+int32_t gettime(void* buf, int32_t nbytes) {
+    timespec_t ts;
+    uint64_t ns;
+
+    if (nbytes < (int32_t)sizeof(timespec_t) || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    ns = clock_ns();
+    ts.nsec = div64_32(&ns, NS_PER_SEC);
+    ts.sec = (uint32_t)ns;
+
+    memcpy(buf, &ts, sizeof(timespec_t));
+    return sizeof(timespec_t);
+}
@@ -0,0 +1,64 @@
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+#define CPUID_FEATURES		1			/* CPUID leaf with the feature flags */
+#define CPUID_EDX_TSC		(1 << 4)	/* time stamp counter present */
+#define CPUID_EDX_APIC		(1 << 9)	/* local APIC present */
+
+#define PIT_CHANNEL_2		0x42		/* data port of the PIT channel wired to the speaker gate */
+#define PIT_CH2_ONESHOT		0xB0		/* channel 2, lo/hi byte, mode 0 (interrupt on terminal count) */
+#define PIT_GATE_PORT		0x61		/* keyboard controller port B: channel 2 gate and output */
+#define PIT_GATE_ON			0x01		/* bit 0: channel 2 gate */
+#define PIT_SPEAKER_ON		0x02		/* bit 1: speaker data, kept off while calibrating */
+#define PIT_CH2_OUT			0x20		/* bit 5: channel 2 output, set once the count ran out */
+
+#define CALIBRATE_MS		10			/* length of the PIT window clocks are calibrated against */
+#define NS_PER_SEC			1000000000
+#define NS_PER_MS			1000000
+#define CLOCK_SHIFT			20			/* ns = (cycles * clock_mult) >> CLOCK_SHIFT */
+
+/* seconds and nanoseconds since boot, copied out by the gettime system call */
+typedef struct {
+	uint32_t sec;
+	uint32_t nsec;
+} timespec_t;
+
+/* ======================================================================= */
+
+/* set by clock_init when the TSC is usable */
+extern uint8_t clock_has_tsc;
+/* TSC rate measured by clock_init */
+extern uint32_t tsc_khz;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* Reads the time stamp counter */
+static inline uint64_t rdtsc(void)
+{
+	uint64_t val;
+	asm volatile("rdtsc" : "=A"(val));
+	return val;
+}
+
+/* calibrate the TSC against the PIT */
+void clock_init(void);
+
+/* nanoseconds since clock_init */
+uint64_t clock_ns(void);
+
+/* divides *n by base in place and returns the remainder */
+uint32_t div64_32(uint64_t* n, uint32_t base);
+
+/* starts a busy-wait window of ms milliseconds on PIT channel 2 */
+void pit_delay_start(uint32_t ms);
+
+/* spins until the window opened by pit_delay_start is over */
+void pit_delay_wait(void);
+
+/* system call: copy the time since boot to user space */
+int32_t gettime(void* buf, int32_t nbytes);
+
+#endif
@@ -0,0 +1,202 @@
+/* fpu.c - lazy x87/SSE context switching
+ *
+ * The kernel only touches the FPU between kernel_fpu_begin and kernel_fpu_end
+ * (memcpy's SSE path), so otherwise its registers only ever hold user state.
+ * Each CPU remembers which process the registers belong to (fpu_owner) and
+ * sets CR0.TS whenever something else runs. The first FPU or SSE instruction
+ * of that process then traps with #NM, and only then is the owner's state
+ * saved and the new one's loaded. A process that never uses the FPU never
+ * costs a save or a restore.
+ */
+
+#include "fpu.h"
+#include "lib.h"
+#include "clock.h"
+#include "smp.h"
+#include "syscalls.h"
+#include "idt.h"
+
+uint8_t fpu_has_fxsr = 0;
+uint8_t fpu_has_sse = 0;
+static uint8_t fpu_present = 0;
+
+/* one save area per process number */
+static fpu_area_t fpu_areas[NUM_MAX_PROCESSES];
+
+/* fpu_save
+ *   DESCRIPTION: stores the FPU registers into a process's save area
+ *   INPUT: process -- process number owning the registers
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: fnsave also reinitializes the x87 unit
+ */
+static void fpu_save(uint8_t process) {
+    if (fpu_has_fxsr)
+        asm volatile("fxsave %0" : "=m"(fpu_areas[process]));
+    else
+        asm volatile("fnsave %0" : "=m"(fpu_areas[process]));
+}
+
+/* fpu_restore
+ *   DESCRIPTION: loads the FPU registers from a process's save area
+ *   INPUT: process -- process number whose state to load
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: changes the FPU registers
+ */
+static void fpu_restore(uint8_t process) {
+    if (fpu_has_fxsr)
+        asm volatile("fxrstor %0" : : "m"(fpu_areas[process]));
+    else
+        asm volatile("frstor %0" : : "m"(fpu_areas[process]));
+}
+
+/* fpu_init
+ *   DESCRIPTION: enables the FPU on the calling CPU, and SSE when fxsave is there. TS is
+ *                left set so the first use traps. Without an FPU CR0.EM stays set and #NM
+ *                keeps panicking like before.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: writes CR0 and CR4, called once on every CPU
+ */
+void fpu_init(void) {
+    uint32_t a, b, c, d;
+    uint32_t cr0, cr4;
+
+    cpuid(CPUID_FEATURES, a, b, c, d);
+    if (!(d & CPUID_EDX_FPU))
+        return;
+
+    fpu_present = 1;
+    fpu_has_fxsr = (d & CPUID_EDX_FXSR) ? 1 : 0;
+
+    asm volatile("movl %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE | CR0_TS;
+    asm volatile("movl %0, %%cr0" : : "r"(cr0) : "memory");
+
+    if (fpu_has_fxsr) {
+        asm volatile("movl %%cr4, %0" : "=r"(cr4));
+        cr4 |= CR4_OSFXSR;
+        if (d & CPUID_EDX_SSE) {
+            cr4 |= CR4_OSXMMEXCPT;
+            fpu_has_sse = 1;
+        }
+        asm volatile("movl %0, %%cr4" : : "r"(cr4) : "memory");
+    }
+
+    cpu_this()->fpu_owner = FPU_NO_OWNER;
+}
+
+/* fpu_trap
+ *   DESCRIPTION: #NM handler. Saves the registers of the process that owned them, then
+ *                loads the running process's state, or a clean one the first time it
+ *                uses the FPU. Without an FPU this is still the fatal exception.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: clears CR0.TS, changes this CPU's fpu_owner
+ */
+void fpu_trap(void) {
+    cpu_t * cpu = cpu_this();
+    pcb_t * pcb = get_pcb_ptr();
+    uint32_t mxcsr = MXCSR_DEFAULT;
+
+    if (!fpu_present)
+        device_not_available();
+
+    clts();
+    if (cpu->fpu_owner == pcb->process_number)
+        return;
+
+    if (cpu->fpu_owner != FPU_NO_OWNER)
+        fpu_save(cpu->fpu_owner);
+
+    if (pcb->fpu_used) {
+        fpu_restore(pcb->process_number);
+    } else {
+        asm volatile("fninit");
+        if (fpu_has_fxsr)
+            asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+        pcb->fpu_used = 1;
+    }
+    cpu->fpu_owner = pcb->process_number;
+}
+
+/* fpu_switch
+ *   DESCRIPTION: called whenever a process starts or resumes on this CPU. TS is set unless
+ *                the registers already hold its state. With more than one CPU the owner
+ *                may next run elsewhere, so its state is saved right away rather than
+ *                left in this CPU's registers.
+ *   INPUT: process -- process number about to run
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: sets or clears CR0.TS
+ */
+void fpu_switch(uint8_t process) {
+    cpu_t * cpu = cpu_this();
+
+    if (cpu->fpu_owner == process) {
+        clts();
+        return;
+    }
+
+    if (smp_ncpus > 1 && cpu->fpu_owner != FPU_NO_OWNER) {
+        clts();
+        fpu_save(cpu->fpu_owner);
+        cpu->fpu_owner = FPU_NO_OWNER;
+    }
+    stts();
+}
+
+/* fpu_release
+ *   DESCRIPTION: drops a halting process's ownership so its number can be reused
+ *   INPUT: process -- process number that is going away
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: may change this CPU's fpu_owner
+ */
+void fpu_release(uint8_t process) {
+    cpu_t * cpu = cpu_this();
+
+    if (cpu->fpu_owner == process)
+        cpu->fpu_owner = FPU_NO_OWNER;
+}
+
+/* kernel_fpu_begin
+ *   DESCRIPTION: lets the kernel use the SSE registers. The state of the process that owns
+ *                them on this CPU is saved first, and it gets it back through #NM the next
+ *                time it uses the FPU. Interrupts are off until kernel_fpu_end, so nothing
+ *                else can use or switch the registers meanwhile; keep the section short.
+ *                Only call when fpu_has_sse is set.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: the flags to hand to kernel_fpu_end
+ *   SIDE EFFECT: clears CR0.TS, this CPU's fpu_owner becomes FPU_NO_OWNER
+ */
+uint32_t kernel_fpu_begin(void) {
+    cpu_t * cpu;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    cpu = cpu_this();
+    clts();
+    if (cpu->fpu_owner != FPU_NO_OWNER) {
+        fpu_save(cpu->fpu_owner);
+        cpu->fpu_owner = FPU_NO_OWNER;
+    }
+    return flags;
+}
+
+/* kernel_fpu_end
+ *   DESCRIPTION: ends a kernel_fpu_begin section; the next FPU use of any process traps
+ *   INPUT: flags -- returned by kernel_fpu_begin
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: sets CR0.TS, restores the interrupt flag
+ */
+void kernel_fpu_end(uint32_t flags) {
+    stts();
+    restore_flags(flags);
+}
@@ -0,0 +1,76 @@
+#ifndef FPU_H_
+#define FPU_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+#define CPUID_EDX_FPU		(1 << 0)	/* x87 on chip */
+#define CPUID_EDX_FXSR		(1 << 24)	/* fxsave / fxrstor */
+#define CPUID_EDX_SSE		(1 << 25)
+
+#define CR0_MP				(1 << 1)	/* wait / fwait honour TS */
+#define CR0_EM				(1 << 2)	/* no FPU, every FPU instruction traps */
+#define CR0_TS				(1 << 3)	/* task switched: next FPU/SSE instruction raises #NM */
+#define CR0_NE				(1 << 5)	/* report x87 errors through #MF */
+#define CR4_OSFXSR			(1 << 9)	/* fxsave / fxrstor and SSE instructions enabled */
+#define CR4_OSXMMEXCPT		(1 << 10)	/* unmasked SSE exceptions raise #XM */
+
+#define FPU_AREA_SIZE		512			/* fxsave image, fnsave needs only 108 bytes of it */
+#define FPU_AREA_ALIGN		16
+#define MXCSR_DEFAULT		0x1F80		/* all SSE exceptions masked, round to nearest */
+#define FPU_NO_OWNER		0xFF
+
+#ifndef ASM
+
+/* saved x87/MMX/SSE registers of one process */
+typedef struct {
+	uint8_t data[FPU_AREA_SIZE];
+} __attribute__((aligned(FPU_AREA_ALIGN))) fpu_area_t;
+
+/* ======================================================================= */
+
+/* set by fpu_init when the state is saved with fxsave (SSE usable) */
+extern uint8_t fpu_has_fxsr;
+/* set by fpu_init when the kernel may use SSE between kernel_fpu_begin and kernel_fpu_end */
+extern uint8_t fpu_has_sse;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* Clears CR0.TS so FPU instructions run without trapping */
+static inline void clts(void)
+{
+	asm volatile("clts" : : : "memory");
+}
+
+/* Sets CR0.TS so the next FPU instruction raises #NM */
+static inline void stts(void)
+{
+	asm volatile(
+		"movl %%cr0, %%eax;"
+		"orl %0, %%eax;"
+		"movl %%eax, %%cr0;"
+		:
+		: "i"(CR0_TS)
+		: "eax", "memory"
+		);
+}
+
+/* sets up CR0/CR4 of the calling CPU for lazy FPU/SSE switching */
+void fpu_init(void);
+
+/* #NM: hands the FPU to the running process, called from fpu_nm_handler */
+void fpu_trap(void);
+
+/* the process is about to run on this CPU: arms the #NM trap unless its state is loaded */
+void fpu_switch(uint8_t process);
+
+/* the process is going away: forget its state without saving it */
+void fpu_release(uint8_t process);
+
+/* brackets kernel code using SSE registers; interrupts stay off in between */
+uint32_t kernel_fpu_begin(void);
+void kernel_fpu_end(uint32_t flags);
+
+#endif /* ASM */
+
+#endif
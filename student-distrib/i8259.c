@@ -1,9 +1,14 @@
 /* i8259.c - Functions to interact with the 8259 interrupt controller
  * vim:ts=4 noexpandtab
+ *
+ * enable_irq, disable_irq and send_eoi go to the IO APIC instead once ioapic_init
+ * has taken the device interrupts over (see ioapic.c).
  */
 
 #include "i8259.h"
 #include "lib.h"
+#include "apic.h"
+#include "ioapic.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
 uint8_t master_mask = PIC_IRQ_MASK; /* IRQs 0-7  */
@@ -56,6 +61,11 @@ void enable_irq(uint32_t irq_num) {
 		// DEBUG: printf("IRQ NUM is out of bounds! \n");
 		return;
 	}
+
+	/* the 8259 is out of the picture once the IO APIC has taken over */
+	else if (ioapic_ready) {
+		ioapic_unmask(irq_num);
+	}
 	
 	/* IRQ # correspondung to SLAVE */
 	else if (irq_num > 7){ // slave IRQ is > 7
@@ -92,6 +102,10 @@ void disable_irq(uint32_t irq_num) {
 		// DEBUG: printf("IRQ NUM is out of bounds! \n");
 		return;
 	}
+
+	else if (ioapic_ready) {
+		ioapic_mask(irq_num);
+	}
 	
 	/* IRQ # correspondung to SLAVE */
 	else if (irq_num > 7){
@@ -129,6 +143,11 @@ void send_eoi(uint32_t irq_num) {
 		// DEBUG: printf("IRQ NUM is out of bounds! \n");
 		return;
 	}
+
+	/* IO APIC interrupts are acknowledged with one memory write to the local APIC */
+	else if (ioapic_ready) {
+		apic_eoi();
+	}
 	
 	/* IRQ # correspondung to SLAVE */
 	else if (irq_num > 7){ // slave IRQ is > 7
@@ -29,6 +29,10 @@
  * to declare the interrupt finished */
 #define EOI                 0x60
 
+/* Interrupt masks, a set bit masks the IRQ */
+extern uint8_t master_mask;
+extern uint8_t slave_mask;
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
@@ -3,6 +3,8 @@
 #include "i8259.h"
 #include "x86_desc.h"
 #include "interrupts.h"
+#include "apic.h"
+#include "serial.h"
 
 #define SYSCALL_VECTOR		0x80
 #define RTC_VECTOR			0x28
@@ -64,7 +66,7 @@ void init_idt(void)
     SET_IDT_ENTRY(idt[4],  &overflow);               //IDT 04
     SET_IDT_ENTRY(idt[5],  &bounds);                 //IDT 05
     SET_IDT_ENTRY(idt[6],  &invalid_op);             //IDT 06
-    SET_IDT_ENTRY(idt[7],  &device_not_available);   //IDT 07
+    SET_IDT_ENTRY(idt[7],  &fpu_nm_handler);         //IDT 07: lazy FPU switching (fpu.c)
     SET_IDT_ENTRY(idt[8],  &double_fault);           //IDT 08
     SET_IDT_ENTRY(idt[9],  &segment_overrun);        //IDT 09
     SET_IDT_ENTRY(idt[10], &invalid_TSS);            //IDT 10
@@ -86,6 +88,14 @@ void init_idt(void)
 	/*Keyboard Interrupt Handler - start in interrupts.S */
 	SET_IDT_ENTRY(idt[PIT_VECTOR], pit_handler);
 
+	/*COM1 Interrupt Handler - start in interrupts.S */
+	SET_IDT_ENTRY(idt[SERIAL_VECTOR], serial_handler);
+
+	/*Local APIC timer, reschedule IPI and spurious interrupts - start in interrupts.S */
+	SET_IDT_ENTRY(idt[APIC_TIMER_VECTOR], apic_timer_handler);
+	SET_IDT_ENTRY(idt[APIC_RESCHED_VECTOR], apic_resched_handler);
+	SET_IDT_ENTRY(idt[APIC_SPURIOUS_VECTOR], apic_spurious_handler);
+
 	/*System Call Interrupt Handler - start in interrupts.S */
 	SET_IDT_ENTRY(idt[SYSCALL_VECTOR], system_call_handler);
 
@@ -193,7 +203,7 @@ void invalid_op(void){
 
 /*
  * device_not_available
- *   DESCRIPTION: Handle exception when floating point unit is missing
+ *   DESCRIPTION: Handle exception when floating point unit is missing, reached through fpu_trap
  *   INPUTS: none
  *   OUTPUT: none
  *   RETURN VALUE: none
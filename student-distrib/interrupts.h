@@ -10,6 +10,21 @@ extern void rtc_handler();
 /* PIT interrupt asm wrapper */
 extern void pit_handler();
 
+/* COM1 interrupt asm wrapper */
+extern void serial_handler();
+
+/* local APIC timer interrupt asm wrapper */
+extern void apic_timer_handler();
+
+/* reschedule IPI asm wrapper */
+extern void apic_resched_handler();
+
+/* local APIC spurious interrupt asm wrapper */
+extern void apic_spurious_handler();
+
+/* device not available (#NM) asm wrapper, lazy FPU switching */
+extern void fpu_nm_handler();
+
 /* System Call asm wrapper */
 extern void system_call_handler();
 
@@ -0,0 +1,166 @@
+/* ioapic.c - IO APIC routing of the ISA device interrupts
+ *
+ * Once smp_init finds an IO APIC in the MP table, the keyboard, RTC, PIT and serial
+ * IRQs are delivered through it to the boot processor's local APIC on the vectors
+ * the 8259 used, and acknowledged with a single memory mapped EOI write. The 8259
+ * stays fully masked from then on; without an IO APIC (or local APIC) i8259.c keeps
+ * handling everything as before.
+ */
+
+#include "ioapic.h"
+#include "i8259.h"
+#include "lib.h"
+#include "paging.h"
+
+/* ============================== GLOBAL VARIABLES ======================START= */
+/* set once device interrupts come from the IO APIC instead of the 8259 */
+uint8_t ioapic_ready = 0;
+
+/* IO APIC registers, identity mapped by ioapic_init */
+static volatile uint32_t * ioapic = NULL;
+/* pin and polarity / trigger bits of each ISA IRQ, identity wired unless the MP table says otherwise */
+static uint8_t irq_pin[ISA_IRQS];
+static uint32_t irq_mode[ISA_IRQS];
+static uint8_t irq_routed = 0;
+/* redirection entries (low words) as last written, so masking needs no read back */
+static uint32_t irq_entry[ISA_IRQS];
+/* =============================================================================END= */
+
+
+/* ioapic_read / ioapic_write
+ *   DESCRIPTION: access an IO APIC internal register through the select / window pair
+ */
+static inline uint32_t ioapic_read(uint32_t reg) {
+    ioapic[IOAPIC_REGSEL >> 2] = reg;
+    return ioapic[IOAPIC_WIN >> 2];
+}
+
+static inline void ioapic_write(uint32_t reg, uint32_t val) {
+    ioapic[IOAPIC_REGSEL >> 2] = reg;
+    ioapic[IOAPIC_WIN >> 2] = val;
+}
+
+/* routes_reset
+ *   DESCRIPTION: every ISA IRQ on the pin of the same number, edge triggered and active high
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+static void routes_reset(void) {
+    uint32_t irq;
+
+    for (irq = 0; irq < ISA_IRQS; irq++) {
+        irq_pin[irq] = irq;
+        irq_mode[irq] = 0;
+    }
+    irq_routed = 1;
+}
+
+/* ioapic_route
+ *   DESCRIPTION: records an MP table interrupt entry for an ISA IRQ, e.g. QEMU wires the
+ *                PIT (IRQ 0) to pin 2. Bus default polarity and trigger mode are ISA's,
+ *                active high and edge.
+ *   INPUT: irq -- ISA IRQ
+ *          pin -- IO APIC input it arrives on
+ *          mp_flags -- polarity and trigger mode from the entry
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void ioapic_route(uint32_t irq, uint32_t pin, uint32_t mp_flags) {
+    if (!irq_routed)
+        routes_reset();
+    if (irq >= ISA_IRQS)
+        return;
+
+    irq_pin[irq] = pin;
+    irq_mode[irq] = 0;
+    if ((mp_flags & MP_IRQ_POLARITY_MASK) == MP_IRQ_POLARITY_LOW)
+        irq_mode[irq] |= IOAPIC_LOW_ACTIVE;
+    if ((mp_flags & MP_IRQ_TRIGGER_MASK) == MP_IRQ_TRIGGER_LEVEL)
+        irq_mode[irq] |= IOAPIC_LEVEL;
+}
+
+/* ioapic_init
+ *   DESCRIPTION: masks every IO APIC pin, points the ISA IRQs at the boot processor on
+ *                IRQ_VECTOR_BASE + irq and unmasks those the 8259 had enabled. Then the
+ *                8259 is masked for good and, if the board has an IMCR, disconnected.
+ *   INPUT: phys_addr -- register base from the MP table
+ *          imcr -- the MP table says the board starts in PIC mode behind an IMCR
+ *          dest_apic -- APIC ID of the boot processor
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: maps the 4MB region holding the IO APIC; sets ioapic_ready
+ */
+void ioapic_init(uint32_t phys_addr, uint8_t imcr, uint8_t dest_apic) {
+    uint32_t pins, pin, irq;
+    uint32_t flags;
+
+    if (!irq_routed)
+        routes_reset();
+
+    mmio_map(phys_addr);
+    ioapic = (volatile uint32_t *)phys_addr;
+    pins = ((ioapic_read(IOAPIC_REG_VER) >> IOAPIC_VER_PINS_SHIFT) & IOAPIC_VER_PINS_MASK) + 1;
+
+    cli_and_save(flags);
+    for (pin = 0; pin < pins; pin++)
+        ioapic_write(IOAPIC_REDTBL(pin), IOAPIC_MASKED);
+
+    for (irq = 0; irq < ISA_IRQS; irq++) {
+        /* IRQ 2 is the 8259 cascade, its pin usually carries the PIT instead */
+        if (irq == ICW3_SLAVE || irq_pin[irq] >= pins) {
+            irq_pin[irq] = IOAPIC_NO_PIN;
+            continue;
+        }
+        irq_entry[irq] = IOAPIC_MASKED | irq_mode[irq] | (IRQ_VECTOR_BASE + irq);
+        if (irq < 8 ? !(master_mask & (1 << irq)) : !(slave_mask & (1 << (irq - 8))))
+            irq_entry[irq] &= ~IOAPIC_MASKED;
+        ioapic_write(IOAPIC_REDTBL(irq_pin[irq]) + 1, (uint32_t)dest_apic << IOAPIC_DEST_SHIFT);
+        ioapic_write(IOAPIC_REDTBL(irq_pin[irq]), irq_entry[irq]);
+    }
+
+    outb(PIC_IRQ_MASK, MASTER_8259_DATA_PORT);
+    outb(PIC_IRQ_MASK, SLAVE_8259_DATA_PORT);
+    if (imcr) {
+        outb(IMCR_SELECT, IMCR_SELECT_PORT);
+        outb(IMCR_APIC, IMCR_DATA_PORT);
+    }
+    ioapic_ready = 1;
+    restore_flags(flags);
+}
+
+/* ioapic_unmask / ioapic_mask
+ *   DESCRIPTION: enables or disables delivery of an ISA IRQ with one register write
+ *   INPUT: irq -- ISA IRQ
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void ioapic_unmask(uint32_t irq) {
+    if (irq >= ISA_IRQS || irq_pin[irq] == IOAPIC_NO_PIN)
+        return;
+    irq_entry[irq] &= ~IOAPIC_MASKED;
+    ioapic_write(IOAPIC_REDTBL(irq_pin[irq]), irq_entry[irq]);
+}
+
+void ioapic_mask(uint32_t irq) {
+    if (irq >= ISA_IRQS || irq_pin[irq] == IOAPIC_NO_PIN)
+        return;
+    irq_entry[irq] |= IOAPIC_MASKED;
+    ioapic_write(IOAPIC_REDTBL(irq_pin[irq]), irq_entry[irq]);
+}
+
+/* ioapic_entry
+ *   DESCRIPTION: reads back the redirection entry of an ISA IRQ
+ *   INPUT: irq -- ISA IRQ
+ *   OUTPUT: none
+ *   RETURN VALUE: low word of the entry, IOAPIC_MASKED for an IRQ with no pin
+ *   SIDE EFFECT: none
+ */
+uint32_t ioapic_entry(uint32_t irq) {
+    if (irq >= ISA_IRQS || irq_pin[irq] == IOAPIC_NO_PIN)
+        return IOAPIC_MASKED;
+    return ioapic_read(IOAPIC_REDTBL(irq_pin[irq]));
+}
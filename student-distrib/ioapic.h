@@ -0,0 +1,63 @@
+#ifndef IOAPIC_H_
+#define IOAPIC_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+/* memory mapped registers: select an internal register, then read or write its window */
+#define IOAPIC_REGSEL		0x00
+#define IOAPIC_WIN			0x10
+
+/* internal registers */
+#define IOAPIC_REG_VER		0x01
+#define IOAPIC_REDTBL(pin)	(0x10 + 2 * (pin))	/* low word, the high word follows */
+
+#define IOAPIC_VER_PINS_SHIFT	16				/* version register: last pin in bits 23:16 */
+#define IOAPIC_VER_PINS_MASK	0xFF
+#define IOAPIC_VECTOR_MASK	0xFF
+#define IOAPIC_MASKED		0x10000
+#define IOAPIC_LEVEL		0x08000				/* level triggered, edge when clear */
+#define IOAPIC_LOW_ACTIVE	0x02000				/* active low, active high when clear */
+#define IOAPIC_DEST_SHIFT	24					/* high word: destination APIC ID */
+
+/* MP table interrupt entry flags (polarity bits 1:0, trigger mode bits 3:2) */
+#define MP_IRQ_POLARITY_MASK	0x3
+#define MP_IRQ_POLARITY_LOW		0x3
+#define MP_IRQ_TRIGGER_MASK		0xC
+#define MP_IRQ_TRIGGER_LEVEL	0xC
+
+/* interrupt mode configuration register, routes the 8259 to the BSP or to the APICs */
+#define IMCR_SELECT_PORT	0x22
+#define IMCR_DATA_PORT		0x23
+#define IMCR_SELECT			0x70
+#define IMCR_APIC			0x01
+
+#define ISA_IRQS			16
+#define IRQ_VECTOR_BASE		0x20				/* same vectors the 8259 uses (ICW2_MASTER) */
+#define IOAPIC_NO_PIN		0xFF
+
+#ifndef ASM
+
+/* ======================================================================= */
+
+/* set once device interrupts come from the IO APIC instead of the 8259 */
+extern uint8_t ioapic_ready;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* an ISA IRQ is wired to another pin (MP table interrupt entry), before ioapic_init */
+void ioapic_route(uint32_t irq, uint32_t pin, uint32_t mp_flags);
+
+/* take over the ISA IRQs from the 8259, keeping the ones it had enabled */
+void ioapic_init(uint32_t phys_addr, uint8_t imcr, uint8_t dest_apic);
+
+/* mask / unmask an ISA IRQ */
+void ioapic_unmask(uint32_t irq);
+void ioapic_mask(uint32_t irq);
+
+/* the redirection entry (low word) of an ISA IRQ, for the tests */
+uint32_t ioapic_entry(uint32_t irq);
+
+#endif /* ASM */
+
+#endif
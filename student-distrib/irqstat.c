@@ -0,0 +1,250 @@
+/* irqstat.c - per-vector interrupt counters and handler times
+ *
+ * The HANDLER stubs in interrupts.S call irq_enter before and irq_exit after the C
+ * handler, with an irq_frame_t on the stack in between. A run that context switched
+ * (the timer handlers do) is counted but not timed, as its time includes whatever ran
+ * on the other process; nested interrupts are part of the time of the one they
+ * interrupted, tasklets (tasklet.c) run after irq_exit and are not. The counters
+ * are read as text from the "interrupts" pseudo file.
+ */
+
+#include "irqstat.h"
+#include "apic.h"
+#include "clock.h"
+#include "lib.h"
+#include "scheduler.h"
+#include "serial.h"
+#include "syscalls.h"
+#include "tasklet.h"
+#include "x86_desc.h"
+
+/* vectors with a HANDLER stub, in the order they are listed */
+typedef struct {
+    uint8_t vector;
+    const int8_t * name;
+} irq_name_t;
+
+static const irq_name_t irq_names[] = {
+    { 0x07, "#NM lazy FPU" },
+    { 0x20, "PIT (IRQ 0)" },
+    { 0x21, "keyboard (IRQ 1)" },
+    { SERIAL_VECTOR, "COM1 (IRQ 4)" },
+    { 0x28, "RTC (IRQ 8)" },
+    { APIC_TIMER_VECTOR, "APIC timer" },
+    { APIC_RESCHED_VECTOR, "resched IPI" },
+};
+
+irq_stat_t irq_stats[NUM_VEC];
+volatile uint32_t irq_spurious = 0;
+
+/* each open file reads its own snapshot; the fd's inode holds the slot number + 1 */
+typedef struct {
+    uint8_t used;
+    int32_t len;
+    int8_t text[IRQSTAT_TEXT_SIZE];
+} irqstat_snap_t;
+
+static irqstat_snap_t irqstat_snaps[IRQSTAT_SNAPSHOTS];
+
+/* irq_enter
+ *   DESCRIPTION: counts a handler run and notes when it started. Interrupts are off.
+ *   INPUT: vector -- IDT vector of the handler
+ *          frame -- space on the stub's stack
+ *   OUTPUT: frame filled in
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void irq_enter(uint32_t vector, irq_frame_t * frame) {
+    irq_stats[vector].count++;
+    frame->vector = vector;
+    frame->switches = sched_switches;
+    frame->start = clock_has_tsc ? rdtsc() : 0;
+}
+
+/* irq_exit
+ *   DESCRIPTION: adds the handler's time to its vector, unless it switched processes
+ *   INPUT: frame -- what irq_enter filled in
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void irq_exit(irq_frame_t * frame) {
+    irq_stat_t * s = &irq_stats[frame->vector];
+    uint64_t took;
+    uint32_t cycles;
+    uint32_t flags;
+
+    if (!clock_has_tsc || frame->switches != sched_switches)
+        return;
+
+    took = rdtsc() - frame->start;
+    cycles = (took >> 32) ? IRQSTAT_NO_MIN : (uint32_t)took;
+
+    /* some handlers come back with interrupts on */
+    cli_and_save(flags);
+    if (s->timed == 0 || cycles < s->min)
+        s->min = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+    s->cycles += cycles;
+    s->timed++;
+    restore_flags(flags);
+}
+
+/* cycles_ns
+ *   DESCRIPTION: converts TSC cycles to nanoseconds with clock_init's calibration
+ *   INPUT: cycles -- TSC cycles
+ *   OUTPUT: none
+ *   RETURN VALUE: nanoseconds
+ *   SIDE EFFECT: none
+ */
+static uint32_t cycles_ns(uint64_t cycles) {
+    cycles *= NS_PER_MS;            /* tsc_khz counts per ms */
+    div64_32(&cycles, tsc_khz);
+    return (uint32_t)cycles;
+}
+
+/* irqstat_format
+ *   DESCRIPTION: one line per HANDLER vector with its count and, when the TSC is usable,
+ *                the shortest, average and longest timed run; then the tasklet queue and
+ *                how long each tasklet waited on it
+ *   INPUT: text -- output buffer
+ *          size -- its size
+ *   OUTPUT: text, NUL terminated
+ *   RETURN VALUE: length of the text
+ *   SIDE EFFECT: none
+ */
+int32_t irqstat_format(int8_t * text, int32_t size) {
+    const irq_stat_t * s;
+    const tasklet_t * t;
+    uint64_t avg;
+    uint32_t i;
+    int32_t len;
+
+    len = snprintf(text, size, "vec %-18s %10s %10s %10s %10s\n",
+                   "handler", "count", "min ns", "avg ns", "max ns");
+    for (i = 0; i < sizeof(irq_names) / sizeof(irq_names[0]) && len < size; i++) {
+        s = &irq_stats[irq_names[i].vector];
+        len += snprintf(text + len, size - len, " %02x %-18s %10u", irq_names[i].vector,
+                        irq_names[i].name, s->count);
+        if (len >= size)
+            break;
+        if (s->timed == 0 || tsc_khz == 0) {
+            len += snprintf(text + len, size - len, " %10s %10s %10s\n", "-", "-", "-");
+            continue;
+        }
+        avg = s->cycles;
+        div64_32(&avg, s->timed);
+        len += snprintf(text + len, size - len, " %10u %10u %10u\n",
+                        cycles_ns(s->min), cycles_ns(avg), cycles_ns(s->max));
+    }
+    if (len < size)
+        len += snprintf(text + len, size - len, " %02x %-18s %10u\n",
+                        APIC_SPURIOUS_VECTOR, "spurious", irq_spurious);
+
+    /* work the handlers deferred, latency from tasklet_schedule to the run */
+    if (len < size)
+        len += snprintf(text + len, size - len,
+                        "\ntasklets: %u queued, %u coalesced, depth %u (max %u)\n",
+                        tasklet_stats.scheduled, tasklet_stats.coalesced,
+                        tasklet_stats.depth, tasklet_stats.max_depth);
+    if (len < size)
+        len += snprintf(text + len, size - len, "    %-18s %10s %10s %10s %10s\n",
+                        "tasklet", "runs", "", "avg ns", "max ns");
+    for (t = tasklet_list; t != NULL && len < size; t = t->all) {
+        len += snprintf(text + len, size - len, "    %-18s %10u %10s", t->name, t->runs, "");
+        if (len >= size)
+            break;
+        if (t->runs == 0 || tsc_khz == 0) {
+            len += snprintf(text + len, size - len, " %10s %10s\n", "-", "-");
+            continue;
+        }
+        avg = t->latency;
+        div64_32(&avg, t->runs);
+        len += snprintf(text + len, size - len, " %10u %10u\n",
+                        cycles_ns(avg), cycles_ns(t->max_latency));
+    }
+    return len < size ? len : size - 1;
+}
+
+/* irqstat_open
+ *   DESCRIPTION: opens the interrupts pseudo file
+ *   INPUT: filename -- ignored
+ *   OUTPUT: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECT: none
+ */
+int32_t irqstat_open(const uint8_t* filename) {
+    return 0;
+}
+
+/* irqstat_read
+ *   DESCRIPTION: reads the counters as text. Reading from offset 0 takes a new snapshot
+ *                into the file's own buffer, claimed on its first read.
+ *   INPUT: fd -- file descriptor
+ *          buf -- user buffer
+ *          nbytes -- bytes wanted
+ *   OUTPUT: text in buf
+ *   RETURN VALUE: bytes read, 0 at the end of the text, -1 if buf is not user memory or
+ *                 every snapshot buffer is taken
+ *   SIDE EFFECT: advances the file position
+ */
+int32_t irqstat_read(int32_t fd, void* buf, int32_t nbytes) {
+    pcb_t * pcb = get_pcb_ptr();
+    int32_t pos = pcb->fds[fd].file_position;
+    irqstat_snap_t * snap;
+    uint32_t i;
+
+    if (nbytes < 0 || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    if (pcb->fds[fd].inode == 0) {
+        for (i = 0; i < IRQSTAT_SNAPSHOTS && irqstat_snaps[i].used; i++);
+        if (i == IRQSTAT_SNAPSHOTS)
+            return -1;
+        irqstat_snaps[i].used = 1;
+        irqstat_snaps[i].len = 0;
+        pcb->fds[fd].inode = i + 1;
+    }
+    snap = &irqstat_snaps[pcb->fds[fd].inode - 1];
+
+    if (pos == 0)
+        snap->len = irqstat_format(snap->text, IRQSTAT_TEXT_SIZE);
+
+    if (pos >= snap->len)
+        return 0;
+    if (nbytes > snap->len - pos)
+        nbytes = snap->len - pos;
+
+    memcpy(buf, snap->text + pos, nbytes);
+    pcb->fds[fd].file_position += nbytes;
+    return nbytes;
+}
+
+/* irqstat_write
+ *   DESCRIPTION: the interrupts file is read only
+ *   INPUT: fd, buf, nbytes -- ignored
+ *   OUTPUT: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECT: none
+ */
+int32_t irqstat_write(int32_t fd, const void* buf, int32_t nbytes) {
+    return -1;
+}
+
+/* irqstat_close
+ *   DESCRIPTION: closes the interrupts pseudo file
+ *   INPUT: fd -- file descriptor
+ *   OUTPUT: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECT: frees the file's snapshot buffer
+ */
+int32_t irqstat_close(int32_t fd) {
+    pcb_t * pcb = get_pcb_ptr();
+
+    if (pcb->fds[fd].inode != 0) {
+        irqstat_snaps[pcb->fds[fd].inode - 1].used = 0;
+        pcb->fds[fd].inode = 0;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef IRQSTAT_H_
+#define IRQSTAT_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+#define IRQ_FRAME_SIZE		16			/* sizeof(irq_frame_t), reserved on the stack by HANDLER */
+#define IRQSTAT_TEXT_SIZE	2048		/* room for the text read out of the interrupts file */
+#define IRQSTAT_SNAPSHOTS	6			/* interrupts files that can be read at once */
+#define IRQSTAT_FILE_NAME	"interrupts"	/* pseudo file next to the file system image */
+#define IRQSTAT_NO_MIN		0xFFFFFFFF	/* a run too long for 32 bits of cycles */
+#define IRQSTAT_TEST_VECTOR	0x40		/* no handler, tests.c counts on it */
+
+#ifndef ASM
+
+/* counted since boot, one per IDT vector */
+typedef struct {
+	uint32_t count;			/* times the handler was entered */
+	uint32_t timed;			/* runs that returned without a context switch in between */
+	uint64_t cycles;		/* TSC cycles of the timed runs */
+	uint32_t min;			/* shortest and longest timed run, in cycles */
+	uint32_t max;
+} irq_stat_t;
+
+/* filled in by irq_enter on the handler's stack, handed back to irq_exit */
+typedef struct {
+	uint64_t start;			/* TSC at entry */
+	uint32_t vector;
+	uint32_t switches;		/* sched_switches at entry */
+} irq_frame_t;
+
+/* ======================================================================= */
+
+extern irq_stat_t irq_stats[];
+/* spurious local APIC interrupts, counted by their bare iret stub */
+extern volatile uint32_t irq_spurious;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* around every handler in interrupts.S */
+void irq_enter(uint32_t vector, irq_frame_t * frame);
+void irq_exit(irq_frame_t * frame);
+
+/* renders the counters like /proc/interrupts, returns the length */
+int32_t irqstat_format(int8_t * text, int32_t size);
+
+/* interrupts file operations */
+int32_t irqstat_open(const uint8_t* filename);
+int32_t irqstat_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t irqstat_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t irqstat_close(int32_t fd);
+
+#endif /* ASM */
+
+#endif
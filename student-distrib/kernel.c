@@ -13,6 +13,12 @@
 #include "interrupts.h"
 #include "syscalls.h"
 #include "scheduler.h"
+#include "clock.h"
+#include "apic.h"
+#include "smp.h"
+#include "fpu.h"
+#include "vbe.h"
+#include "serial.h"
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
@@ -25,6 +31,9 @@ void entry (unsigned long magic, unsigned long addr)
 {
 	multiboot_info_t *mbi;
 
+	/* GS -> cpus[0] first, everything that asks cpu_this() depends on it */
+	smp_percpu_init(&cpus[0]);
+
 	/* Clear the screen. */
 	clear();
 
@@ -170,10 +179,28 @@ void entry (unsigned long magic, unsigned long addr)
 
 	/* Initialize the RTC */
 	init_rtc();
+
+	/* COM1, printf is mirrored to it from here on */
+	serial_init();
 	
 	/* Turn on paging */
     paging_init();
 
+    /* Calibrate the TSC clock and the local APIC timer against the PIT */
+    clock_init();
+    apic_init();
+
+    /* FPU/SSE on, switched lazily through #NM */
+    fpu_init();
+
+    /* Find the VBE framebuffer, mapped before the other processors copy the page tables */
+    vbe_init();
+
+    /* Start the other processors; from here on the kernel runs under the big kernel lock,
+     * which the first shell drops on its way to user space */
+    smp_init();
+    kernel_lock();
+
     /* Turn on the PIT */
     PIT_init();
 
@@ -2,6 +2,9 @@
 #include "i8259.h"
 #include "keyboard.h"
 #include "syscalls.h"
+#include "scrollback.h"
+#include "smp.h"
+#include "tasklet.h"
 
 /** IBM 101 Key Code Table
  -----------------------------------------------------------  
@@ -17,6 +20,8 @@
  -----------------------------------------------------------  
 **/
 #define NUM_CHAR_HANDLE   58    /* number of keyboard chars we are handling -- is valid */
+#define KEY_PGUP        0x49    /* shift + page up/down scroll through the terminal's history */
+#define KEY_PGDN        0x51
 
 /* Array containing ascii codes for appropriate scancode translations */
 char scan2ascii[NUM_CHAR_HANDLE][2] = {    // 2 versions: original version and shifted version
@@ -57,6 +62,16 @@ volatile uint8_t keyboard_enabled = 1;
 volatile uint8_t *key_buffer;
 
 
+/* raw scancodes from the interrupt handler to keyboard_bh; head and tail are free running */
+static volatile uint8_t kbd_ring[KBD_RING_SIZE];
+static volatile uint32_t kbd_head = 0;
+static volatile uint32_t kbd_tail = 0;
+volatile uint32_t kbd_dropped = 0;
+/* runs keyboard_bh once the interrupt is over */
+static tasklet_t kbd_tasklet;
+
+static int32_t kbd_process(uint8_t scancode);
+
 /* following variables holds the status of the special keys, if pressed/been pressed or not */
 static uint8_t ctrl_stat  = 0;
 static uint8_t shift_stat = 0;
@@ -73,25 +88,93 @@ static uint8_t caps_stat  = 0;
 */
 void init_keyboard(void) 
 {
+	tasklet_init(&kbd_tasklet, "keyboard", keyboard_bh, 0);
 	enable_irq(1);  // KEYBOARD_IRQ_LINE
 }
 
+/*
+* kbd_ring_push
+*   DESCRIPTION:  producer side of the scancode ring, called by the interrupt handler.
+*                 The ring has one producer and one consumer (keyboard_bh), so head and
+*                 tail each have a single writer and no lock is needed.
+*   INPUT:        scancode -- byte read from the keyboard controller
+*   OUTPUT:       none
+*   RETURN VALUE: 0, -1 if the ring was full and the scancode was dropped
+*   SIDE EFFECTS: schedules keyboard_bh
+*/
+int32_t kbd_ring_push(uint8_t scancode)
+{
+  if (kbd_head - kbd_tail >= KBD_RING_SIZE) {
+    kbd_dropped++;
+    return -1;
+  }
+  kbd_ring[kbd_head & KBD_RING_MASK] = scancode;
+  kbd_head++;
+  tasklet_schedule(&kbd_tasklet);
+  return 0;
+}
+
 /*
 * keyboard_interrupt_handler
-*   DESCRIPTION:  Handle all keyboard inputs from keyboard, including special characters
-*                 such as caplock, shifts, alts, and controls, and gives it to putc to properly 
-*                 display them ont the terminal. 
+*   DESCRIPTION:  IRQ 1. Only queues the scancode and acknowledges the interrupt; the
+*                 decoding, echo and line editing happen in keyboard_bh with interrupts on,
+*                 so the PIT and RTC are not held off while the screen is drawn.
 *   INPUT:        none
 *   OUTPUT:       none
 *   RETURN VALUE: none
-*   SIDE EFFECTS: processes keys to be printed
+*   SIDE EFFECTS: keyboard_bh runs as a tasklet once the handler returns
 */
 void keyboard_interrupt_handler(void) 
 {
-  cli();
+  kbd_ring_push(inb(KEYBOARD_DATA_PORT));
+  send_eoi(1);
+}
+
+/*
+* keyboard_bh
+*   DESCRIPTION:  bottom half, a tasklet: drains the scancode ring with interrupts enabled.
+*                 A keyboard interrupt that arrives meanwhile just queues its scancode, this
+*                 loop picks it up.
+*   INPUT:        data -- unused
+*   OUTPUT:       none
+*   RETURN VALUE: none
+*   SIDE EFFECTS: may switch terminals, which does not return when it starts a new shell
+*/
+void keyboard_bh(uint32_t data)
+{
+  uint8_t scancode;
+  int32_t term;
+
+  while (kbd_tail != kbd_head) {
+    scancode = kbd_ring[kbd_tail & KBD_RING_MASK];
+    kbd_tail++;
+    term = kbd_process(scancode);
+
+    if (term >= 0) {
+      /* let the next interrupt drain the ring in case the switch never comes back */
+      if (kbd_tail != kbd_head)
+        tasklet_schedule(&kbd_tasklet);
+      tasklet_detach();
+      switch_terminal(term);
+      return;
+    }
+  }
 
-  /* read in key pressed from data port */
-  uint8_t scancode = inb(KEYBOARD_DATA_PORT);
+  cursor_flush();
+}
+
+/*
+* kbd_process
+*   DESCRIPTION:  Handle one scancode, including special characters such as caplock,
+*                 shifts, alts, and controls, and gives the key to handle_key_press to
+*                 properly display it on the terminal.
+*   INPUT:        scancode -- from the ring
+*   OUTPUT:       none
+*   RETURN VALUE: terminal to switch to for alt + F1 ~ F3, -1 otherwise
+*   SIDE EFFECTS: processes keys to be printed
+*/
+static int32_t kbd_process(uint8_t scancode)
+{
   uint8_t keycode = 0;
 
   /* dependent on the input, set the status of each special character */
@@ -130,13 +213,17 @@ void keyboard_interrupt_handler(void)
         } 
         /* alt + f1 ~ f3 for swiching terminal */
         else if (0x3A < scancode && scancode < 0x3E) {
-				    send_eoi(1);
             //printf("[Alt-F%d] ", scancode - 0x3A);
-            switch_terminal(scancode - 0x3B);
+            return scancode - 0x3B;
         }
         break;
       }
 
+      if (shift_stat && (scancode == KEY_PGUP || scancode == KEY_PGDN)) {
+        sb_scroll_view(scancode == KEY_PGUP ? SCROLLBACK_PAGE : -SCROLLBACK_PAGE);
+        break;
+      }
+
       /* control + a-z */
       if (scancode < NUM_CHAR_HANDLE) {              
         if (ctrl_stat) {
@@ -184,8 +271,7 @@ void keyboard_interrupt_handler(void)
 
 /* set the keycode to pushed_key */
   if (keycode) handle_key_press(keycode); //pushed_key = keycode;
-  send_eoi(1);
-  sti();
+  return -1;
 }
 
 
@@ -202,6 +288,22 @@ void handle_key_press(uint16_t keycode)
   if (keycode >= PR_CONVER) return;  
 
   char key = (char)keycode;
+  uint8_t echo = 0;
+  uint32_t flags;
+  sb_view_reset();
+
+  /* raw mode: every key goes to the reader as is, Enter as '\n', nothing is echoed */
+  if (terminal[cur_term].ld_mode == LD_RAW) {
+    if (keyboard_enabled == 1) {
+      cli_and_save(flags);
+      terminal_raw_key(key == ENTER ? '\n' : key);
+      restore_flags(flags);
+    }
+    return;
+  }
+
+  /* keyboard_bh runs with interrupts on: the line buffer is only touched with them off,
+   * so a reader never sees half an edit; the echo is drawn afterwards */
   switch (key) {
     case CTRL_L :
 			clear();
@@ -210,22 +312,33 @@ void handle_key_press(uint16_t keycode)
     case CTRL_C :
       break;
     case BS:
+      cli_and_save(flags);
       if (key_buffer_idx > 0) {
-	  	backspace();
 		  key_buffer_idx--;
 		  key_buffer[key_buffer_idx] = '\0';
+		  echo = 1;
 	    }
+      restore_flags(flags);
+      if (echo)
+	  	backspace();
       break;
     case ENTER:
-    		get_pcb_ptr_process(terminal[cur_term].apn)->term->eflag = 1;
+      cli_and_save(flags);
 	      key_buffer[key_buffer_idx++] = '\n';
+    		get_pcb_ptr_process(terminal[cur_term].apn)->term->eflag = 1;
+      restore_flags(flags);
 	      enter();
+	      wake_up(&terminal[cur_term].read_wq);
       break;
     default:
+      cli_and_save(flags);
 	    if ((key_buffer_idx < KEY_BUFFER_SIZE) && (keyboard_enabled == 1)) {
 		    add_key_buff(key);
-		    putc(key);
+		    echo = 1;
       }
+      restore_flags(flags);
+      if (echo)
+		    putc(key);
   }
 }
 
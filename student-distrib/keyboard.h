@@ -31,6 +31,8 @@
 #define KEYBOARD_CTRL_PORT 0x61     /* location of keybord port */
 
 #define KEY_BUFFER_SIZE		127
+#define KBD_RING_SIZE		64		/* scancodes queued for keyboard_bh, power of two */
+#define KBD_RING_MASK		(KBD_RING_SIZE - 1)
 #define TERMINAL_ONE 0
 #define TERMINAL_TWO 1
 #define TERMINAL_THREE 2
@@ -38,14 +40,18 @@
 extern volatile uint8_t key_buffer_idx;
 extern volatile uint8_t eflag;
 extern volatile uint8_t *key_buffer;
+/* scancodes lost to a full ring */
+extern volatile uint32_t kbd_dropped;
 
 /* these three functions are defined in interrupt.S */
 
 /* enable keyboard input */
 void init_keyboard(void);
 
-/* processing keyboard input */
+/* processing keyboard input: the handler queues scancodes, keyboard_bh decodes them */
 void keyboard_interrupt_handler(void);
+int32_t kbd_ring_push(uint8_t scancode);
+void keyboard_bh(uint32_t data);
 
 /* dummy method so far, will implement more later */
 //void handle_trap(void);
@@ -2,25 +2,116 @@
 #include "i8259.h"
 #include "terminal.h"
 #include "scheduler.h"
+#include "scrollback.h"
+#include "serial.h"
+#include "fpu.h"
+#include "clock.h"
 
 #define VIDEO       0xB8000                 /* video memory statrt location */
 #define NUM_COLS    80                      /* number of columns of terminal screen */
 #define NUM_ROWS    25                      /* number of rows of terminal screen */
 #define ATTRIB      0x7                     /* attribute: black given to write in putc etc */
 
-static int screen_x;                        /* holds the x location to putc and set cursor */
-static int screen_y;                        /* holds the y location to putc and set cursor */
-static char* video_mem = (char *)VIDEO;     /* converts the Vid Mem location to a pointer */
+/* Every terminal draws straight into its own part of video memory (TERM_VGA), the
+ * displayed one is picked with the CRTC start address. Indexed by terminal. */
+static int screen_x[MAX_TERM];              /* holds the x location to putc and set cursor */
+static int screen_y[MAX_TERM];              /* holds the y location to putc and set cursor */
+static uint32_t vga_top[MAX_TERM];          /* row of the terminal's video memory shown at the top of its screen */
 static uint8_t attribute[3] = { ATTRIB_TERM1, ATTRIB_TERM2, ATTRIB_TERM3 };
+static uint8_t text_attr[3] = { ATTRIB_TERM1, ATTRIB_TERM2, ATTRIB_TERM3 };	/* current colors, set with SGR */
+
+/* ANSI escape sequences in terminal_write output are parsed as they stream by, so
+ * a sequence may be split across writes. Indexed by terminal. */
+typedef struct {
+	uint8_t state;						/* ANSI_NORMAL, ANSI_ESCAPE or ANSI_CSI */
+	uint8_t private;					/* '?' seen, a DEC private sequence (ignored) */
+	uint8_t nparams;					/* parameters started so far */
+	uint32_t params[ANSI_MAX_PARAMS];
+	uint8_t region;						/* a scroll region smaller than the screen is set */
+	uint8_t top;						/* scroll region rows, inclusive */
+	uint8_t bottom;
+} ansi_t;
+static ansi_t ansi[MAX_TERM];
+/* ANSI color number to VGA color */
+static const uint8_t ansi_color[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+/* Output of the formatting core. Characters collect in buf; when it fills up, flush
+ * hands them to the sink and empties it, or without a sink the rest is dropped (but
+ * still counted, as snprintf reports it). */
+typedef struct fmt_out {
+	int8_t* buf;
+	uint32_t size;						/* room in buf */
+	uint32_t len;						/* characters waiting in buf */
+	uint32_t total;						/* characters produced */
+	void (*flush)(struct fmt_out* out);
+	uint8_t term;						/* for term_sink */
+} fmt_out_t;
+
+/* one conversion, as fmt_format parsed it */
+typedef struct {
+	int32_t width;						/* minimum characters */
+	int32_t precision;					/* %s maximum characters, -1 for none */
+	uint32_t radix;
+	uint8_t left;						/* '-' */
+	uint8_t zero;						/* '0' */
+	uint8_t negative;					/* print a '-' */
+	uint8_t hex_prefix;					/* print "0x", for %p */
+} fmt_spec_t;
+
+/* Port I/O is slow, so the cursor is only marked dirty while printing and
+ * cursor_flush writes it once per write system call, printf call, key press or tick. */
+static volatile uint8_t cursor_dirty = 0;
+static uint32_t cursor_hw = CURSOR_UNKNOWN;     /* position the CRTC holds */
+static uint32_t crtc_start = 0;                 /* start address the CRTC holds */
+vga_stats_t vga_counters;
+
+static void term_enter(uint8_t term);
+static void term_scroll_up(uint8_t term);
+static void term_scroll(uint8_t term, uint32_t lines);
+static int32_t term_vprintf(uint8_t term, int8_t *format, int32_t *esp);
+static void term_sink(fmt_out_t* out);
+static void fmt_format(fmt_out_t* out, int8_t *format, int32_t *esp);
+static void term_write_text(uint8_t term, const uint8_t* buf, int32_t nbytes);
+static void region_putc(uint8_t term, uint8_t c);
+static void ansi_putc(uint8_t term, uint8_t c);
+static void ansi_csi(uint8_t term, uint8_t final);
+static void ansi_erase(uint8_t term, uint32_t from, uint32_t to);
+static void ansi_sgr(uint8_t term);
 
 /*
 * void set_cursor_pos(void);
-*   Special print function to write to the currently executing terminal's video buffer
+*   Inputs: void
+*   Return Value: none
+*	Function: Notes that the hardware cursor has to follow the displayed terminal's
+*			  screen position; cursor_flush does the port writes
 */
 void set_cursor_pos() {
-	uint16_t position = NUM_COLS*screen_y + screen_x;
+	cursor_dirty = 1;
+	vga_counters.cursor_updates++;
+}
+
+/*
+* void cursor_flush(void);
+*   Inputs: void
+*   Return Value: none
+*	Function: Moves the hardware cursor to the displayed terminal's screen position if
+*			  it changed since the last flush
+*/
+void cursor_flush(void) {
+	uint16_t position;
+
+	if (cursor_dirty == 0)
+		return;
+	cursor_dirty = 0;
+
+	position = (TERM_VGA(cur_term) - VIDEO)/2 + NUM_COLS*(vga_top[cur_term] + screen_y[cur_term]) + screen_x[cur_term];
+	if (position == cursor_hw)
+		return;
+	cursor_hw = position;
 	outw(0x000E | (position & 0xFF00), 0x03D4);
 	outw(0x000F | ((position << 8) & 0xFF00), 0x03D4);
+	vga_counters.cursor_flushes++;
+	vga_counters.port_writes += 2;
 }
 
 /*
@@ -33,8 +124,9 @@ void set_cursor_pos() {
  */
 void clear(void)
 {
+	terminal_out_flush(cur_term);
     /* Clear video screen as blank */
-	memset_word(video_mem, attribute[cur_term] << 8 | ' ', NUM_ROWS * NUM_COLS);
+	memset_word(term_screen(cur_term), text_attr[cur_term] << 8 | ' ', NUM_ROWS * NUM_COLS);
 }
 
 /*
@@ -48,9 +140,11 @@ void clear(void)
 void blue_screen(void) {
     /* Clear video screen as blue*/
 	int32_t i;
+	sb_view_reset();
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
-		*(uint8_t *)(video_mem + (i << 1) + 1) = BLUE_SCREEN;
+		*(uint8_t *)(term_screen(cur_term) + (i << 1) + 1) = BLUE_SCREEN;
 	}
+	cursor_flush();
 }
 
 /*
@@ -61,7 +155,7 @@ void blue_screen(void) {
 *	effects: none
 */
 int get_screen_x(void) {
-	return screen_x;
+	return screen_x[cur_term];
 }
 
 /*
@@ -72,7 +166,7 @@ int get_screen_x(void) {
 *	effects: changes x coord
 */
 void set_screen_x(uint32_t new_x) {
-	set_screen_pos(new_x, screen_y);
+	set_screen_pos(new_x, screen_y[cur_term]);
 }
 
 /*
@@ -83,7 +177,7 @@ void set_screen_x(uint32_t new_x) {
 *	effects: none
 */
 int get_screen_y(void) {
-	return screen_y;
+	return screen_y[cur_term];
 }
 
 /*
@@ -94,51 +188,43 @@ int get_screen_y(void) {
 *	effects: changes y coord
 */
 void set_screen_y(uint32_t new_y) {
-	set_screen_pos(screen_x, new_y);
+	set_screen_pos(screen_x[cur_term], new_y);
 }
 
 /*
 * void set_screen_pos(uint32_t x, uint32_t y);
 *   Inputs: x and y coordinates to start writing text to the screen
 *   Return Value: none
-*	Function: moves the location text is drawn on the screen
+*	Function: moves the location text is drawn on the displayed terminal
 */
 void set_screen_pos(uint32_t x, uint32_t y) {
-	if (x < NUM_COLS)
-		screen_x = x;
-	else {
-		enter();
-		set_cursor_pos();
-		return;
-	}
-
-	if (y < NUM_ROWS)
-		screen_y = y;
-	else {
-		scroll_up();
-		screen_y = NUM_ROWS - 1;
-	}
-	set_cursor_pos();
+	term_set_pos(cur_term, x, y);
 }
 
 /*
-* void set_screen_pos_term_exec(uint32_t x, uint32_t y);
-*   Special print function to write to the currently executing terminal's video buffer
+* void term_set_pos(uint8_t term, uint32_t x, uint32_t y);
+*   Inputs: term -- terminal to move in
+*			x and y coordinates to start writing text to the screen
+*   Return Value: none
+*	Function: moves the location text is drawn on a terminal, scrolling it when y
+*			  runs off the bottom. Only the displayed terminal moves the cursor.
 */
-void set_screen_pos_term_exec(uint32_t x, uint32_t y) {
+void term_set_pos(uint8_t term, uint32_t x, uint32_t y) {
 	if (x < NUM_COLS)
-		terminal[cur_active_terminal].pos_x = x;
+		screen_x[term] = x;
 	else {
-		enter_term_exec();
+		term_enter(term);
 		return;
 	}
 
 	if (y < NUM_ROWS)
-		terminal[cur_active_terminal].pos_y = y;
+		screen_y[term] = y;
 	else {
-		scroll_up_term_exec();
-		terminal[cur_active_terminal].pos_y = NUM_ROWS - 1;
+		term_scroll_up(term);
+		screen_y[term] = NUM_ROWS - 1;
 	}
+	if (term == cur_term)
+		set_cursor_pos();
 }
 
 /*
@@ -148,15 +234,17 @@ void set_screen_pos_term_exec(uint32_t x, uint32_t y) {
 *	Function: Moves to the next line on the screen
 */
 void enter(void) {
-	set_screen_pos(ROW_START, screen_y+1);
+	term_enter(cur_term);
 }
 
 /*
-* void enter(void);
-*   Special print function to write to the currently executing terminal's video buffer
+* void term_enter(uint8_t term);
+*   Inputs: term -- terminal to move in
+*   Return Value: none
+*	Function: Moves to the next line of a terminal
 */
-void enter_term_exec(void) {
-	set_screen_pos_term_exec(ROW_START, terminal[cur_active_terminal].pos_y+1);
+static void term_enter(uint8_t term) {
+	term_set_pos(term, ROW_START, screen_y[term]+1);
 }
 
 /*
@@ -166,320 +254,496 @@ void enter_term_exec(void) {
 *	Function: Removes a character from the screen
 */
 void backspace(void) {
-	if (screen_x == ROW_START) {
-		set_screen_pos(NUM_COLS-1, screen_y-1);
+	terminal_out_flush(cur_term);
+	if (screen_x[cur_term] == ROW_START) {
+		set_screen_pos(NUM_COLS-1, screen_y[cur_term]-1);
 	}
 	else {
-		set_screen_x(screen_x-1);
+		set_screen_x(screen_x[cur_term]-1);
 	}
 
-	*(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-    *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = attribute[cur_term];
-    // if (cur_term == TERMINAL_ONE)
-    //     	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM1;
-    //     if (cur_term == TERMINAL_TWO)
-    //     	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM2;
-    //     if (cur_term == TERMINAL_THREE)
-    //     	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM3;
+	*(uint8_t *)(term_screen(cur_term) + ((NUM_COLS * screen_y[cur_term] + screen_x[cur_term]) << 1)) = ' ';
+    *(uint8_t *)(term_screen(cur_term) + ((NUM_COLS*screen_y[cur_term] + screen_x[cur_term]) << 1) + 1) = text_attr[cur_term];
 }
 
 /*
 * void scroll_up(void);
 *   Inputs: void
 *   Return Value: none
-*	Function: Removes a character from the screen
+*	Function: Scrolls the displayed terminal up a line
 */
 void scroll_up() {
-	int32_t x;
-	int32_t y;
-	int32_t old_line;
-	int32_t new_line;
-
-	// Move each row in the video memory up by 1
-	for (y = 0; y < NUM_ROWS-1; y++) {
-		for (x = 0; x < NUM_COLS; x++) {
-			old_line = NUM_COLS*(y+1) + x;
-			new_line = NUM_COLS*y + x;
-			*(uint8_t *)(video_mem + (new_line << 1)) = *(uint8_t *)(video_mem + (old_line << 1));
-		}
-	}
+	term_scroll_up(cur_term);
+}
 
-	// Clear the bottom line
-	for (x = 0; x < NUM_COLS; x++) {
-		new_line = NUM_COLS*(NUM_ROWS-1) + x;
-		*(uint8_t *)(video_mem + (new_line << 1)) = ' ';
+/*
+* void term_scroll_up(uint8_t term);
+*   Inputs: term -- terminal to scroll
+*   Return Value: none
+*	Function: Scrolls a terminal up a line. The top row goes to the terminal's
+*			  scrollback; the screen then simply starts one row further down the
+*			  terminal's video memory (CRTC start address), and is only copied back to
+*			  the top once it reaches the end of the window. A terminal whose program
+*			  draws through vidmap stays at the top and is copied every time.
+*/
+static void term_scroll_up(uint8_t term) {
+	term_scroll(term, 1);
+	screen_x[term] = ROW_START;
+}
+
+/*
+* void term_scroll(uint8_t term, uint32_t lines);
+*   Inputs: term -- terminal to scroll
+*			lines -- rows to scroll, 1 to NUM_ROWS
+*   Return Value: none
+*	Function: Scrolls a terminal up several lines at once, as term_scroll_up. The
+*			  cursor position is left alone.
+*/
+static void term_scroll(uint8_t term, uint32_t lines) {
+	uint16_t* base = (uint16_t*)term_screen(term);
+	uint32_t i;
+
+	for (i = 0; i < lines; i++)
+		sb_push(term, base + i * NUM_COLS);
+
+	if (terminal[term].pinned == 0 && vga_top[term] + NUM_ROWS + lines <= VGA_WIN_ROWS) {
+		vga_top[term] += lines;
+	} else {
+		memmove((void*)TERM_VGA(term), base + lines * NUM_COLS, (NUM_ROWS-lines) * NUM_COLS * sizeof(uint16_t));
+		vga_top[term] = 0;
 	}
-	set_screen_x(ROW_START);
+
+	// Clear the bottom lines
+	memset_word(term_screen(term) + ((NUM_COLS*(NUM_ROWS-lines)) << 1), text_attr[term] << 8 | ' ', NUM_COLS * lines);
+	if (term == cur_term)
+		screen_show();
+}
+
+/*
+* uint8_t* term_screen(uint8_t term);
+*   Inputs: term -- terminal
+*   Return Value: address of the top left cell of the terminal's screen
+*	Function: the screen does not start at TERM_VGA once it has been scrolled
+*/
+uint8_t* term_screen(uint8_t term) {
+	return (uint8_t*)TERM_VGA(term) + ((vga_top[term] * NUM_COLS) << 1);
 }
 
 /*
-* void scroll_up_term_exec(void);
-*   Special print function to write to the currently executing terminal's video buffer
+* void screen_show(void);
+*   Inputs: void
+*   Return Value: none
+*	Function: Points the CRTC and the cursor at the displayed terminal's screen,
+*			  unless the user is looking at the scrollback
 */
-void scroll_up_term_exec() {
-	int32_t x;
-	int32_t y;
-	int32_t old_line;
-	int32_t new_line;
+void screen_show(void) {
+	if (sb_viewing() != 0)
+		return;
+	vga_set_start((TERM_VGA(cur_term) - VIDEO)/2 + vga_top[cur_term] * NUM_COLS);
+	set_cursor_pos();
+}
 
-	// Move each row in the video memory up by 1
-	for (y = 0; y < NUM_ROWS-1; y++) {
-		for (x = 0; x < NUM_COLS; x++) {
-			old_line = NUM_COLS*(y+1) + x;
-			new_line = NUM_COLS*y + x;
-			*(uint8_t *)(terminal[cur_active_terminal].video_mem + (new_line << 1)) = *(uint8_t *)(terminal[cur_active_terminal].video_mem + (old_line << 1));
-		}
-	}
+/*
+* void screen_rebase(uint8_t term);
+*   Inputs: term -- terminal
+*   Return Value: none
+*	Function: Moves a terminal's screen contents to the start of its video memory,
+*			  where vidmap points user programs
+*/
+void screen_rebase(uint8_t term) {
+	if (vga_top[term] != 0)
+		memmove((void*)TERM_VGA(term), term_screen(term), (NUM_ROWS * NUM_COLS) << 1);
+	vga_top[term] = 0;
+	if (term == cur_term)
+		screen_show();
+}
 
-	// Clear the bottom line
-	for (x = 0; x < NUM_COLS; x++) {
-		new_line = NUM_COLS*(NUM_ROWS-1) + x;
-		*(uint8_t *)(terminal[cur_active_terminal].video_mem + (new_line << 1)) = ' ';
-	}
-	set_screen_pos_term_exec(ROW_START, terminal[cur_active_terminal].pos_y);
+/*
+* void vga_set_start(uint32_t cell);
+*   Inputs: cell -- offset from VIDEO in character cells
+*   Return Value: none
+*	Function: Makes the VGA display video memory starting at the given cell
+*/
+void vga_set_start(uint32_t cell) {
+	if (cell == crtc_start)
+		return;
+	crtc_start = cell;
+	outw(CRTC_START_HIGH | (cell & 0xFF00), VGA_CRTC_PORT);
+	outw(CRTC_START_LOW | ((cell << 8) & 0xFF00), VGA_CRTC_PORT);
+	vga_counters.port_writes += 2;
 }
 
 /* Standard printf().
- * Only supports the following format strings:
- * %%  - print a literal '%' character
- * %x  - print a number in hexadecimal
- * %u  - print a number as an unsigned integer
- * %d  - print a number as a signed integer
- * %c  - print a character
- * %s  - print a string
- * %#x - print a number in 32-bit aligned hexadecimal, i.e.
- *       print 8 hexadecimal digits, zero-padded on the left.
- *       For example, the hex number "E" would be printed as
- *       "0000000E".
- *       Note: This is slightly different than the libc specification
- *       for the "#" modifier (this implementation doesn't add a "0x" at
- *       the beginning), but I think it's more flexible this way.
- *       Also note: %x is the only conversion specifier that can use
- *       the "#" modifier to alter output.
+ * Conversions are %[flags][width][.precision][length]specifier, with
+ * flags:     '-' left justify, '0' pad numbers with zeros, '#' see %#x
+ * width:     minimum characters, or '*' to take it from the arguments
+ * precision: for %s only, maximum characters, or '*'
+ * length:    'll' for a 64-bit argument (d, i, u, x, X), 'l' and 'h' are ignored
+ * and the specifiers
+ * %%     - print a literal '%' character
+ * %x %X  - print a number in hexadecimal, upper case either way
+ * %u     - print a number as an unsigned integer
+ * %d %i  - print a number as a signed integer
+ * %c     - print a character
+ * %s     - print a string
+ * %p     - print a pointer as 0x and 8 hexadecimal digits
+ * %#x    - print a number in 32-bit aligned hexadecimal, i.e.
+ *          print 8 hexadecimal digits, zero-padded on the left.
+ *          For example, the hex number "E" would be printed as
+ *          "0000000E". With a width the number is zero-padded to that.
+ *          Note: This is slightly different than the libc specification
+ *          for the "#" modifier (this implementation doesn't add a "0x" at
+ *          the beginning), but I think it's more flexible this way.
+ * The text is formatted into a buffer on the stack and written to the terminal a
+ * buffer at a time. Returns the number of characters printed.
  * */
 int32_t printf(int8_t *format, ...)
 {
-	/* Pointer to the format string */
-	int8_t* buf = format;
+	/* the other parameters follow the format string on the stack */
+	return term_vprintf(cur_term, format, (int32_t *)&format + 1);
+}
 
-	/* Stack pointer for the other parameters */
-	int32_t* esp = (void *)&format;
-	esp++;
+/*
+* int32_t printf_term(uint8_t term, int8_t *format, ...);
+*   Inputs: term -- terminal to print on, displayed or not
+*			format -- as printf
+*   Return Value: as printf
+*	Function: printf to any terminal
+*/
+int32_t printf_term(uint8_t term, int8_t *format, ...)
+{
+	return term_vprintf(term, format, (int32_t *)&format + 1);
+}
 
-	while(*buf != '\0') {
-		switch(*buf) {
-			case '%':
-				{
-					int32_t alternate = 0;
-					buf++;
-
-					format_char_switch:
-					/* Conversion specifiers */
-					switch(*buf) {
-						/* Print a literal '%' character */
-						case '%':
-							putc('%');
-							break;
-
-						/* Use alternate formatting */
-						case '#':
-							alternate = 1;
-							buf++;
-							/* Yes, I know gotos are bad.  This is the
-							 * most elegant and general way to do this,
-							 * IMHO. */
-							goto format_char_switch;
-
-						/* Print a number in hexadecimal form */
-						case 'x':
-							{
-								int8_t conv_buf[64];
-								if(alternate == 0) {
-									itoa(*((uint32_t *)esp), conv_buf, 16);
-									puts(conv_buf);
-								} else {
-									int32_t starting_index;
-									int32_t i;
-									itoa(*((uint32_t *)esp), &conv_buf[8], 16);
-									i = starting_index = strlen(&conv_buf[8]);
-									while(i < 8) {
-										conv_buf[i] = '0';
-										i++;
-									}
-									puts(&conv_buf[starting_index]);
-								}
-								esp++;
-							}
-							break;
-
-						/* Print a number in unsigned int form */
-						case 'u':
-							{
-								int8_t conv_buf[36];
-								itoa(*((uint32_t *)esp), conv_buf, 10);
-								puts(conv_buf);
-								esp++;
-							}
-							break;
-
-						/* Print a number in signed int form */
-						case 'd':
-							{
-								int8_t conv_buf[36];
-								int32_t value = *((int32_t *)esp);
-								if(value < 0) {
-									conv_buf[0] = '-';
-									itoa(-value, &conv_buf[1], 10);
-								} else {
-									itoa(value, conv_buf, 10);
-								}
-								puts(conv_buf);
-								esp++;
-							}
-							break;
-
-						/* Print a single character */
-						case 'c':
-							putc( (uint8_t) *((int32_t *)esp) );
-							esp++;
-							break;
-
-						/* Print a NULL-terminated string */
-						case 's':
-							puts( *((int8_t **)esp) );
-							esp++;
-							break;
-
-						default:
-							break;
-					}
+/*
+* int32_t snprintf(int8_t* buf, uint32_t size, int8_t *format, ...);
+*   Inputs: buf -- where the text goes
+*			size -- bytes in buf, the terminating NUL included
+*			format -- as printf
+*   Return Value: length of the whole text, which was cut short if this is size or more
+*	Function: printf into a buffer
+*/
+int32_t snprintf(int8_t* buf, uint32_t size, int8_t *format, ...)
+{
+	return vsnprintf(buf, size, format, (int32_t *)&format + 1);
+}
 
-				}
-				break;
+/*
+* int32_t vsnprintf(int8_t* buf, uint32_t size, int8_t *format, int32_t *esp);
+*   Inputs: buf -- where the text goes
+*			size -- bytes in buf, the terminating NUL included
+*			format -- as printf
+*			esp -- first parameter after the format string
+*   Return Value: as snprintf
+*	Function: snprintf for callers that have the parameters already
+*/
+int32_t vsnprintf(int8_t* buf, uint32_t size, int8_t *format, int32_t *esp)
+{
+	fmt_out_t out;
+
+	out.buf = buf;
+	out.size = size > 0 ? size - 1 : 0;
+	out.len = 0;
+	out.total = 0;
+	out.flush = NULL;
+	fmt_format(&out, format, esp);
+	if (size > 0)
+		buf[out.len] = '\0';
+	return out.total;
+}
 
-			default:
-				putc(*buf);
-				break;
-		}
-		buf++;
+/*
+* int32_t term_vprintf(uint8_t term, int8_t *format, int32_t *esp);
+*   Inputs: term -- terminal to print on
+*			format -- as printf
+*			esp -- first parameter after the format string
+*   Return Value: as printf
+*	Function: formats into PRINTF_BUF_SIZE bytes on the stack, handed to term_sink
+*			  whenever they fill up
+*/
+static int32_t term_vprintf(uint8_t term, int8_t *format, int32_t *esp)
+{
+	int8_t line[PRINTF_BUF_SIZE];
+	fmt_out_t out;
+	uint32_t flags;
+
+	out.buf = line;
+	out.size = PRINTF_BUF_SIZE;
+	out.len = 0;
+	out.total = 0;
+	out.flush = term_sink;
+	out.term = term;
+	fmt_format(&out, format, esp);
+	term_sink(&out);
+
+	/* one cursor move per call; with tickless idle no tick may come to do it */
+	cli_and_save(flags);
+	cursor_flush();
+	restore_flags(flags);
+	return out.total;
+}
+
+/*
+* void term_sink(fmt_out_t* out);
+*   Inputs: out -- formatted text
+*   Return Value: none
+*	Function: printf output: the buffer goes to the terminal in one term_write, after
+*			  any queued terminal_write output, and is mirrored to the serial port
+*/
+static void term_sink(fmt_out_t* out)
+{
+	uint32_t i;
+
+	if (out->len == 0)
+		return;
+	terminal_out_flush(out->term);
+	term_write(out->term, (uint8_t*)out->buf, out->len);
+	for (i = 0; i < out->len; i++)
+		serial_putc(out->buf[i]);
+	out->len = 0;
+}
+
+/*
+* void fmt_putc(fmt_out_t* out, int8_t c);
+*   Inputs: out -- output
+*			c -- character
+*   Return Value: none
+*	Function: adds a character, flushing a full buffer first
+*/
+static void fmt_putc(fmt_out_t* out, int8_t c)
+{
+	if (out->len == out->size && out->flush != NULL)
+		out->flush(out);
+	if (out->len < out->size)
+		out->buf[out->len++] = c;
+	out->total++;
+}
+
+/*
+* void fmt_pad(fmt_out_t* out, int8_t c, int32_t n);
+*   Inputs: out -- output
+*			c -- padding character
+*			n -- how many, nothing if 0 or less
+*   Return Value: none
+*	Function: adds padding
+*/
+static void fmt_pad(fmt_out_t* out, int8_t c, int32_t n)
+{
+	for (; n > 0; n--)
+		fmt_putc(out, c);
+}
+
+/*
+* void fmt_number(fmt_out_t* out, uint64_t value, const fmt_spec_t* spec);
+*   Inputs: out -- output
+*			value -- magnitude of the number
+*			spec -- radix, sign and padding
+*   Return Value: none
+*	Function: converts a number (64-bit, through div64_32) and pads it to the width
+*/
+static void fmt_number(fmt_out_t* out, uint64_t value, const fmt_spec_t* spec)
+{
+	static const int8_t digits[] = "0123456789ABCDEF";
+	int8_t conv_buf[FMT_NUM_SIZE];
+	int32_t n = 0, prefix, pad;
+
+	do {
+		conv_buf[n++] = digits[div64_32(&value, spec->radix)];
+	} while (value != 0);
+
+	prefix = (spec->negative ? 1 : 0) + (spec->hex_prefix ? 2 : 0);
+	pad = spec->width - n - prefix;
+
+	if (!spec->left && !spec->zero)
+		fmt_pad(out, ' ', pad);
+	if (spec->negative)
+		fmt_putc(out, '-');
+	if (spec->hex_prefix) {
+		fmt_putc(out, '0');
+		fmt_putc(out, 'x');
 	}
+	if (!spec->left && spec->zero)
+		fmt_pad(out, '0', pad);
+	while (n > 0)
+		fmt_putc(out, conv_buf[--n]);
+	if (spec->left)
+		fmt_pad(out, ' ', pad);
+}
 
-	return (buf - format);
+/*
+* void fmt_string(fmt_out_t* out, const int8_t* s, const fmt_spec_t* spec);
+*   Inputs: out -- output
+*			s -- string, NULL prints as "(null)"
+*			spec -- width and precision
+*   Return Value: none
+*	Function: adds a string, at most spec->precision characters of it when that is set
+*/
+static void fmt_string(fmt_out_t* out, const int8_t* s, const fmt_spec_t* spec)
+{
+	int32_t n, i;
+
+	if (s == NULL)
+		s = "(null)";
+	for (n = 0; s[n] != '\0' && (spec->precision < 0 || n < spec->precision); n++);
+
+	if (!spec->left)
+		fmt_pad(out, ' ', spec->width - n);
+	for (i = 0; i < n; i++)
+		fmt_putc(out, s[i]);
+	if (spec->left)
+		fmt_pad(out, ' ', spec->width - n);
 }
 
-/* Standard printf_terminal_active().
- * Special print function to write to the currently executing terminal's video buffer
- */
-int32_t printf_terminal_active(int8_t *format, ...)
+/*
+* int32_t fmt_count(int8_t** format, int32_t** esp);
+*   Inputs: format -- at a width or precision, advanced past it
+*			esp -- parameters, advanced past a '*'
+*   Return Value: the number, or the parameter for '*'
+*	Function: reads a width or precision
+*/
+static int32_t fmt_count(int8_t** format, int32_t** esp)
+{
+	int32_t n = 0;
+
+	if (**format == '*') {
+		(*format)++;
+		return *((*esp)++);
+	}
+	while (**format >= '0' && **format <= '9')
+		n = n * 10 + *((*format)++) - '0';
+	return n;
+}
+
+/*
+* void fmt_format(fmt_out_t* out, int8_t *format, int32_t *esp);
+*   Inputs: out -- output
+*			format -- as printf
+*			esp -- first parameter after the format string
+*   Return Value: none
+*	Function: the formatting core behind printf and snprintf, one pass over the format
+*/
+static void fmt_format(fmt_out_t* out, int8_t *format, int32_t *esp)
 {
-	/* Pointer to the format string */
-	int8_t* buf = format;
+	fmt_spec_t spec;
+	uint64_t value;
+	int32_t alternate, longs;
+
+	while (*format != '\0') {
+		if (*format != '%') {
+			fmt_putc(out, *format++);
+			continue;
+		}
+		format++;
+
+		/* flags */
+		memset(&spec, 0, sizeof(spec));
+		alternate = 0;
+		for (;; format++) {
+			if (*format == '-')
+				spec.left = 1;
+			else if (*format == '0')
+				spec.zero = 1;
+			else if (*format == '#')
+				alternate = 1;
+			else
+				break;
+		}
+
+		spec.width = fmt_count(&format, &esp);
+		if (spec.width < 0) {
+			spec.left = 1;
+			spec.width = -spec.width;
+		}
+		spec.precision = -1;
+		if (*format == '.') {
+			format++;
+			spec.precision = fmt_count(&format, &esp);
+		}
 
-	/* Stack pointer for the other parameters */
-	int32_t* esp = (void *)&format;
-	esp++;
+		for (longs = 0; *format == 'l' || *format == 'h'; format++) {
+			if (*format == 'l')
+				longs++;
+		}
 
-	while(*buf != '\0') {
-		switch(*buf) {
+		/* Conversion specifiers */
+		spec.radix = 10;
+		switch (*format) {
+			/* Print a literal '%' character */
 			case '%':
+				fmt_putc(out, '%');
+				break;
+
+			/* Print a number in hexadecimal form */
+			case 'x':
+			case 'X':
+				spec.radix = 16;
+				if (alternate) {
+					spec.zero = 1;
+					if (spec.width == 0)
+						spec.width = FMT_HEX_DIGITS;
+				}
+				/* falls through */
+			/* Print a number in unsigned int form */
+			case 'u':
+				if (longs >= FMT_LONG_LONG) {
+					value = *((uint64_t *)esp);
+					esp += 2;
+				} else {
+					value = *((uint32_t *)esp++);
+				}
+				fmt_number(out, value, &spec);
+				break;
+
+			/* Print a number in signed int form */
+			case 'd':
+			case 'i':
 				{
-					int32_t alternate = 0;
-					buf++;
-
-					format_char_switch:
-					/* Conversion specifiers */
-					switch(*buf) {
-						/* Print a literal '%' character */
-						case '%':
-							putc_terminal_active('%');
-							break;
-
-						/* Use alternate formatting */
-						case '#':
-							alternate = 1;
-							buf++;
-							/* Yes, I know gotos are bad.  This is the
-							 * most elegant and general way to do this,
-							 * IMHO. */
-							goto format_char_switch;
-
-						/* Print a number in hexadecimal form */
-						case 'x':
-							{
-								int8_t conv_buf[64];
-								if(alternate == 0) {
-									itoa(*((uint32_t *)esp), conv_buf, 16);
-									puts_terminal_active(conv_buf);
-								} else {
-									int32_t starting_index;
-									int32_t i;
-									itoa(*((uint32_t *)esp), &conv_buf[8], 16);
-									i = starting_index = strlen(&conv_buf[8]);
-									while(i < 8) {
-										conv_buf[i] = '0';
-										i++;
-									}
-									puts_terminal_active(&conv_buf[starting_index]);
-								}
-								esp++;
-							}
-							break;
-
-						/* Print a number in unsigned int form */
-						case 'u':
-							{
-								int8_t conv_buf[36];
-								itoa(*((uint32_t *)esp), conv_buf, 10);
-								puts_terminal_active(conv_buf);
-								esp++;
-							}
-							break;
-
-						/* Print a number in signed int form */
-						case 'd':
-							{
-								int8_t conv_buf[36];
-								int32_t value = *((int32_t *)esp);
-								if(value < 0) {
-									conv_buf[0] = '-';
-									itoa(-value, &conv_buf[1], 10);
-								} else {
-									itoa(value, conv_buf, 10);
-								}
-								puts_terminal_active(conv_buf);
-								esp++;
-							}
-							break;
-
-						/* Print a single character */
-						case 'c':
-							putc_terminal_active((uint8_t) *((int32_t *)esp) );
-							esp++;
-							break;
-
-						/* Print a NULL-terminated string */
-						case 's':
-							puts_terminal_active( *((int8_t **)esp) );
-							esp++;
-							break;
-
-						default:
-							break;
+					int64_t signed_value;
+					if (longs >= FMT_LONG_LONG) {
+						signed_value = *((int64_t *)esp);
+						esp += 2;
+					} else {
+						signed_value = *((int32_t *)esp++);
 					}
-
+					spec.negative = signed_value < 0;
+					fmt_number(out, spec.negative ? -(uint64_t)signed_value : (uint64_t)signed_value, &spec);
 				}
 				break;
 
+			/* Print a pointer */
+			case 'p':
+				spec.radix = 16;
+				spec.hex_prefix = 1;
+				spec.zero = 1;
+				if (spec.width == 0)
+					spec.width = FMT_HEX_DIGITS + 2;
+				fmt_number(out, *((uint32_t *)esp++), &spec);
+				break;
+
+			/* Print a single character */
+			case 'c':
+				if (!spec.left)
+					fmt_pad(out, ' ', spec.width - 1);
+				fmt_putc(out, (int8_t) *esp++);
+				if (spec.left)
+					fmt_pad(out, ' ', spec.width - 1);
+				break;
+
+			/* Print a NULL-terminated string */
+			case 's':
+				fmt_string(out, *((int8_t **)esp++), &spec);
+				break;
+
+			/* the string ended inside the conversion */
+			case '\0':
+				return;
+
 			default:
-				putc_terminal_active(*buf);
 				break;
 		}
-		buf++;
+		format++;
 	}
-
-	return (buf - format);
 }
-
 /*
 * int32_t puts(int8_t* s);
 *   Inputs: int_8* s = pointer to a string of characters
@@ -488,13 +752,7 @@ int32_t printf_terminal_active(int8_t *format, ...)
 */
 int32_t puts(int8_t* s)
 {
-	register int32_t index = 0;
-	while(s[index] != '\0') {
-		putc(s[index]);
-		index++;
-	}
-
-	return index;
+	return term_puts(cur_term, s);
 }
 
 /*
@@ -505,32 +763,21 @@ int32_t puts(int8_t* s)
 */
 void putc(uint8_t c)
 {
-    if(c == '\n' || c == '\r') {
-        enter();
-    } else {
-        *(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1)) = c;
-		*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = attribute[cur_term];
-        // if (cur_term == TERMINAL_ONE)
-        // 	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM1;
-        // if (cur_term == TERMINAL_TWO)
-        // 	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM2;
-        // if (cur_term == TERMINAL_THREE)
-        // 	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM3;
-        set_screen_pos(screen_x+1, screen_y);
-    }
+	term_putc(cur_term, c);
 }
 
 /*
-* int32_t puts(int8_t* s);
-*   Inputs: int_8* s = pointer to a string of characters
+* int32_t term_puts(uint8_t term, int8_t* s);
+*   Inputs: term -- terminal to write to
+*			int_8* s = pointer to a string of characters
 *   Return Value: Number of bytes written
-*	Function: Output a string to the console
+*	Function: Output a string to a terminal
 */
-int32_t puts_terminal_active(int8_t* s)
+int32_t term_puts(uint8_t term, int8_t* s)
 {
 	register int32_t index = 0;
 	while(s[index] != '\0') {
-		putc_terminal_active(s[index]);
+		term_putc(term, s[index]);
 		index++;
 	}
 
@@ -538,26 +785,356 @@ int32_t puts_terminal_active(int8_t* s)
 }
 
 /*
-* void putc(uint8_t c);
-*   Inputs: uint_8* c = character to print
+* void term_putc(uint8_t term, uint8_t c);
+*   Inputs: term -- terminal to write to
+*			uint_8* c = character to print
 *   Return Value: void
-*	Function: Output a character to the console
+*	Function: Output a character to a terminal; it goes straight into the terminal's
+*			  video memory whether it is displayed or not
 */
-void putc_terminal_active(uint8_t c)
+void term_putc(uint8_t term, uint8_t c)
 {
+	/* queued terminal_write output goes first */
+	terminal_out_flush(term);
     if(c == '\n' || c == '\r') {
-        enter_term_exec();
+        term_enter(term);
     } else {
-        *(uint8_t *)(terminal[cur_active_terminal].video_mem + ((NUM_COLS*terminal[cur_active_terminal].pos_y + terminal[cur_active_terminal].pos_x) << 1)) = c;
-		*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = attribute[cur_term];
-        // if (cur_term == TERMINAL_ONE)
-        // 	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM1;
-        // if (cur_term == TERMINAL_TWO)
-        // 	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM2;
-        // if (cur_term == TERMINAL_THREE)
-        // 	*(uint8_t *)(video_mem + ((NUM_COLS*screen_y + screen_x) << 1) + 1) = ATTRIB_TERM3;
-        set_screen_pos_term_exec(terminal[cur_active_terminal].pos_x+1, terminal[cur_active_terminal].pos_y);
+        *(uint8_t *)(term_screen(term) + ((NUM_COLS*screen_y[term] + screen_x[term]) << 1)) = c;
+		*(uint8_t *)(term_screen(term) + ((NUM_COLS*screen_y[term] + screen_x[term]) << 1) + 1) = text_attr[term];
+        term_set_pos(term, screen_x[term]+1, screen_y[term]);
     }
+	vga_counters.bytes++;
+}
+
+/*
+* int32_t term_write(uint8_t term, const uint8_t* buf, int32_t nbytes);
+*   Inputs: term -- terminal to write to
+*			buf -- raw bytes, '%' and '\0' are not special
+*			nbytes -- number of bytes in buf
+*   Return Value: nbytes
+*	Function: Output for terminal_write. Runs of plain text go to term_write_text (or
+*			  a character at a time while a scroll region is set); ANSI escape
+*			  sequences go through ansi_putc.
+*/
+int32_t term_write(uint8_t term, const uint8_t* buf, int32_t nbytes)
+{
+	int32_t done, len;
+
+	for (done = 0; done < nbytes; done += len) {
+		if (ansi[term].state != ANSI_NORMAL || buf[done] == ANSI_ESC) {
+			ansi_putc(term, buf[done]);
+			len = 1;
+			continue;
+		}
+
+		for (len = 1; done + len < nbytes && buf[done + len] != ANSI_ESC; len++);
+		if (ansi[term].region == 0) {
+			term_write_text(term, buf + done, len);
+		} else {
+			int32_t i;
+			for (i = 0; i < len; i++)
+				region_putc(term, buf[done + i]);
+		}
+	}
+
+	if (term == cur_term)
+		set_cursor_pos();
+	vga_counters.bytes += nbytes;
+	return nbytes;
+}
+
+/*
+* void term_write_text(uint8_t term, const uint8_t* buf, int32_t nbytes);
+*   Inputs: term -- terminal to write to
+*			buf -- text without escape sequences
+*			nbytes -- number of bytes in buf
+*   Return Value: none
+*	Function: Bulk text output. The bytes are taken a screenful at a time: the rows the
+*			  batch needs are scrolled off in one go, then the text is stored straight
+*			  into video memory a row at a time. The cursor is left to the caller.
+*/
+static void term_write_text(uint8_t term, const uint8_t* buf, int32_t nbytes)
+{
+	uint16_t cell = text_attr[term] << 8;
+	uint16_t* row;
+	int32_t done, len, rows, over, i;
+	int32_t x, y;
+	uint8_t c;
+
+	for (done = 0; done < nbytes; done += len) {
+		/* take bytes until they have moved down a screenful */
+		x = screen_x[term];
+		rows = 0;
+		for (len = 0; done + len < nbytes && rows < NUM_ROWS - 1; len++) {
+			c = buf[done + len];
+			if (c == '\n' || c == '\r' || ++x == NUM_COLS) {
+				rows++;
+				x = ROW_START;
+			}
+		}
+
+		/* one scroll for the whole batch */
+		over = screen_y[term] + rows - (NUM_ROWS - 1);
+		if (over > 0) {
+			term_scroll(term, over);
+			screen_y[term] -= over;
+		}
+
+		x = screen_x[term];
+		y = screen_y[term];
+		row = (uint16_t*)term_screen(term) + NUM_COLS * y;
+		for (i = done; i < done + len; i++) {
+			c = buf[i];
+			if (c != '\n' && c != '\r') {
+				row[x] = cell | c;
+				if (++x < NUM_COLS)
+					continue;
+			}
+			x = ROW_START;
+			y++;
+			row += NUM_COLS;
+		}
+		screen_x[term] = x;
+		screen_y[term] = y;
+	}
+}
+
+/*
+* void region_putc(uint8_t term, uint8_t c);
+*   Inputs: term -- terminal to write to
+*			c -- character, '\n' and '\r' start a new line
+*   Return Value: none
+*	Function: Text output while a scroll region is set: a new line at the region's
+*			  bottom row scrolls only the region, by copying its rows up. Those rows
+*			  do not go to the scrollback.
+*/
+static void region_putc(uint8_t term, uint8_t c)
+{
+	uint16_t* screen = (uint16_t*)term_screen(term);
+	ansi_t* a = &ansi[term];
+
+	if (c != '\n' && c != '\r') {
+		screen[NUM_COLS * screen_y[term] + screen_x[term]] = text_attr[term] << 8 | c;
+		if (++screen_x[term] < NUM_COLS)
+			return;
+	}
+	screen_x[term] = ROW_START;
+
+	if (screen_y[term] == a->bottom) {
+		memmove(screen + NUM_COLS * a->top, screen + NUM_COLS * (a->top + 1),
+				(a->bottom - a->top) * NUM_COLS * sizeof(uint16_t));
+		memset_word(screen + NUM_COLS * a->bottom, text_attr[term] << 8 | ' ', NUM_COLS);
+	} else if (screen_y[term] < NUM_ROWS - 1) {
+		screen_y[term]++;
+	}
+}
+
+/*
+* void ansi_putc(uint8_t term, uint8_t c);
+*   Inputs: term -- terminal the sequence is written to
+*			c -- next byte of the sequence, starting with ESC
+*   Return Value: none
+*	Function: Escape sequence state machine. Only CSI sequences (ESC '[' parameters
+*			  final byte) do anything, see ansi_csi; any other escape is dropped with
+*			  the byte after ESC.
+*/
+static void ansi_putc(uint8_t term, uint8_t c)
+{
+	ansi_t* a = &ansi[term];
+
+	switch (a->state) {
+		case ANSI_NORMAL:
+			a->state = ANSI_ESCAPE;
+			break;
+
+		case ANSI_ESCAPE:
+			if (c == '[') {
+				a->state = ANSI_CSI;
+				a->private = 0;
+				a->nparams = 0;
+			} else {
+				a->state = ANSI_NORMAL;
+			}
+			break;
+
+		case ANSI_CSI:
+			if (c >= '0' && c <= '9') {
+				if (a->nparams == 0)
+					a->params[a->nparams++] = 0;
+				if (a->nparams <= ANSI_MAX_PARAMS && a->params[a->nparams - 1] < ANSI_MAX_VALUE)
+					a->params[a->nparams - 1] = a->params[a->nparams - 1] * 10 + (c - '0');
+			} else if (c == ';') {
+				if (a->nparams == 0)
+					a->params[a->nparams++] = 0;
+				if (a->nparams < ANSI_MAX_PARAMS)
+					a->params[a->nparams] = 0;
+				if (a->nparams <= ANSI_MAX_PARAMS)
+					a->nparams++;
+			} else if (c == '?') {
+				a->private = 1;
+			} else if (c >= ANSI_FINAL_MIN && c <= ANSI_FINAL_MAX) {
+				if (a->nparams > ANSI_MAX_PARAMS)
+					a->nparams = ANSI_MAX_PARAMS;
+				if (!a->private)
+					ansi_csi(term, c);
+				a->state = ANSI_NORMAL;
+			} else if (c == ANSI_ESC) {
+				a->state = ANSI_ESCAPE;
+			} else if (c < ANSI_INTERMEDIATE_MIN) {
+				/* a control character cancels the sequence */
+				a->state = ANSI_NORMAL;
+			}
+			break;
+	}
+}
+
+/*
+* void ansi_csi(uint8_t term, uint8_t final);
+*   Inputs: term -- terminal the sequence was written to
+*			final -- the sequence's final byte
+*   Return Value: none
+*	Function: Carries out a complete CSI sequence. Understands cursor up/down/forward/
+*			  back (A B C D), column (G), position (H f), erase in display (J) and in
+*			  line (K), colors (m) and the scroll region (r). Rows and columns count
+*			  from 1 and the cursor is kept on the screen.
+*/
+static void ansi_csi(uint8_t term, uint8_t final)
+{
+	ansi_t* a = &ansi[term];
+	uint32_t p0 = (a->nparams > 0) ? a->params[0] : 0;
+	uint32_t p1 = (a->nparams > 1) ? a->params[1] : 0;
+	uint32_t n = (p0 == 0) ? 1 : p0;
+	int32_t x = screen_x[term];
+	int32_t y = screen_y[term];
+	uint32_t cursor = NUM_COLS * y + x;
+
+	switch (final) {
+		case 'A': y -= n; break;
+		case 'B': y += n; break;
+		case 'C': x += n; break;
+		case 'D': x -= n; break;
+		case 'G': x = n - 1; break;
+		case 'H':
+		case 'f':
+			y = n - 1;
+			x = (p1 == 0) ? 0 : p1 - 1;
+			break;
+
+		case 'J':
+			if (p0 == 0)
+				ansi_erase(term, cursor, NUM_ROWS * NUM_COLS);
+			else if (p0 == 1)
+				ansi_erase(term, 0, cursor + 1);
+			else if (p0 == 2)
+				ansi_erase(term, 0, NUM_ROWS * NUM_COLS);
+			break;
+
+		case 'K':
+			if (p0 == 0)
+				ansi_erase(term, cursor, NUM_COLS * (y + 1));
+			else if (p0 == 1)
+				ansi_erase(term, NUM_COLS * y, cursor + 1);
+			else if (p0 == 2)
+				ansi_erase(term, NUM_COLS * y, NUM_COLS * (y + 1));
+			break;
+
+		case 'm':
+			ansi_sgr(term);
+			break;
+
+		case 'r':
+			p1 = (p1 == 0 || p1 > NUM_ROWS) ? NUM_ROWS : p1;
+			if (n >= p1)
+				return;
+			a->top = n - 1;
+			a->bottom = p1 - 1;
+			a->region = (a->top != 0 || a->bottom != NUM_ROWS - 1);
+			x = y = 0;
+			break;
+
+		default:
+			return;
+	}
+
+	if (x < 0)
+		x = 0;
+	if (x > NUM_COLS - 1)
+		x = NUM_COLS - 1;
+	if (y < 0)
+		y = 0;
+	if (y > NUM_ROWS - 1)
+		y = NUM_ROWS - 1;
+	screen_x[term] = x;
+	screen_y[term] = y;
+}
+
+/*
+* void term_ansi_reset(uint8_t term);
+*   Inputs: term -- terminal
+*   Return Value: none
+*	Function: Forgets a half written escape sequence, the scroll region and the colors a
+*			  program set, so they do not outlive it
+*/
+void term_ansi_reset(uint8_t term)
+{
+	/* what the program wrote last is still drawn its way */
+	terminal_out_flush(term);
+	ansi[term].state = ANSI_NORMAL;
+	ansi[term].region = 0;
+	text_attr[term] = attribute[term];
+}
+
+/*
+* void ansi_erase(uint8_t term, uint32_t from, uint32_t to);
+*   Inputs: term -- terminal to erase on
+*			from, to -- cells from the top left of the screen, to is not erased
+*   Return Value: none
+*	Function: Blanks part of the screen in the current background color
+*/
+static void ansi_erase(uint8_t term, uint32_t from, uint32_t to)
+{
+	if (from < to)
+		memset_word((uint16_t*)term_screen(term) + from, text_attr[term] << 8 | ' ', to - from);
+}
+
+/*
+* void ansi_sgr(uint8_t term);
+*   Inputs: term -- terminal the sequence was written to
+*   Return Value: none
+*	Function: Select Graphic Rendition: 0 back to the terminal's own colors, 1 and 22
+*			  bright and normal text, 30-37 / 90-97 text color, 40-47 background
+*			  color, 39 / 49 the terminal's own text / background color. Anything
+*			  else is ignored.
+*/
+static void ansi_sgr(uint8_t term)
+{
+	ansi_t* a = &ansi[term];
+	uint8_t attr = text_attr[term];
+	uint32_t i, p;
+
+	if (a->nparams == 0)
+		attr = attribute[term];
+
+	for (i = 0; i < a->nparams; i++) {
+		p = a->params[i];
+		if (p == 0)
+			attr = attribute[term];
+		else if (p == 1)
+			attr |= VGA_BRIGHT;
+		else if (p == 22)
+			attr &= ~VGA_BRIGHT;
+		else if (p >= 30 && p <= 37)
+			attr = (attr & ~VGA_FG_COLOR) | ansi_color[p - 30];
+		else if (p == 39)
+			attr = (attr & ~VGA_FG_MASK) | (attribute[term] & VGA_FG_MASK);
+		else if (p >= 40 && p <= 47)
+			attr = (attr & ~VGA_BG_MASK) | (ansi_color[p - 40] << 4);
+		else if (p == 49)
+			attr = (attr & ~VGA_BG_MASK) | (attribute[term] & VGA_BG_MASK);
+		else if (p >= 90 && p <= 97)
+			attr = (attr & ~VGA_FG_MASK) | ansi_color[p - 90] | VGA_BRIGHT;
+	}
+	text_attr[term] = attr;
 }
 
 /*
@@ -640,47 +1217,80 @@ uint32_t strlen(const int8_t* s)
 	return len;
 }
 
+/*
+* void set_small(uint8_t* d, uint32_t fill, uint32_t n);
+*   Inputs: d = memory to set
+*			fill = the byte repeated four times
+*			n = number of bytes, below MEM_SMALL
+*   Return Value: none
+*	Function: at most four stores, no loop
+*/
+static void set_small(uint8_t* d, uint32_t fill, uint32_t n)
+{
+	asm volatile("                  \n\
+			testl   $8, %%ecx       \n\
+			jz      1f              \n\
+			movl    %%eax, (%%edi)  \n\
+			movl    %%eax, 4(%%edi) \n\
+			addl    $8, %%edi       \n\
+			1:                      \n\
+			testl   $4, %%ecx       \n\
+			jz      2f              \n\
+			movl    %%eax, (%%edi)  \n\
+			addl    $4, %%edi       \n\
+			2:                      \n\
+			testl   $2, %%ecx       \n\
+			jz      3f              \n\
+			movw    %%ax, (%%edi)   \n\
+			addl    $2, %%edi       \n\
+			3:                      \n\
+			testl   $1, %%ecx       \n\
+			jz      4f              \n\
+			movb    %%al, (%%edi)   \n\
+			4:                      \n\
+			"
+			: "+D"(d)
+			: "a"(fill), "c"(n)
+			: "memory", "cc"
+			);
+}
+
 /*
 * void* memset(void* s, int32_t c, uint32_t n);
 *   Inputs: void* s = pointer to memory
 *			int32_t c = value to set memory to
 *			uint32_t n = number of bytes to set
 *   Return Value: new string
-*	Function: set n consecutive bytes of pointer s to value c
+*	Function: set n consecutive bytes of pointer s to value c. Short runs are stored
+*			  directly; longer ones are aligned to 4 bytes and done with rep stosl.
 */
 void* memset(void* s, int32_t c, uint32_t n)
 {
-	c &= 0xFF;
+	uint32_t fill = (c & 0xFF) * 0x01010101;
+	uint32_t head = -(uint32_t)s & 0x3;
+	uint32_t count;
+	uint8_t* d = s;
+
+	if (n < MEM_SMALL) {
+		set_small(d, fill, n);
+		return s;
+	}
+
 	asm volatile("                  \n\
-			.memset_top:            \n\
-			testl   %%ecx, %%ecx    \n\
-			jz      .memset_done    \n\
-			testl   $0x3, %%edi     \n\
-			jz      .memset_aligned \n\
-			movb    %%al, (%%edi)   \n\
-			addl    $1, %%edi       \n\
-			subl    $1, %%ecx       \n\
-			jmp     .memset_top     \n\
-			.memset_aligned:        \n\
-			movw    %%ds, %%dx      \n\
-			movw    %%dx, %%es      \n\
-			movl    %%ecx, %%edx    \n\
-			shrl    $2, %%ecx       \n\
-			andl    $0x3, %%edx     \n\
+			pushl   %%ds            \n\
+			popl    %%es            \n\
 			cld                     \n\
+			rep     stosb           \n\
+			movl    %%edx, %%ecx    \n\
+			shrl    $2, %%ecx       \n\
 			rep     stosl           \n\
-			.memset_bottom:         \n\
-			testl   %%edx, %%edx    \n\
-			jz      .memset_done    \n\
-			movb    %%al, (%%edi)   \n\
-			addl    $1, %%edi       \n\
-			subl    $1, %%edx       \n\
-			jmp     .memset_bottom  \n\
-			.memset_done:           \n\
+			movl    %%edx, %%ecx    \n\
+			andl    $0x3, %%ecx     \n\
+			rep     stosb           \n\
 			"
-			:
-			: "a"(c << 24 | c << 16 | c << 8 | c), "D"(s), "c"(n)
-			: "edx", "memory", "cc"
+			: "=&c"(count), "+D"(d)
+			: "0"(head), "a"(fill), "d"(n - head)
+			: "memory", "cc"
 			);
 
 	return s;
@@ -735,50 +1345,179 @@ void* memset_dword(void* s, int32_t c, uint32_t n)
 }
 
 /*
-* void* memcpy(void* dest, const void* src, uint32_t n);
-*   Inputs: void* dest = destination of copy
-*			const void* src = source of copy
-*			uint32_t n = number of byets to copy
-*   Return Value: pointer to dest
-*	Function: copy n bytes of src to dest
+* void copy_small(uint8_t* d, const uint8_t* s, uint32_t n);
+*   Inputs: d = destination of copy
+*			s = source of copy
+*			n = number of bytes, below MEM_SMALL
+*   Return Value: none
+*	Function: at most four loads and stores, no loop. Front to back, each piece
+*			  loaded before it is stored.
 */
-void* memcpy(void* dest, const void* src, uint32_t n)
+static void copy_small(uint8_t* d, const uint8_t* s, uint32_t n)
 {
+	uint32_t lo, hi;
+
 	asm volatile("                  \n\
-			.memcpy_top:            \n\
-			testl   %%ecx, %%ecx    \n\
-			jz      .memcpy_done    \n\
-			testl   $0x3, %%edi     \n\
-			jz      .memcpy_aligned \n\
+			testl   $8, %%ecx       \n\
+			jz      1f              \n\
+			movl    (%%esi), %%eax  \n\
+			movl    4(%%esi), %%edx \n\
+			movl    %%eax, (%%edi)  \n\
+			movl    %%edx, 4(%%edi) \n\
+			addl    $8, %%esi       \n\
+			addl    $8, %%edi       \n\
+			1:                      \n\
+			testl   $4, %%ecx       \n\
+			jz      2f              \n\
+			movl    (%%esi), %%eax  \n\
+			movl    %%eax, (%%edi)  \n\
+			addl    $4, %%esi       \n\
+			addl    $4, %%edi       \n\
+			2:                      \n\
+			testl   $2, %%ecx       \n\
+			jz      3f              \n\
+			movw    (%%esi), %%ax   \n\
+			movw    %%ax, (%%edi)   \n\
+			addl    $2, %%esi       \n\
+			addl    $2, %%edi       \n\
+			3:                      \n\
+			testl   $1, %%ecx       \n\
+			jz      4f              \n\
 			movb    (%%esi), %%al   \n\
 			movb    %%al, (%%edi)   \n\
-			addl    $1, %%edi       \n\
-			addl    $1, %%esi       \n\
-			subl    $1, %%ecx       \n\
-			jmp     .memcpy_top     \n\
-			.memcpy_aligned:        \n\
-			movw    %%ds, %%dx      \n\
-			movw    %%dx, %%es      \n\
-			movl    %%ecx, %%edx    \n\
-			shrl    $2, %%ecx       \n\
-			andl    $0x3, %%edx     \n\
+			4:                      \n\
+			"
+			: "+S"(s), "+D"(d), "=&a"(lo), "=&d"(hi)
+			: "c"(n)
+			: "memory", "cc"
+			);
+}
+
+/*
+* void copy_rep(uint8_t* d, const uint8_t* s, uint32_t n);
+*   Inputs: d = destination of copy
+*			s = source of copy
+*			n = number of bytes
+*   Return Value: none
+*	Function: bytes up to a 4 byte aligned destination, then rep movsl and the
+*			  leftover bytes, all front to back
+*/
+static void copy_rep(uint8_t* d, const uint8_t* s, uint32_t n)
+{
+	uint32_t head = -(uint32_t)d & 0x3;
+	uint32_t count;
+
+	if (head > n)
+		head = n;
+
+	asm volatile("                  \n\
+			movw    %%ds, %%ax      \n\
+			movw    %%ax, %%es      \n\
 			cld                     \n\
+			rep     movsb           \n\
+			movl    %%edx, %%ecx    \n\
+			shrl    $2, %%ecx       \n\
 			rep     movsl           \n\
-			.memcpy_bottom:         \n\
-			testl   %%edx, %%edx    \n\
-			jz      .memcpy_done    \n\
-			movb    (%%esi), %%al   \n\
-			movb    %%al, (%%edi)   \n\
-			addl    $1, %%edi       \n\
-			addl    $1, %%esi       \n\
-			subl    $1, %%edx       \n\
-			jmp     .memcpy_bottom  \n\
-			.memcpy_done:           \n\
+			movl    %%edx, %%ecx    \n\
+			andl    $0x3, %%ecx     \n\
+			rep     movsb           \n\
 			"
-			:
-			: "S"(src), "D"(dest), "c"(n)
-			: "eax", "edx", "memory", "cc"
+			: "=&c"(count), "+S"(s), "+D"(d)
+			: "0"(head), "d"(n - head)
+			: "eax", "memory", "cc"
 			);
+}
+
+/*
+* void copy_sse(uint8_t* d, const uint8_t* s, uint32_t n);
+*   Inputs: d = destination of copy
+*			s = source of copy
+*			n = number of bytes, at least MEM_SSE_MIN
+*   Return Value: none
+*	Function: 64 bytes per round through xmm0-3, unaligned loads and aligned stores,
+*			  front to back with each round loaded before it is stored. Interrupts
+*			  are only off for MEM_SSE_CHUNK bytes at a time (see kernel_fpu_begin).
+*			  The compiler does not use the SSE registers, so they are not clobbers.
+*/
+static void copy_sse(uint8_t* d, const uint8_t* s, uint32_t n)
+{
+	uint32_t head = -(uint32_t)d & 0xF;
+	uint32_t chunk, flags;
+
+	copy_small(d, s, head);
+	d += head;
+	s += head;
+	n -= head;
+
+	while (n >= MEM_SSE_BLOCK) {
+		chunk = n & ~(MEM_SSE_BLOCK - 1);
+		if (chunk > MEM_SSE_CHUNK)
+			chunk = MEM_SSE_CHUNK;
+		n -= chunk;
+
+		flags = kernel_fpu_begin();
+		asm volatile("                      \n\
+				1:                          \n\
+				movups  (%%esi), %%xmm0     \n\
+				movups  16(%%esi), %%xmm1   \n\
+				movups  32(%%esi), %%xmm2   \n\
+				movups  48(%%esi), %%xmm3   \n\
+				movaps  %%xmm0, (%%edi)     \n\
+				movaps  %%xmm1, 16(%%edi)   \n\
+				movaps  %%xmm2, 32(%%edi)   \n\
+				movaps  %%xmm3, 48(%%edi)   \n\
+				addl    $64, %%esi          \n\
+				addl    $64, %%edi          \n\
+				subl    $64, %%ecx          \n\
+				jnz     1b                  \n\
+				"
+				: "+S"(s), "+D"(d), "+c"(chunk)
+				:
+				: "memory", "cc"
+				);
+		kernel_fpu_end(flags);
+	}
+
+	if (n < MEM_SMALL)
+		copy_small(d, s, n);
+	else
+		copy_rep(d, s, n);
+}
+
+/*
+* int32_t mem_user_range(const void* p, uint32_t n);
+*   Inputs: p = start of a buffer
+*			n = its length
+*   Return Value: 1 if the buffer overlaps the user pages (MEM_USER_START ~ MEM_USER_END)
+*	Function: tells memcpy which copies could fault
+*/
+static int32_t mem_user_range(const void* p, uint32_t n)
+{
+	uint32_t start = (uint32_t)p;
+
+	return start < MEM_USER_END && (start + n > MEM_USER_START || start + n < start);
+}
+
+/*
+* void* memcpy(void* dest, const void* src, uint32_t n);
+*   Inputs: void* dest = destination of copy
+*			const void* src = source of copy
+*			uint32_t n = number of byets to copy
+*   Return Value: pointer to dest
+*	Function: copy n bytes of src to dest, picking the routine by size: straight
+*			  moves below MEM_SMALL, SSE from MEM_SSE_MIN when the CPU has it, rep
+*			  movsl in between. Every routine copies front to back, which memmove
+*			  relies on. SSE is only used between kernel buffers: a page fault inside
+*			  copy_sse would leave interrupts off and CR0.TS clear.
+*/
+void* memcpy(void* dest, const void* src, uint32_t n)
+{
+	if (n < MEM_SMALL)
+		copy_small(dest, src, n);
+	else if (n >= MEM_SSE_MIN && fpu_has_sse && !mem_user_range(dest, n) && !mem_user_range(src, n))
+		copy_sse(dest, src, n);
+	else
+		copy_rep(dest, src, n);
 
 	return dest;
 }
@@ -789,26 +1528,34 @@ void* memcpy(void* dest, const void* src, uint32_t n)
 *			const void* src = source of move
 *			uint32_t n = number of byets to move
 *   Return Value: pointer to dest
-*	Function: move n bytes of src to dest
+*	Function: move n bytes of src to dest. Unless dest overlaps the end of src,
+*			  front to back is safe and memcpy does it; otherwise the copy runs back
+*			  to front, the odd bytes at the end first and then whole dwords.
 */
-/* Optimized memmove (used for overlapping memory areas) */
 void* memmove(void* dest, const void* src, uint32_t n)
 {
+	uint32_t count;
+
+	if ((uint32_t)dest <= (uint32_t)src || (uint32_t)dest >= (uint32_t)src + n)
+		return memcpy(dest, src, n);
+
 	asm volatile("                  \n\
-			movw    %%ds, %%dx      \n\
-			movw    %%dx, %%es      \n\
-			cld                     \n\
-			cmp     %%edi, %%esi    \n\
-			jae     .memmove_go     \n\
-			leal    -1(%%esi, %%ecx), %%esi    \n\
-			leal    -1(%%edi, %%ecx), %%edi    \n\
+			movw    %%ds, %%ax      \n\
+			movw    %%ax, %%es      \n\
+			leal    -1(%%esi, %%edx), %%esi    \n\
+			leal    -1(%%edi, %%edx), %%edi    \n\
 			std                     \n\
-			.memmove_go:            \n\
 			rep     movsb           \n\
+			subl    $3, %%esi       \n\
+			subl    $3, %%edi       \n\
+			movl    %%edx, %%ecx    \n\
+			shrl    $2, %%ecx       \n\
+			rep     movsl           \n\
+			cld                     \n\
 			"
-			:
-			: "D"(dest), "S"(src), "c"(n)
-			: "edx", "memory", "cc"
+			: "=&c"(count), "+S"(src), "+D"(dest)
+			: "0"(n & 0x3), "d"(n)
+			: "eax", "memory", "cc"
 			);
 
 	return dest;
@@ -889,6 +1636,22 @@ int8_t* strncpy(int8_t* dest, const int8_t* src, uint32_t n)
 	return dest;
 }
 
+/*
+* int32_t bad_userspace_addr(const void* addr, int32_t len);
+*   Inputs: const void* addr = start of a buffer handed in by a system call
+*			int32_t len = length of the buffer in bytes
+*   Return Value: 1 if any byte lies outside the user program page, 0 otherwise
+*	Function: validates user buffers before the kernel reads or writes them
+*/
+int32_t bad_userspace_addr(const void* addr, int32_t len)
+{
+	uint32_t start = (uint32_t)addr;
+
+	if (len < 0 || start < _128MB || start + len > _132MB || start + len < start)
+		return 1;
+	return 0;
+}
+
 /*
 * void print_cr3(void)
 * effects: prints the contents of the CR3 Register upon receiving an exception
@@ -916,7 +1679,7 @@ void test_interrupts(void)
 {
 	int32_t i;
 	for (i=0; i < NUM_ROWS*NUM_COLS; i++) {
-		video_mem[i<<1]++;
+		term_screen(cur_term)[i<<1]++;
 	}
 	send_eoi(1);
 }
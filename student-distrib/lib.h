@@ -13,8 +13,61 @@
 #define ATTRIB_TERM3 0x0C
 #define BLUE_SCREEN  0x16
 
+/* Each terminal owns TERM_VGA_SIZE bytes of the 32KB text mode video memory and scrolls
+ * through its VGA_WIN_ROWS rows by moving the CRTC start address; the displayed terminal
+ * is chosen the same way. The page after the terminals holds the scrollback view. */
+#define VGA_CRTC_PORT	0x3D4
+#define CRTC_START_HIGH	0x0C
+#define CRTC_START_LOW	0x0D
+#define TERM_VGA_SIZE	0x2000		/* two video pages per terminal */
+#define TERM_VGA(t)		(VIDEO + (t) * TERM_VGA_SIZE)
+#define VGA_WIN_ROWS	(TERM_VGA_SIZE / (NUM_COLS * 2))
+#define VGA_VIEW_OFFSET	0x6000		/* byte offset of the scrollback view page */
+#define CURSOR_UNKNOWN	0xFFFFFFFF
+
+/* memcpy / memset size classes */
+#define MEM_SMALL		16		/* below this, straight moves without a loop */
+#define MEM_SSE_MIN		512		/* from here memcpy uses SSE, when the CPU has it */
+#define MEM_SSE_BLOCK	64		/* bytes per round of the SSE loop */
+#define MEM_SSE_CHUNK	4096	/* bytes copied per interrupts-off SSE section */
+/* program, vidmap and framebuffer pages: a copy touching them may fault, so no SSE */
+#define MEM_USER_START	_128MB
+#define MEM_USER_END	(_144MB + _4MB)
+
+/* printf formatting */
+#define PRINTF_BUF_SIZE	128		/* stack buffer term_vprintf hands to the terminal */
+#define FMT_NUM_SIZE	24		/* digits of a 64-bit number, with room to spare */
+#define FMT_HEX_DIGITS	8		/* %#x and %p */
+#define FMT_LONG_LONG	2		/* 'l's in "ll" */
+
+/* text attribute bits */
+#define VGA_FG_COLOR	0x07
+#define VGA_BRIGHT		0x08
+#define VGA_FG_MASK		0x0F
+#define VGA_BG_MASK		0x70
+
+/* ANSI escape sequences understood by term_write (ESC '[' params final) */
+#define ANSI_ESC		0x1B
+#define ANSI_NORMAL		0		/* parser states */
+#define ANSI_ESCAPE		1
+#define ANSI_CSI		2
+#define ANSI_MAX_PARAMS	8
+#define ANSI_MAX_VALUE	1000	/* larger parameters stop growing */
+#define ANSI_INTERMEDIATE_MIN	0x20
+#define ANSI_FINAL_MIN	0x40
+#define ANSI_FINAL_MAX	0x7E
+
+/* terminal output and the VGA port writes it cost, copied out by vga_stats */
+typedef struct {
+	uint32_t bytes;				/* bytes written to terminals */
+	uint32_t port_writes;		/* outw to the CRTC (cursor and start address) */
+	uint32_t cursor_updates;	/* cursor moves asked for */
+	uint32_t cursor_flushes;	/* cursor moves that reached the CRTC */
+} vga_stats_t;
+
 /*Global Vars*/
 extern volatile uint8_t keyboard_enabled;
+extern vga_stats_t vga_counters;
 
 /*Display kernel panic message */
 void blue_screen(void);
@@ -26,15 +79,24 @@ int get_screen_y(void);
 
 int32_t printf(int8_t *format, ...);
 
-int32_t printf_terminal_active(int8_t *format, ...);
+int32_t printf_term(uint8_t term, int8_t *format, ...);
+
+int32_t snprintf(int8_t* buf, uint32_t size, int8_t *format, ...);
+
+int32_t vsnprintf(int8_t* buf, uint32_t size, int8_t *format, int32_t *esp);
 
 void putc(uint8_t c);
 
-void putc_terminal_active(uint8_t c);
+void term_putc(uint8_t term, uint8_t c);
 
 int32_t puts(int8_t *s);
 
-int32_t puts_terminal_active(int8_t* s);
+int32_t term_puts(uint8_t term, int8_t* s);
+
+int32_t term_write(uint8_t term, const uint8_t* buf, int32_t nbytes);
+
+/* back to the terminal's own colors, no scroll region, no half parsed escape sequence */
+void term_ansi_reset(uint8_t term);
 
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 
@@ -46,20 +108,31 @@ void clear(void);
 
 void set_screen_pos(uint32_t x, uint32_t y);
 
-void set_screen_pos_term_exec(uint32_t x, uint32_t y);
+void term_set_pos(uint8_t term, uint32_t x, uint32_t y);
 
 void enter(void);
 
-void enter_term_exec(void);
-
 void backspace(void);
 
 void scroll_up(void);
 
-void scroll_up_term_exec();
+/* first cell of a terminal's screen in video memory */
+uint8_t* term_screen(uint8_t term);
+
+/* points the CRTC at the displayed terminal's live screen, unless the scrollback is being viewed */
+void screen_show(void);
+
+/* moves a terminal's screen to the start of its video memory, keeping what is on it */
+void screen_rebase(uint8_t term);
+
+/* sets the CRTC start address, in cells from VIDEO */
+void vga_set_start(uint32_t cell);
 
 void set_cursor_pos(void);
 
+/* applies the last set_cursor_pos to the hardware */
+void cursor_flush(void);
+
 void print_cr3(void);
 
 void* memset(void* s, int32_t c, uint32_t n);
@@ -146,7 +219,7 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-	asm volatile("outl  %l1, (%w0)"     \
+	asm volatile("outl  %k1, (%w0)"     \
 			:                           \
 			: "d" (port), "a" (data)    \
 			: "memory", "cc" );         \
@@ -199,6 +272,24 @@ do {                                    \
 			);                      \
 } while(0)
 	
+/* Executes CPUID for the given leaf and stores eax, ebx, ecx and edx */
+#define cpuid(leaf, a, b, c, d)         \
+do {                                    \
+	asm volatile("cpuid"                \
+			: "=a"(a), "=b"(b), "=c"(c), "=d"(d) \
+			: "a"(leaf)                 \
+			);                          \
+} while(0)
+
+/* Reads the model specific register msr into hi:lo */
+#define rdmsr(msr, lo, hi)              \
+do {                                    \
+	asm volatile("rdmsr"                \
+			: "=a"(lo), "=d"(hi)        \
+			: "c"(msr)                  \
+			);                          \
+} while(0)
+
 /*
 * ASM Wrapper to show "blue screen" and print exception_name
 */	
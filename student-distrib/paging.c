@@ -1,4 +1,5 @@
 #include "paging.h"
+#include "smp.h"
 
 /* ============================== GLOBAL PAGE DIRECTORIES  ======================START= */
 /* declare global page directory array */
@@ -39,7 +40,7 @@ void paging_init() {
     
     /* initialize page table for 0MB ~ 4MB containing video memory */
     for (i = 0; i < NUM_ENTRIES; i++) {
-        if (i >= VM_START && i <= VM_START + 3) {           /* video memory is 4 bytes (0 ~ 3 so +3) */
+        if (i >= VM_START && i < VM_START + VM_PAGES) {     /* all of text mode video memory */
             page_table[i] = (i * 0x1000) | 3;               /* 0x03 = 11 read/write, mark vid mem as present */
         }                                                   /* 12 bits skipped: 0x1000 */
         else{
@@ -83,7 +84,9 @@ void paging_init() {
 
 /* page_remap
  *   DESCRIPTION: Maps a PDE (page directory entry) to the start of the virtual 
- *                address given with the physical address given.
+ *                address given with the physical address given. Nothing is written
+ *                if the entry already maps there, and only that 4MB page is dropped
+ *                from the TLB otherwise.
  *   INPUT: virt_addr -- the 4MB virtual address that function will map
  *          phys_addr -- physical address to be mapped
  *   OUTPUT: none
@@ -92,19 +95,23 @@ void paging_init() {
  */
 void page_remap(uint32_t virt_addr, uint32_t phys_addr) {
     uint32_t page_dir_entry = virt_addr / CONVERT_4MB;
+    uint32_t * pde = &cpu_this()->page_dir[page_dir_entry];
     
     /*  set page directory entry attributes:
         - USER/READ+WRITE/PRESENT
         - 0x80(1000 0000): mark as 4MB page size for kernel entry  */
-    page_directory[page_dir_entry] = phys_addr | 0x87;
+    if (*pde == (phys_addr | PAGE_4MB_USER_ENTRY))
+        return;
+    *pde = phys_addr | PAGE_4MB_USER_ENTRY;
     
-    /* reset the tlb */
-    flush_tlb();
+    /* forget the old translation of this page only */
+    flush_tlb_page(virt_addr);
 }
 
 /* table_remap
  *   DESCRIPTION: Maps a PDE (page directory entry) to the start of 
- *                user page table's first entry.
+ *                user page table's first entry. Skips the TLB flush when both
+ *                entries are already what they should be.
  *   INPUT: virt_addr -- the 4MB virtual address that function will map
  *          phys_addr -- physical address to be mapped
  *   OUTPUT: none
@@ -113,22 +120,30 @@ void page_remap(uint32_t virt_addr, uint32_t phys_addr) {
  */
 void table_remap(uint32_t virt_addr, uint32_t phys_addr) {
     uint32_t page_dir_entry = virt_addr / CONVERT_4MB;
+    cpu_t * cpu = cpu_this();
+    uint32_t pde = ((unsigned int)cpu->user_pt) | PAGE_TABLE_PRESENT_ENTRY;
+    uint32_t pte = phys_addr | PAGE_TABLE_PRESENT_ENTRY;
     
+    if (cpu->page_dir[page_dir_entry] == pde && cpu->user_pt[0] == pte)
+        return;
+
     /* set page directory entry attributes:
        USER/READ+WRITE/PRESENT  */
-    page_directory[page_dir_entry] = ((unsigned int)user_page_table) | PAGE_TABLE_PRESENT_ENTRY;
+    cpu->page_dir[page_dir_entry] = pde;
     
     /* set page directory entry attributes:
        USER/READ+WRITE/PRESENT  */
-    user_page_table[0] = phys_addr | PAGE_TABLE_PRESENT_ENTRY;
+    cpu->user_pt[0] = pte;
     
-    /* reset the tlb */
-    flush_tlb();
+    /* the 136MB vidmap page is the only one this table maps */
+    flush_tlb_page(virt_addr);
 }
 
 /* vidmem_remap
  *   DESCRIPTION: Maps a PDE (page directory entry) to the start of 
- *                video memory page table's first entry.
+ *                video memory page table's first entry. When only the page changes
+ *                just that page is dropped from the TLB; nothing happens if both
+ *                entries are already set.
  *   INPUT: virt_addr -- the 4MB virtual address that function will map
  *          phys_addr -- physical address to be mapped
  *   OUTPUT: none
@@ -137,43 +152,169 @@ void table_remap(uint32_t virt_addr, uint32_t phys_addr) {
  */
 void vidmem_remap(uint32_t virt_addr, uint32_t phys_addr) {
     uint32_t page_dir_entry = virt_addr / CONVERT_4MB;
+    cpu_t * cpu = cpu_this();
+    uint32_t pde = ((unsigned int)cpu->video_pt) | PAGE_TABLE_PRESENT_ENTRY;
+    uint32_t pte = phys_addr | PAGE_TABLE_PRESENT_ENTRY;
+
+    if (cpu->page_dir[page_dir_entry] == pde) {
+        if (cpu->video_pt[0] == pte)
+            return;
+        /* the video page table is only ever reached through this one PDE */
+        cpu->video_pt[0] = pte;
+        flush_tlb_page(virt_addr);
+        return;
+    }
 
     /* set page directory entry attributes:
        USER/READ+WRITE/PRESENT */
-    page_directory[page_dir_entry] = ((unsigned int)video_page_table) | PAGE_TABLE_PRESENT_ENTRY;
+    cpu->page_dir[page_dir_entry] = pde;
     
     /* set page directory entry attributes:
        USER/READ+WRITE/PRESENT  */
-    video_page_table[0] = phys_addr | PAGE_TABLE_PRESENT_ENTRY;
+    cpu->video_pt[0] = pte;
     
+    /* a different page table: the whole 4MB region changes, reset the tlb */
+    flush_tlb();
+}
+
+/* kernel_pde_set
+ *   DESCRIPTION: Sets a kernel PDE in every CPU's page directory, including those of APs
+ *                that are not started yet (paging_clone copies the boot processor's).
+ *                Every kernel entry takes the big kernel lock, so a CPU whose TLB may still
+ *                hold the old entry flushes it in kernel_lock before it can use the region.
+ *   INPUT: page_dir_entry -- index of the 4MB region
+ *          pde -- new entry
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: this CPU's TLB is flushed, the others are marked tlb_stale.
+ */
+static void kernel_pde_set(uint32_t page_dir_entry, uint32_t pde) {
+    cpu_t * me = cpu_this();
+    uint32_t old;
+    uint32_t i;
+
+    for (i = 0; i < MAX_CPUS; i++) {
+        if (cpus[i].page_dir == NULL)
+            continue;
+        old = cpus[i].page_dir[page_dir_entry];
+        cpus[i].page_dir[page_dir_entry] = pde;
+        /* a not-present entry is never cached */
+        if (&cpus[i] != me && (old & PAGE_PRESENT) && old != pde)
+            cpus[i].tlb_stale = 1;
+    }
+
     /* reset the tlb */
     flush_tlb();
 }
 
-/* table_to_page_mapping
- *   DESCRIPTION: Maps a PDE (page directory entry) to specific page in user's page table.
- *   INPUT: virt_addr -- the 4MB virtual address that function will map
- *          phys_addr -- physical address to be mapped
- *          cur_page --  holds the index to the current specific page that we need to remap
+/* mmio_map
+ *   DESCRIPTION: Identity maps the 4MB page holding phys_addr for memory mapped device
+ *                registers (local APIC, IO APIC). Caching is disabled so every access
+ *                reaches the device. Every CPU gets the mapping.
+ *   INPUT: phys_addr -- any address inside the register block
  *   OUTPUT: none
  *   RETURN VALUE: none
- *   SIDE EFFECT: PDE is mapped virually and physically and update specific page in user's page table.
+ *   SIDE EFFECT: PDE for the region is set to kernel-only read/write.
  */
-void table_to_page_mapping(uint32_t virt_addr, uint32_t phys_addr, uint32_t cur_page) {
-    uint32_t page_dir_entry = virt_addr / CONVERT_4MB;
+void mmio_map(uint32_t phys_addr) {
+    uint32_t page_dir_entry = phys_addr / CONVERT_4MB;
+
+    kernel_pde_set(page_dir_entry, (page_dir_entry * CONVERT_4MB) | PAGE_MMIO_ENTRY);
+}
+
+
+/* kernel_map
+ *   DESCRIPTION: Identity maps the 4MB page of RAM holding phys_addr, kernel only and
+ *                cached like the kernel page. Every CPU gets the mapping.
+ *   INPUT: phys_addr -- any address inside the page
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: PDE for the region is set to kernel-only read/write.
+ */
+void kernel_map(uint32_t phys_addr) {
+    uint32_t page_dir_entry = phys_addr / CONVERT_4MB;
+
+    kernel_pde_set(page_dir_entry, (page_dir_entry * CONVERT_4MB) | PAGE_4MB_KERNEL_ENTRY);
+}
+
+/* page_unmap
+ *   DESCRIPTION: Marks a 4MB page directory entry not present. Nothing is written or
+ *                flushed if it is not mapped.
+ *   INPUT: virt_addr -- the 4MB virtual address to unmap
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: PDE of this CPU is cleared.
+ */
+void page_unmap(uint32_t virt_addr) {
+    uint32_t * pde = &cpu_this()->page_dir[virt_addr / CONVERT_4MB];
+
+    if (*pde == PAGE_NOT_PRESENT)
+        return;
+    *pde = PAGE_NOT_PRESENT;
+    flush_tlb_page(virt_addr);
+}
+
+/* low_mem_map
+ *   DESCRIPTION: Marks the identity mapped 4kb pages of the first 4MB present or not present.
+ *                Only video memory is present normally; the MP tables and the AP trampoline
+ *                live in low memory too.
+ *   INPUT: addr -- start of the range
+ *          len -- length of the range in bytes
+ *          present -- 1 to map, 0 to unmap
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: Changes page_table, shared by all CPUs.
+ */
+void low_mem_map(uint32_t addr, uint32_t len, uint32_t present) {
+    uint32_t i;
+
+    for (i = addr / ALIGN_BITS; i <= (addr + len - 1) / ALIGN_BITS && i < NUM_ENTRIES; i++) {
+        if (i >= VM_START && i < VM_START + VM_PAGES)       /* never touch video memory */
+            continue;
+        page_table[i] = (i * ALIGN_BITS) | (present ? 3 : 2);
+    }
 
-    /* set page directory entry attributes:
-       USER/READ+WRITE/PRESENT  */
-    page_directory[page_dir_entry] = ((unsigned int)user_page_table) | PAGE_TABLE_PRESENT_ENTRY;
-    
-    /* set page directory entry attributes:
-       USER/READ+WRITE/PRESENT  */
-    user_page_table[cur_page] = phys_addr | PAGE_TABLE_PRESENT_ENTRY;
-    
     /* reset the tlb */
     flush_tlb();
 }
 
+/* paging_clone
+ *   DESCRIPTION: Gives an application processor its own copy of the boot processor's
+ *                paging structures. The user program page (128MB) and vidmap (136MB)
+ *                differ per CPU, so the directory and both small page tables are copied
+ *                and the copies point at each other.
+ *   INPUT: cpu -- processor whose page_dir, user_pt and video_pt get filled in
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void paging_clone(cpu_t * cpu) {
+    uint32_t i;
+
+    memcpy(cpu->page_dir, page_directory, sizeof(page_directory));
+    memcpy(cpu->user_pt, user_page_table, sizeof(user_page_table));
+    memcpy(cpu->video_pt, video_page_table, sizeof(video_page_table));
+
+    for (i = 0; i < NUM_ENTRIES; i++) {
+        if ((page_directory[i] & ~(ALIGN_BITS - 1)) == (uint32_t)user_page_table)
+            cpu->page_dir[i] = (uint32_t)cpu->user_pt | (page_directory[i] & (ALIGN_BITS - 1));
+        else if ((page_directory[i] & ~(ALIGN_BITS - 1)) == (uint32_t)video_page_table)
+            cpu->page_dir[i] = (uint32_t)cpu->video_pt | (page_directory[i] & (ALIGN_BITS - 1));
+    }
+}
+
+
+/* flush_tlb_page
+ *   DESCRIPTION: Drops the translation of one page (4kb or 4MB) from the TLB, which is
+ *                much cheaper than reloading CR3 and losing every kernel translation too.
+ *   INPUT: virt_addr -- any address inside the page
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: invlpg
+ */
+void flush_tlb_page(uint32_t virt_addr){
+    asm volatile("invlpg (%0)" : : "r"(virt_addr) : "memory");
+}
 
 /* flush_tlb
  *   DESCRIPTION: Flush the tlb by changing the 3rd Control Register. But maybe don't want to alter CR3 value?
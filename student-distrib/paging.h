@@ -8,6 +8,8 @@
 /* ============================== VARIABLE DECLARATIONS ======================START= */
 /* video memory address location described in lib.c */
 #define VM_START        0x0B8
+/* text mode video memory 0xB8000 ~ 0xBFFFF: every terminal's screen and the scrollback view */
+#define VM_PAGES        8
 /* number of entries in page directory and page table (4kb size) */
 #define NUM_ENTRIES     1024
 /* bits to align paging to */
@@ -16,7 +18,12 @@
 
 #define PDE_IDX_SHIFT               22          /* Page directory index in virt. address        */
 #define PAGE_TABLE_PRESENT_ENTRY    7           /* USER/READ+WRITE/PRESENT                      */
+#define PAGE_4MB_USER_ENTRY         0x87        /* 4MB/USER/READ+WRITE/PRESENT                  */
+#define PAGE_4MB_KERNEL_ENTRY       0x83        /* 4MB/SUPERVISOR/READ+WRITE/PRESENT            */
+#define PAGE_NOT_PRESENT            0x02        /* READ+WRITE, not present                      */
+#define PAGE_PRESENT                0x01        /* present bit of any entry                     */
 #define VIDEO                       0xB8000     /* Address of video memory page                 */
+#define PAGE_MMIO_ENTRY             0x93        /* 4MB/CACHE DISABLE/SUPERVISOR/READ+WRITE/PRESENT */
 
 /* declare global page directory array */
 extern uint32_t page_directory[NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
@@ -24,6 +31,9 @@ extern uint32_t page_directory[NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)))
 extern uint32_t page_table[NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
 /* declare global page table for 128MB ~ 132MB (1024 entries) */
 extern uint32_t video_pages[NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
+/* boot processor's user and video memory page tables, copied per CPU by paging_clone */
+extern uint32_t user_page_table[NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
+extern uint32_t video_page_table[NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
 /* =============================================================================END= */
 
 
@@ -36,10 +46,21 @@ void page_remap(uint32_t virt_addr, uint32_t phys_addr);
 void vidmem_remap(uint32_t virt_addr, uint32_t phys_addr);
 /* maps 4MB page to user's page table */
 void table_remap(uint32_t virt_addr, uint32_t phys_addr);
-/* find 4MB page given virtual and physical addr */
-void table_to_page_mapping(uint32_t virt_addr, uint32_t phys_addr, uint32_t cur_page);
+/* identity maps the 4MB region holding a device's registers */
+void mmio_map(uint32_t phys_addr);
+/* identity maps a 4MB page of RAM for the kernel only */
+void kernel_map(uint32_t phys_addr);
+/* removes a 4MB mapping made by page_remap */
+void page_unmap(uint32_t virt_addr);
+/* map or unmap identity pages in the first 4MB */
+void low_mem_map(uint32_t addr, uint32_t len, uint32_t present);
+/* give an application processor its own copy of the page tables */
+struct cpu;
+void paging_clone(struct cpu * cpu);
 /* get rid of old info in tlb */
 void flush_tlb(void);
+/* get rid of one page's translation in the tlb */
+void flush_tlb_page(uint32_t virt_addr);
 /* =============================================================================END= */
 
 #endif
@@ -4,10 +4,24 @@
 #include "types.h"
 #include "syscalls.h"
 #include "scheduler.h"
-#include "terminal.h"
+#include "tasklet.h"
 
-/* To keep track of state of interrupt */
-volatile int rtc_interrupt_occurred [3] = { 0, 0, 0 };
+/* virtual RTC of every open RTC fd, by process and fd */
+static rtc_vfd_t rtc_vfds[NUM_MAX_PROCESSES][NUM_MAX_OPEN_FILES];
+/* slots in use, the interrupt handler skips the walk when there are none */
+static int32_t rtc_vfds_used = 0;
+/* interrupts rtc_bh has not yet handed out to the fds */
+static volatile int32_t rtc_unseen = 0;
+/* runs rtc_bh once the interrupt is over */
+static tasklet_t rtc_tasklet;
+/* processes sleeping in rtc_read until their fd ticks */
+static wait_queue_t rtc_wait_queue;
+/* current interrupt rate, the RTC powers up at 1024 Hz */
+int32_t rtc_cur_freq = 1024;
+
+static rtc_vfd_t * rtc_vfd(int32_t fd);
+static void rtc_retune(void);
+static void rtc_bh(uint32_t data);
 
 /*
 *   Function: init_rtc()
@@ -30,6 +44,10 @@ void init_rtc(void){
 	/* Writ ethe previous value OR'd with 0x40. Turns on bit 6 of Register B */
     outb(a_old | 0x40, CMOS_PORT);
 	
+	init_wait_queue(&rtc_wait_queue);
+	tasklet_init(&rtc_tasklet, "rtc", rtc_bh, 0);
+	rtc_set_freq(2);
+
 	/* Enable appropriate IRQ Line on PIC (Line #8) */
  	enable_irq(RTC_IRQ_LINE);
  }
@@ -37,24 +55,59 @@ void init_rtc(void){
 
 /*
 *	Function: rtc_interrupt_handler()
-*	Description: This function is only implemented for Checkpoint 1
-*				 and upon every RTC interrupt it calls test_interrupts()
+*	Description: counts the interrupt for the open RTC fds and leaves advancing their
+*				 dividers to rtc_bh, run as a tasklet once the handler returns
 *	input:	none
 *	output: none
-*	effects: (eventually) updates video memory and sends end of interrupt to RTC IRQ Line
+*	effects: sends end of interrupt to RTC IRQ Line, acknowledges the RTC
 */
 void rtc_interrupt_handler(void){
 	/* Send EOI to IRQ Line */
 	send_eoi(RTC_IRQ_LINE);
-	int i;
-	cli();
-	for (i = 0; i < MAX_TERM; i++)
-	{
-		rtc_interrupt_occurred[i] = 1; //change interrupt variable to show that it is occuring
+	if (rtc_vfds_used) {
+		rtc_unseen++;
+		tasklet_schedule(&rtc_tasklet);
 	}
+	/* keeps the tick accounting going while the PIT is stopped */
+	tick_rtc_elapsed(rtc_cur_freq);
 	outb(0x0C, RTC_PORT); 	//select register C
 	inb(CMOS_PORT); 		//throw away contents
-	sti();
+}
+
+
+/*
+*	Function: rtc_bh()
+*	Description: tasklet: advances every open fd's divider by the interrupts since the last
+*				 run and wakes the readers when one of them ticked
+*	input:	data -- unused
+*	output: none
+*	effects: none
+*/
+static void rtc_bh(uint32_t data){
+	rtc_vfd_t * v;
+	uint32_t flags;
+	int32_t unseen;
+	int i;
+	int ticked = 0;
+
+	cli_and_save(flags);
+	unseen = rtc_unseen;
+	rtc_unseen = 0;
+	restore_flags(flags);
+
+	for (i = 0, v = &rtc_vfds[0][0]; i < NUM_MAX_PROCESSES * NUM_MAX_OPEN_FILES; i++, v++)
+	{
+		if (v->freq == 0)
+			continue;
+		v->count += unseen;
+		while (v->count >= v->divider) {
+			v->count -= v->divider;
+			v->pending++;
+			ticked = 1;
+		}
+	}
+	if (ticked)
+		wake_up(&rtc_wait_queue);
 }
 
 
@@ -63,13 +116,11 @@ void rtc_interrupt_handler(void){
 *	Description: This will be our main funciton to open the RTC
 *	input: pointer to filename
 *	output: returns 0 always
-*	effects: Opens the rtc and initializes frequency to 2 HZ
+*	effects: none, the fd's virtual RTC starts at its first read or write
+*			 (rtc_close left the slot free)
 */
 int32_t rtc_open(const uint8_t * filename){
 
-	/* Set RTC Frequency to 2 Hz */
-    rtc_set_freq(2);
-
     /* Always return 0 */
     return 0;
 }
@@ -77,20 +128,32 @@ int32_t rtc_open(const uint8_t * filename){
 
  /*
  *	Function: rtc_read()
- *	Description: This will read the contents within the RTC only after an interrupt has occured
+ *	Description: This will read the contents within the RTC only after the fd's virtual
+ *				 RTC ticked at the rate written to it (RTC_DEFAULT_FREQ if none was)
  *	input: file descriptor, buffer to read into, and number of bytes
- *	output: returns 0 upon success
+ *	output: returns 0 upon success, -1 for a bad fd
  *	effects: Reads the RTC
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
+	rtc_vfd_t * v = rtc_vfd(fd);
+	uint32_t flags;
 
-	/* Disable interrupts and spin until interrupt received */
-	while (!rtc_interrupt_occurred[cur_active_terminal]){
-		/* SPIN */
+	if (v == NULL)
+		return -1;
+
+	if (v->freq == 0) {
+		cli_and_save(flags);
+		v->freq = RTC_DEFAULT_FREQ;
+		rtc_vfds_used++;
+		rtc_retune();
+		restore_flags(flags);
 	}
+
+	/* sleep until the interrupt handler ticks this fd */
+	wait_event(&rtc_wait_queue, v->pending);
 	
-	/* Reset interrupt-occured */
-	rtc_interrupt_occurred[cur_active_terminal] = 0;
+	/* ticks missed since the last read collapse into this one */
+	v->pending = 0;
 	/* Returns the number of bytes read always */
 	return 0;
  }
@@ -100,21 +163,32 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes){
  *	Function: rtc_write()
  *	Description: 
  *	input: file descriptor, pointer to buffer being modified, number of bytes writing
- *	output: returns 0 always
- *	effects:
+ *	output: returns nbytes, -1 for a rate that is not a power of two in
+ *			RTC_MIN_FREQ ~ RTC_MAX_FREQ
+ *	effects: sets the fd's rate, the hardware speeds up if no other fd asked for as much
  */
 int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
     /* Local variables. */
+	rtc_vfd_t * v = rtc_vfd(fd);
 	int32_t freq;
+	uint32_t flags;
 
 	/* Boundary check - ONLY 4 Bytes */	
-	if (4 != nbytes || (int32_t)buf == NULL) 
+	if (4 != nbytes || (int32_t)buf == NULL || v == NULL) 
 		return -1;  /* Fail - always need to write 4 bytes) */
 	else 
 		freq = *((int32_t*)buf);
 
-	/* Set the RTC Frequency to our variable freq */
-	rtc_set_freq(freq);
+	if (freq < RTC_MIN_FREQ || freq > RTC_MAX_FREQ || (freq & (freq - 1)))
+		return -1;
+
+	cli_and_save(flags);
+	if (v->freq == 0)
+		rtc_vfds_used++;
+	v->freq = freq;
+	v->count = 0;
+	rtc_retune();
+	restore_flags(flags);
 	
 	/* Return the number of bytes wrote always */
 	return nbytes;   
@@ -130,7 +204,7 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes){
 */
 void rtc_set_freq(int32_t freq){
     /* Local variables. */
-    char rate;
+    char rate = 0;
 
     /* Save old value of Reg A*/
     outb(RTC_REGISTER_A, RTC_PORT);
@@ -148,6 +222,8 @@ void rtc_set_freq(int32_t freq){
     if (freq == 8) rate = 0x0D;
     if (freq == 4) rate = 0x0E;
     if (freq == 2) rate = 0x0F;
+    if (rate == 0) return;
+    rtc_cur_freq = freq;
 
     /* set A[3:0] (rate) to rate */
     outb(RTC_REGISTER_A, RTC_PORT);
@@ -160,13 +236,71 @@ void rtc_set_freq(int32_t freq){
  *	Description: This is the main function to close the RTC.
  *	input: pointer to file descriptor being closed
  *	output: returns 0 always
- *	effects: closes the RTC
+ *	effects: closes the RTC, the hardware slows down to the fastest fd left
  */
 int32_t rtc_close(int32_t fd){
-	
-	 /* Reset RTC Frequency to 2 Hz */
-    rtc_set_freq(2);
+	rtc_vfd_t * v = rtc_vfd(fd);
+	uint32_t flags;
+
+	if (v == NULL || v->freq == 0)
+		return 0;
+
+	cli_and_save(flags);
+	v->freq = 0;
+	v->pending = 0;
+	rtc_vfds_used--;
+	rtc_retune();
+	restore_flags(flags);
 
     /* Always return 0 */
     return 0;
  }
+
+
+/*
+*	Function: rtc_vfd()
+*	Description: finds the virtual RTC of one of the running process's fds
+*	input: fd -- file descriptor
+*	output: none
+*	returns: the slot, NULL for a bad fd
+*/
+static rtc_vfd_t * rtc_vfd(int32_t fd){
+	uint8_t process = get_pcb_ptr()->process_number;
+
+	if (fd < 0 || fd >= NUM_MAX_OPEN_FILES || process >= NUM_MAX_PROCESSES)
+		return NULL;
+	return &rtc_vfds[process][fd];
+}
+
+
+/*
+*	Function: rtc_retune()
+*	Description: runs the hardware at the highest rate any fd asked for (RTC_MIN_FREQ
+*				 when none is open) and gives every fd the divider down to its own rate.
+*				 Counts are scaled so an fd keeps its place in its period. Interrupts are off.
+*	input: none
+*	output: none
+*	effects: may reprogram the RTC
+*/
+static void rtc_retune(void){
+	rtc_vfd_t * v;
+	int32_t hw_freq = RTC_MIN_FREQ;
+	int32_t old_freq = rtc_cur_freq;
+	int i;
+
+	for (i = 0, v = &rtc_vfds[0][0]; i < NUM_MAX_PROCESSES * NUM_MAX_OPEN_FILES; i++, v++)
+		if (v->freq > hw_freq)
+			hw_freq = v->freq;
+
+	if (hw_freq != old_freq)
+		rtc_set_freq(hw_freq);
+
+	for (i = 0, v = &rtc_vfds[0][0]; i < NUM_MAX_PROCESSES * NUM_MAX_OPEN_FILES; i++, v++) {
+		if (v->freq == 0)
+			continue;
+		v->divider = hw_freq / v->freq;
+		v->count = v->count * hw_freq / old_freq;
+		if (v->count >= v->divider)
+			v->count = v->divider - 1;
+	}
+ }
@@ -21,6 +21,23 @@
 /* PIC Interrupt Line */
 #define RTC_IRQ_LINE 8
 
+/* rates a process can ask for; the hardware runs at the highest one asked for */
+#define RTC_MIN_FREQ	2
+#define RTC_MAX_FREQ	1024
+#define RTC_DEFAULT_FREQ	2	/* an fd that reads before it writes a rate */
+
+/* One per process and file descriptor: an RTC fd sees every divider'th
+ * hardware interrupt, freq == 0 when the slot is not in use */
+typedef struct {
+	int32_t freq;			/* rate the fd asked for */
+	int32_t divider;		/* hardware interrupts per tick of this fd */
+	int32_t count;			/* hardware interrupts toward the next tick */
+	volatile int32_t pending;	/* ticks since the last read */
+} rtc_vfd_t;
+
+/* hardware interrupt rate */
+extern int32_t rtc_cur_freq;
+
 
 /* Initialize RTC */
 void init_rtc(void);
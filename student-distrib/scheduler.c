@@ -6,30 +6,75 @@
 #include "syscalls.h"
 #include "paging.h"
 #include "terminal.h"
+#include "apic.h"
+#include "clock.h"
+#include "smp.h"
+#include "fpu.h"
+#include "trace.h"
+#include "acct.h"
+#include "vbe.h"
+#include "tasklet.h"
 
 /* ====================== GLOBAL VARIABLE DECLARATIONS ======================= */
-/* holds index to current terminal that is executing the process */
-volatile uint8_t cur_active_terminal = 0; 
-/* holds index to next terminal that is scheduled to execute process */   
-         uint8_t next_sched_terminal = 0;       
+/* per-level MLFQ statistics */
+sched_level_stats_t sched_level_stats[SCHED_LEVELS];
+/* PIT ticks left until every process is boosted back to its priority level */
+static uint32_t boost_countdown = SCHED_BOOST_TICKS;
+
+/* ticks taken vs. periodic ticks that would have fired, for tick_stats */
+tick_stats_t tickless_stats;
+/* PIT counts not yet folded into tickless_stats.elapsed */
+static uint32_t elapsed_counts = 0;
+/* process_contextswitch calls, lets irq_exit tell when a handler switched away */
+volatile uint32_t sched_switches = 0;
 /* =========================================================================== */
 
+static int multiple_terminals_active(void);
+static int runnable(uint8_t term);
+static int pick_terminal(uint8_t max_level);
+static int best_terminal(uint8_t max_level);
+static void sched_tick(uint8_t timer);
+static void tick_program(uint32_t ticks);
+static void tick_account(uint32_t counts);
+static uint32_t tick_until(uint64_t deadline);
+static void sched_demote(pcb_t * pcb);
+static void sched_boost_all(void);
+
 /* PIT_init
  *   DESCRIPTION: Initialize PIT to allow interrupts for scheduling.
  *                Consulted wiki.osdev.org (Programmable_Interval_Timer -- PIT)
+ *                In TICKLESS mode the PIT is stopped; tick_next arms a one-shot
+ *                once there is more than one runnable process to share the CPU.
+ *                When apic_init calibrated the local APIC timer, that timer drives
+ *                the scheduler instead and IRQ 0 stays masked.
  *   INPUT: none
  *   OUTPUT: none
  *   RETURN VALUE: none
  *   SIDE EFFECT: IRQ 0 is allowed to get interrupts generated from the PIT
  */
 void PIT_init() {
+#if !TICKLESS
     /* calculate frequency */
     uint16_t frequency = CLK_FREQ / SET_FREQ;
+#endif
+
+    if (apic_timer_ready) {
+#if !TICKLESS
+        apic_timer_periodic();
+#endif
+        return;
+    }
 
+#if !TICKLESS
     /* Set interrupt intervals to be 20 seconds for scheduling */
     outb(PIT_INIT, PIT_CMD_PORT);
     outb(frequency & LSB_MASK, PIT_CHANNEL_0);
     outb(frequency >> MSB_MASK, PIT_CHANNEL_0);
+#else
+    /* stop the BIOS's 18.2 Hz square wave: mode 0 without a count holds the output low
+     * until tick_program loads one */
+    outb(PIT_ONESHOT, PIT_CMD_PORT);
+#endif
     
     /* Enable IRQ 0 to receive PIT interrupts */
     enable_irq(PIT_IRQ);
@@ -41,70 +86,342 @@ void PIT_init() {
 
 
 /* PIT_scheduling
- *   DESCRIPTION: locks and carryout context switch after receiving PIT interrupts
+ *   DESCRIPTION: PIT interrupt handler, used when there is no local APIC timer
  *   INPUT: none
  *   OUTPUT: none
  *   RETURN VALUE: none
- *   SIDE EFFECT: calls contextswitch
+ *   SIDE EFFECT: see sched_tick
  */
 void PIT_scheduling() {
-    
     /* send EOI to PIT */
     send_eoi(PIT_IRQ); 
+    sched_tick(1);
+}
+
+/* APIC_scheduling
+ *   DESCRIPTION: local APIC timer interrupt handler
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: see sched_tick
+ */
+void APIC_scheduling() {
+    apic_eoi();
+    sched_tick(1);
+}
+
+/* APIC_resched
+ *   DESCRIPTION: reschedule IPI handler: another CPU woke or released a terminal this CPU
+ *                may want to run
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: see sched_tick
+ */
+void APIC_resched() {
+    apic_eoi();
+    sched_tick(0);
+}
+
+/* sched_tick
+ *   DESCRIPTION: charges the running process for the ticks that passed and carries out a
+ *                context switch when its slice ran out or a higher priority process is waiting.
+ *                In TICKLESS mode one interrupt may stand for several periodic ticks.
+ *                A CPU still on its idle stack just looks for a terminal to run.
+ *   INPUT: timer -- 1 for a timer interrupt, 0 for a reschedule IPI (nothing to charge)
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: calls contextswitch, updates MLFQ levels and statistics, re-arms the timer
+ */
+static void sched_tick(uint8_t timer) {
+    cpu_t * cpu = cpu_this();
+    pcb_t * cur_pcb;
+    uint8_t expired = 0;
+    uint32_t ticks = 0;
     
     cli(); /* disable interrupts */
+
+#if TICKLESS
+    /* nothing was armed (a tick left over from before PIT_init): no time to account */
+    if (timer && !cpu->tick_armed) {
+        sti();
+        return;
+    }
+#endif
+
+    /* the one-shot fired: account for everything it covered */
+    if (timer) {
+        ticks = cpu->armed_ticks;
+        cpu->tick_armed = 0;
+        trace_event(TRACE_TICK, TRACE_NO_PROC, ticks);
+        tickless_stats.taken++;
+        tick_account(ticks * TICK_COUNT);
+        /* draw output a preempted writer left queued */
+        terminal_out_tick();
+        cursor_flush();
+        terminal_read_tick();
+    }
+
+    /* work the interrupt handlers deferred may wake somebody up: do it before choosing */
+    tasklet_run();
+
+    /* a tasklet was interrupted on this stack; switching away could leave it stranded
+     * in a sleeping process, so the switch waits for the next tick */
+    if (cpu->preempt_off) {
+        tick_next();
+        sti();
+        return;
+    }
+
+    if (cpu->idle) {
+        int next_process = pick_terminal(SCHED_LEVELS);
+        if (next_process != -1)
+            process_contextswitch(next_process);
+        sti();
+        return;
+    }
+
+    /* nothing to charge before the first shell is launched */
+    if (terminal[cpu->cur_term].active != TERMINAL_ACTIVE) {
+        sti();
+        return;
+    }
+
+    cur_pcb = get_pcb_ptr_process(terminal[cpu->cur_term].apn);
+
+    /* lift everybody back up once in a while so CPU hogs can't be starved forever */
+    if (boost_countdown <= ticks) {
+        boost_countdown = SCHED_BOOST_TICKS;
+        sched_boost_all();
+    } else {
+        boost_countdown -= ticks;
+    }
+
+    /* the current process is asleep and the CPU is idling on its stack */
+    if (cur_pcb->state != PROC_RUNNABLE) {
+        int next_process = pick_terminal(SCHED_LEVELS);
+        if (next_process != -1)
+            process_contextswitch(next_process);
+        tick_next();
+        sti();
+        return;
+    }
+
+    sched_level_stats[cur_pcb->sched_level].ticks += ticks;
+    acct_charge(cur_pcb);
+
+    /* burned the whole slice: drop a level */
+    if (cur_pcb->sched_ticks > ticks) {
+        cur_pcb->sched_ticks -= ticks;
+    } else {
+        sched_demote(cur_pcb);
+        expired = 1;
+    }
+
     /* check to see if terminal 2 or 3 is running, if yeah then find next scheduled process */
-    if (terminal[1].active == 1 || terminal[2].active == 1) {
-            process_contextswitch(get_next_scheduled());
+    if (multiple_terminals_active()) {
+        if (expired || best_terminal(cur_pcb->sched_level) != -1) {
+            int next_process = get_next_scheduled();
+            if (cpu->next_term != cpu->cur_term)
+                process_contextswitch(next_process);
+        }
     }
+    tick_next();
     sti(); /* enable interrupts again */
     
     return;
 }
 
+/* tick_next
+ *   DESCRIPTION: programs this CPU's timer for the next real deadline. With fewer than two runnable
+ *                processes nobody needs preempting, so the PIT stays quiet until sched_wakeup
+ *                or execute calls here again, or until a raw terminal read times out. Otherwise
+ *                the one-shot ends the current slice, or fires after one tick if a higher
+ *                priority process is waiting.
+ *                Does nothing while a one-shot is already pending or when not TICKLESS.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: may program PIT channel 0
+ */
+void tick_next(void) {
+#if TICKLESS
+    uint32_t flags;
+    uint32_t i;
+    uint32_t nrunnable = 0;
+    uint64_t deadline;
+    pcb_t * cur_pcb;
+    cpu_t * cpu;
+
+    cli_and_save(flags);
+    cpu = cpu_this();
+    if (cpu->tick_armed || cpu->idle) {
+        restore_flags(flags);
+        return;
+    }
+
+    /* only what this CPU would run counts; idle CPUs are kicked for the rest */
+    for (i = 0; i < MAX_TERMINALS; i++)
+        nrunnable += runnable(i) && smp_allowed(i, 0);
+
+    if (nrunnable >= 2) {
+        cur_pcb = get_pcb_ptr_process(terminal[cpu->cur_term].apn);
+        if (!runnable(cpu->cur_term) || best_terminal(cur_pcb->sched_level) != -1)
+            tick_program(1);
+        else
+            tick_program(cur_pcb->sched_ticks);
+    } else if ((deadline = terminal_read_deadline()) != 0) {
+        /* nobody to preempt, but a VTIME read must be woken when it times out */
+        tick_program(tick_until(deadline));
+    }
+    restore_flags(flags);
+#endif
+}
+
+/* tick_program
+ *   DESCRIPTION: arms a one-shot timer interrupt after the given number of periodic ticks.
+ *                Uses the local APIC timer when there is one, else PIT mode 0. The PIT's
+ *                16 bit counter can't wait longer than TICKS_PER_ONESHOT ticks, so longer
+ *                deadlines are reached in several steps.
+ *   INPUT: ticks -- periodic ticks (1 / SET_FREQ seconds each) until the interrupt
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: programs the APIC timer or PIT channel 0
+ */
+static void tick_program(uint32_t ticks) {
+    uint16_t count;
+
+    if (ticks == 0)
+        ticks = 1;
+
+    if (apic_timer_ready) {
+        if (ticks > apic_timer_max_ticks())
+            ticks = apic_timer_max_ticks();
+        apic_timer_oneshot(ticks);
+    } else {
+        if (ticks > TICKS_PER_ONESHOT)
+            ticks = TICKS_PER_ONESHOT;
+        count = ticks * TICK_COUNT;
+
+        outb(PIT_ONESHOT, PIT_CMD_PORT);
+        outb(count & LSB_MASK, PIT_CHANNEL_0);
+        outb(count >> MSB_MASK, PIT_CHANNEL_0);
+    }
+
+    cpu_this()->armed_ticks = ticks;
+    cpu_this()->tick_armed = 1;
+    trace_event(TRACE_ARM, TRACE_NO_PROC, ticks);
+}
+
+/* tick_until
+ *   DESCRIPTION: periodic ticks from now until a clock_ns() deadline, rounded up
+ *   INPUT: deadline -- time to be woken at
+ *   OUTPUT: none
+ *   RETURN VALUE: ticks to arm, at least 1
+ *   SIDE EFFECT: none
+ */
+static uint32_t tick_until(uint64_t deadline) {
+    uint64_t now = clock_ns();
+    uint64_t left;
+
+    if (deadline <= now)
+        return 1;
+    left = deadline - now;
+    div64_32(&left, NS_PER_SEC / SET_FREQ);
+    return (uint32_t)left + 1;
+}
+
+/* tick_account
+ *   DESCRIPTION: adds elapsed time to tickless_stats.elapsed in whole periodic ticks
+ *   INPUT: counts -- elapsed time in PIT input clock counts
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+static void tick_account(uint32_t counts) {
+    elapsed_counts += counts;
+    while (elapsed_counts >= TICK_COUNT) {
+        elapsed_counts -= TICK_COUNT;
+        tickless_stats.elapsed++;
+    }
+}
+
+/* tick_rtc_elapsed
+ *   DESCRIPTION: called on every RTC interrupt. Without a TSC nothing else keeps time while
+ *                the timer is stopped, so the RTC period estimates how many periodic ticks
+ *                were avoided.
+ *   INPUT: rtc_freq -- current RTC interrupt rate in Hz
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void tick_rtc_elapsed(int32_t rtc_freq) {
+#if TICKLESS
+    if (!clock_has_tsc && !cpus[0].tick_armed && rtc_freq > 0)
+        tick_account(CLK_FREQ / rtc_freq);
+#endif
+}
+
 /* process_contextswitch
- *   DESCRIPTION: Switch from one process to another, given the next scheduled process number
+ *   DESCRIPTION: Switch from one process to another, given the next scheduled process number.
+ *                On a CPU that is still idle, the idle stack is what gets switched away from.
  *   INPUT: process_number -- the id of the process that we need to switch to
  *   OUTPUT: none
  *   RETURN VALUE: none
- *   SIDE EFFECT: context switch with saving/swaping ESP/EBP
+ *   SIDE EFFECT: context switch with saving/swaping ESP/EBP, the kernel lock depth moves
+ *                with the stack
  */
 void process_contextswitch(int next_process) {
-    /* create a new page in V_ADDR 8MB --> P_ADDR 8 MB */
-    page_remap(_128MB, _8MB + next_process * _4MB);
+    cpu_t * cpu = cpu_this();
+    uint32_t * save_esp = &cpu->idle_esp;
+    uint32_t * save_ebp = &cpu->idle_ebp;
+    uint8_t prev_process = TRACE_NO_PROC;
+    pcb_t * old_pcb = NULL;
 
+    sched_switches++;
 
-    /* Video memory remapping: 136 MB */
-    uint8_t *screen_start;
-    vidmap(&screen_start);
+    /* create a new page in V_ADDR 8MB --> P_ADDR 8 MB (untouched if it is mapped already) */
+    page_remap(_128MB, _8MB + next_process * _4MB);
 
 
     /* saving and restoring PCB and states */
     /* Get old PCB: switch FROM */
-    pcb_t * old_pcb = get_pcb_ptr_process(terminal[cur_active_terminal].apn);
-    /* update global variable for current active terminal */
-    cur_active_terminal = next_sched_terminal;
+    if (!cpu->idle) {
+        old_pcb = get_pcb_ptr_process(terminal[cpu->cur_term].apn);
+        old_pcb->lock_depth = kernel_lock_depth();
+        save_esp = &old_pcb->esp;
+        save_ebp = &old_pcb->ebp;
+        prev_process = old_pcb->process_number;
+    }
+    trace_event(TRACE_SWITCH, next_process, prev_process);
+    /* update current active terminal of this CPU */
+    smp_set_terminal(cpu->next_term);
     /* Get new PCB: switch TO */
     pcb_t * next_pcb = get_pcb_ptr_process(next_process);
+    sched_level_stats[next_pcb->sched_level].dispatches++;
+    kernel_lock_set_depth(next_pcb->lock_depth);
+    /* the FPU registers follow lazily on the first #NM */
+    fpu_switch(next_pcb->process_number);
+    vbe_switch(next_pcb->process_number);
+    acct_switch(old_pcb, next_pcb);
     
 
     /* Fetch correct terminal with new PCB */
     term_t * terminal = next_pcb->term;
 
-    /* Remap the video memory to buffer if the current active terminal is not displayed to user currently */
-    if (terminal->id != cur_term) {
-        vidmem_remap((uint32_t)screen_start, (uint32_t)terminal->video_mem);
-    }
+    /* Video memory remapping: 136 MB goes to the terminal's own video memory, displayed
+     * or not. An unchanged mapping is neither rewritten nor flushed. */
+    table_remap(_136MB, (uint32_t)terminal->video_mem);
 
     /* CONTEXT SWITCH: Save SS0 and ESP0 */
-    tss.esp0 = _8MB - _8KB * (next_process) - 4;
-    tss.ss0 = KERNEL_DS;
+    cpu->tss->esp0 = _8MB - _8KB * (next_process) - 4;
+    cpu->tss->ss0 = KERNEL_DS;
 
     /* CONTEXT SWITCH: Swap ESP/EBP */
     asm volatile(
         "movl %%esp, %%eax;"
         "movl %%ebp, %%ebx;"
-        :"=a"(old_pcb->esp), "=b"(old_pcb->ebp)    /* OUTPUT: pointers of old pcb */
+        :"=a"(*save_esp), "=b"(*save_ebp)          /* OUTPUT: pointers of old pcb */
         :                                          /* INPUT: none */
         );
                  
@@ -121,28 +438,294 @@ void process_contextswitch(int next_process) {
 
 
 /* get_next_scheduled
- *   DESCRIPTION: obtains the process number for the process to be executed next according to scheduling
+ *   DESCRIPTION: obtains the process number for the process to be executed next according to scheduling:
+ *                the active terminal whose process sits at the highest MLFQ level, rotating between
+ *                terminals at the same level. The current terminal only wins if nobody else is better.
  *   INPUT: none
  *   OUTPUT: the process number fo the next scheduled process
  *   RETURN VALUE: none
- *   SIDE EFFECT: will change the next_scheduled_terminal used in function that will be called in Context Switch
+ *   SIDE EFFECT: sets this CPU's next_term, used by the context switch that follows
  */
 int get_next_scheduled(){
-    /* Loop Through active terminal: 0 ~ 2 */
-    unsigned int i;
-	
+    cpu_t * cpu = cpu_this();
+    uint8_t cur = cpu->cur_term;
+
     /* update the next_scheduled terminal */
-    next_sched_terminal = cur_active_terminal;
+    cpu->next_term = cur;
 
-    /* loop through the terminals to find next schedule terminal (any other active terminal) */
-    for (i = 0; i < MAX_TERMINALS - 1; i++) {
-        next_sched_terminal = (next_sched_terminal+1) % MAX_TERMINALS;
-        if (terminal[next_sched_terminal].active == TERMINAL_ACTIVE)
-            break;
-    }
+    /* any other terminal at least as good as the current one (round robin) */
+    if (runnable(cur))
+        pick_terminal(get_pcb_ptr_process(terminal[cur].apn)->sched_level + 1);
+    else
+        pick_terminal(SCHED_LEVELS);
 
     /* give most recent process number for next process */
-    return (int)(terminal[next_sched_terminal].apn);
+    return (int)(terminal[cpu->next_term].apn);
     
 }
 
+/* pick_terminal
+ *   DESCRIPTION: chooses the terminal to switch to (see best_terminal)
+ *   INPUT: max_level -- only processes at a level below this qualify
+ *   OUTPUT: none
+ *   RETURN VALUE: process number of the chosen terminal's process, -1 if none qualifies
+ *   SIDE EFFECT: sets this CPU's next_term when a terminal is chosen
+ */
+static int pick_terminal(uint8_t max_level) {
+    int best = best_terminal(max_level);
+
+    if (best == -1)
+        return -1;
+    cpu_this()->next_term = best;
+    return (int)(terminal[best].apn);
+}
+
+/* best_terminal
+ *   DESCRIPTION: scans the terminals in round-robin order starting after the current one
+ *                and finds the runnable process that sits at the highest level. Only
+ *                terminals queued on this CPU count, unless none of those qualify and this
+ *                CPU has nothing to run: then it may steal one waiting on another CPU.
+ *   INPUT: max_level -- only processes at a level below this qualify
+ *   OUTPUT: none
+ *   RETURN VALUE: terminal index, -1 if none qualifies
+ *   SIDE EFFECT: none
+ */
+static int best_terminal(uint8_t max_level) {
+    cpu_t * cpu = cpu_this();
+    unsigned int i;
+    uint8_t term;
+    uint8_t level;
+    uint8_t steal;
+    uint8_t start = cpu->idle ? 0 : cpu->cur_term;
+    uint8_t hungry = cpu->idle || !runnable(cpu->cur_term);
+    int best = -1;
+
+    for (steal = 0; steal <= hungry && best == -1; steal++) {
+        for (i = 1; i <= MAX_TERMINALS; i++) {
+            term = (start + i) % MAX_TERMINALS;
+            if (!runnable(term) || !smp_allowed(term, steal))
+                continue;
+            level = get_pcb_ptr_process(terminal[term].apn)->sched_level;
+            if (level < max_level) {
+                max_level = level;
+                best = term;
+            }
+        }
+    }
+
+    return best;
+}
+
+/* multiple_terminals_active
+ *   DESCRIPTION: scheduling only matters once terminal 2 or 3 has been launched
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: 1 if more than one terminal runs a process, 0 otherwise
+ *   SIDE EFFECT: none
+ */
+static int multiple_terminals_active(void) {
+    return (terminal[1].active == TERMINAL_ACTIVE || terminal[2].active == TERMINAL_ACTIVE);
+}
+
+/* runnable
+ *   DESCRIPTION: checks whether a terminal's foreground process can be scheduled
+ *   INPUT: term -- terminal index
+ *   OUTPUT: none
+ *   RETURN VALUE: 1 if the terminal is active and its process is not asleep, 0 otherwise
+ *   SIDE EFFECT: none
+ */
+static int runnable(uint8_t term) {
+    if (terminal[term].active != TERMINAL_ACTIVE)
+        return 0;
+    return (get_pcb_ptr_process(terminal[term].apn)->state == PROC_RUNNABLE);
+}
+
+/* sched_init_process
+ *   DESCRIPTION: starts a freshly executed process at its priority level with a full slice
+ *   INPUT: pcb -- the new process
+ *          prio -- best level it may run at (inherited from the parent)
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void sched_init_process(pcb_t * pcb, uint8_t prio) {
+    pcb->state = PROC_RUNNABLE;
+    pcb->sched_prio = prio;
+    pcb->sched_level = prio;
+    pcb->sched_ticks = SCHED_QUANTUM(prio);
+}
+
+/* sched_demote
+ *   DESCRIPTION: a process used its whole slice: move it down one level and refill the slice
+ *   INPUT: pcb -- process to demote
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: updates level statistics
+ */
+static void sched_demote(pcb_t * pcb) {
+    if (pcb->sched_level < SCHED_LEVELS - 1) {
+        pcb->sched_level++;
+        sched_level_stats[pcb->sched_level].demotions++;
+    }
+    pcb->sched_ticks = SCHED_QUANTUM(pcb->sched_level);
+}
+
+/* sched_boost_all
+ *   DESCRIPTION: lifts every running process back to its priority level
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: updates level statistics
+ */
+static void sched_boost_all(void) {
+    unsigned int i;
+    pcb_t * pcb;
+
+    for (i = 0; i < MAX_TERMINALS; i++) {
+        if (terminal[i].active != TERMINAL_ACTIVE)
+            continue;
+        pcb = get_pcb_ptr_process(terminal[i].apn);
+        if (pcb->sched_level != pcb->sched_prio) {
+            pcb->sched_level = pcb->sched_prio;
+            pcb->sched_ticks = SCHED_QUANTUM(pcb->sched_level);
+            sched_level_stats[pcb->sched_level].promotions++;
+        }
+    }
+}
+
+/* sched_block
+ *   DESCRIPTION: puts the current process to sleep (see sleep_on). Blocking on input counts as
+ *                interactive, so the process climbs one level (never above its priority) with a
+ *                fresh slice. Runs the best runnable terminal meanwhile; with nothing runnable the
+ *                CPU halts until an interrupt wakes somebody. Interrupts must be off.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: context switches; returns once the process was woken and scheduled again
+ */
+void sched_block(void) {
+    cpu_t * cpu = cpu_this();
+    pcb_t * pcb = get_pcb_ptr_process(terminal[cur_active_terminal].apn);
+    int next_process;
+    uint32_t depth;
+
+    pcb->state = PROC_BLOCKED;
+    if (pcb->sched_level > pcb->sched_prio) {
+        pcb->sched_level--;
+        sched_level_stats[pcb->sched_level].promotions++;
+    }
+    pcb->sched_ticks = SCHED_QUANTUM(pcb->sched_level);
+
+    while (pcb->state != PROC_RUNNABLE) {
+        next_process = pick_terminal(SCHED_LEVELS);
+        if (next_process != -1) {
+            /* we only get switched back to once we are runnable again */
+            process_contextswitch(next_process);
+            continue;
+        }
+
+        /* nothing runnable: sleep until the next interrupt (sti only takes effect after hlt),
+         * letting the other CPUs into the kernel meanwhile */
+        cpu->hungry = 1;
+        acct_charge(pcb);
+        depth = kernel_unlock_all();
+        asm volatile("sti; hlt; cli" : : : "memory", "cc");
+        kernel_relock(depth);
+        acct_resume(pcb);
+        cpu->hungry = 0;
+    }
+    trace_event(TRACE_RUN, pcb->process_number, 0);
+}
+
+/* sched_wakeup
+ *   DESCRIPTION: makes a sleeping process runnable again (see wake_up)
+ *   INPUT: process -- process number to wake
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: the process is picked up at the next scheduling decision, the timer is
+ *                re-armed if it was stopped and the CPU that should run it is kicked
+ */
+void sched_wakeup(uint8_t process) {
+    pcb_t * pcb = get_pcb_ptr_process(process);
+
+    pcb->state = PROC_RUNNABLE;
+    trace_event(TRACE_WAKEUP, process, 0);
+    if (pcb->term != NULL)
+        smp_kick_terminal(pcb->term->id);
+    tick_next();
+}
+
+/* set_priority
+ *   DESCRIPTION: system call that sets the best MLFQ level the current process may run at
+ *   INPUT: prio -- level between SCHED_TOP_LEVEL and SCHED_LEVELS - 1 (larger is nicer)
+ *   OUTPUT: none
+ *   RETURN VALUE: the previous priority, -1 if prio is out of range
+ *   SIDE EFFECT: may drop the process to the new level right away
+ */
+int32_t set_priority(int32_t prio) {
+    uint32_t flags;
+    int32_t old_prio;
+    pcb_t * pcb = get_pcb_ptr();
+
+    if (prio < SCHED_TOP_LEVEL || prio >= SCHED_LEVELS)
+        return -1;
+
+    cli_and_save(flags);
+    old_prio = pcb->sched_prio;
+    pcb->sched_prio = prio;
+    if (pcb->sched_level < prio) {
+        pcb->sched_level = prio;
+        pcb->sched_ticks = SCHED_QUANTUM(prio);
+    }
+    restore_flags(flags);
+
+    return old_prio;
+}
+
+/* sched_stats
+ *   DESCRIPTION: system call that copies sched_level_stats (one entry per level) to user space
+ *   INPUT: buf -- user buffer
+ *          nbytes -- size of buf, must hold every level
+ *   OUTPUT: none
+ *   RETURN VALUE: number of bytes copied, -1 on a bad buffer
+ *   SIDE EFFECT: none
+ */
+int32_t sched_stats(void* buf, int32_t nbytes) {
+    if (nbytes < (int32_t)sizeof(sched_level_stats) || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    memcpy(buf, sched_level_stats, sizeof(sched_level_stats));
+    return sizeof(sched_level_stats);
+}
+
+/* tick_stats
+ *   DESCRIPTION: system call that reports PIT interrupts taken vs. periodic ticks avoided
+ *   INPUT: buf -- user buffer for a tick_stats_t
+ *          nbytes -- size of buf
+ *   OUTPUT: none
+ *   RETURN VALUE: number of bytes copied, -1 on a bad buffer
+ *   SIDE EFFECT: none
+ */
+int32_t tick_stats(void* buf, int32_t nbytes) {
+    uint32_t flags;
+    tick_stats_t stats;
+    uint64_t now;
+
+    if (nbytes < (int32_t)sizeof(tick_stats_t) || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    cli_and_save(flags);
+    stats = tickless_stats;
+    restore_flags(flags);
+
+    /* the TSC knows exactly how much time went by */
+    if (clock_has_tsc) {
+        now = clock_ns();
+        div64_32(&now, NS_PER_SEC / SET_FREQ);
+        stats.elapsed = (uint32_t)now;
+    }
+    stats.avoided = (stats.elapsed > stats.taken) ? stats.elapsed - stats.taken : 0;
+
+    memcpy(buf, &stats, sizeof(tick_stats_t));
+    return sizeof(tick_stats_t);
+}
@@ -3,6 +3,7 @@
 
 #include "types.h"
 #include "syscalls.h"
+#include "smp.h"
 
 /* ======================== CONSTANTS DEFINITION ======================== */
 #define PIT_IRQ			0	  	/* IRQ LINE to receive the PIT interrupts */
@@ -20,16 +21,55 @@
 #define CLK_FREQ	1193180	/* clock frequency to 20 second intervals */
 #define SET_FREQ	50		/* desired frequency to set rate of PIT */
 
+/* Tickless mode: instead of a fixed SET_FREQ interrupt the PIT is programmed
+ * one-shot (mode 0) for the next real deadline, and left quiet while there is
+ * nothing to preempt. Set to 0 to go back to the periodic PIT. */
+#define TICKLESS			1
+#define PIT_ONESHOT			0x30	/* channel 0, lo/hi byte, mode 0 (interrupt on terminal count) */
+#define PIT_MAX_COUNT		0xFFFF	/* longest one-shot the 16 bit counter can do (~55 ms) */
+#define TICK_COUNT			(CLK_FREQ / SET_FREQ)			/* PIT counts in one periodic tick */
+#define TICKS_PER_ONESHOT	(PIT_MAX_COUNT / TICK_COUNT)	/* longest one-shot in ticks */
+
 #define LSB_MASK		0xFF	/* get LSB in frequency */
 #define MSB_MASK		8		/* MASK to shift for MSB */
 
 #define MAX_TERMINALS	3		/* 0, 1, 2 indexs for 3 terminals */
 #define TERMINAL_ACTIVE	1		/* terminal is active and avaliable */
 
+/* Multilevel feedback queue: level 0 is the highest priority. A process that
+ * burns its whole slice drops a level, one that blocks on input climbs a level,
+ * and every SCHED_BOOST_TICKS everybody is lifted back to its priority level. */
+#define SCHED_LEVELS		3		/* number of feedback levels */
+#define SCHED_TOP_LEVEL		0		/* level new processes start at */
+#define SCHED_BOOST_TICKS	50		/* PIT ticks between global boosts (1 second) */
+#define SCHED_QUANTUM(level)	(1 << (level))	/* slice length in PIT ticks */
+
+/* per-level statistics, copied out by the sched_stats system call */
+typedef struct {
+	uint32_t ticks;			/* PIT ticks spent running at this level */
+	uint32_t dispatches;	/* switches to a process sitting at this level */
+	uint32_t promotions;	/* processes that climbed into this level */
+	uint32_t demotions;		/* processes that dropped into this level */
+} sched_level_stats_t;
+
+/* tick accounting, copied out by the tick_stats system call */
+typedef struct {
+	uint32_t taken;		/* timer interrupts actually handled */
+	uint32_t elapsed;	/* periodic ticks' worth of time that went by */
+	uint32_t avoided;	/* elapsed - taken, filled in by tick_stats */
+} tick_stats_t;
+
 /* ======================================================================= */
 
-/* global that holds the current executing terminal index/id */
-extern volatile uint8_t cur_active_terminal;
+/* tick accounting, also the fallback clock without a TSC */
+extern tick_stats_t tickless_stats;
+/* per-level MLFQ statistics, copied out by the sched_stats system call */
+extern sched_level_stats_t sched_level_stats[SCHED_LEVELS];
+/* process_contextswitch calls since boot */
+extern volatile uint32_t sched_switches;
+
+/* the terminal whose process the executing CPU runs (see smp.h) */
+#define cur_active_terminal	(cpu_this()->cur_term)
 
 
 /* ======================== FUNCTION DECLARATION ======================== */
@@ -39,11 +79,41 @@ void PIT_init(void);
 /* Schedules the PIT interrupt */
 void PIT_scheduling(void);
 
+/* Schedules the local APIC timer interrupt */
+void APIC_scheduling(void);
+
+/* Reschedule IPI from another CPU */
+void APIC_resched(void);
+
 /* carries out a contextswitch given a process */
 void process_contextswitch(int next_process);
 
 /* helper to fetch info and state of next scheduled processes */
 int get_next_scheduled();
 
+/* reset the MLFQ state of a freshly executed process */
+void sched_init_process(pcb_t * pcb, uint8_t prio);
+
+/* block the current process until sched_wakeup; interrupts must be off */
+void sched_block(void);
+
+/* make a blocked process runnable again */
+void sched_wakeup(uint8_t process);
+
+/* system call: set the best MLFQ level the current process may run at */
+int32_t set_priority(int32_t prio);
+
+/* system call: copy the per-level scheduler statistics to user space */
+int32_t sched_stats(void* buf, int32_t nbytes);
+
+/* re-arms the PIT for the next deadline if it is stopped */
+void tick_next(void);
+
+/* keeps time from the RTC while the PIT is stopped */
+void tick_rtc_elapsed(int32_t rtc_freq);
+
+/* system call: copy the tick taken/avoided counters to user space */
+int32_t tick_stats(void* buf, int32_t nbytes);
+
 
 #endif
@@ -0,0 +1,121 @@
+/* scrollback.c - per-terminal history of lines scrolled off the screen
+ *
+ * Rows leaving the top of a terminal's screen are copied into that terminal's
+ * ring. Shift-PgUp/PgDn renders a screenful of history (plus the top of the
+ * live screen) into a spare page of video memory and points the CRTC at it;
+ * the live screen keeps being written meanwhile and comes back untouched.
+ */
+
+#include "scrollback.h"
+#include "lib.h"
+#include "terminal.h"
+
+static uint16_t sb_ring[MAX_TERM][SCROLLBACK_LINES][NUM_COLS];
+/* next slot to fill */
+static uint32_t sb_head[MAX_TERM];
+/* lines held, at most SCROLLBACK_LINES */
+static uint32_t sb_count[MAX_TERM];
+/* how far back the displayed terminal is viewed */
+static uint32_t sb_view = 0;
+
+/* sb_push
+ *   DESCRIPTION: appends a row to a terminal's history, dropping the oldest when full
+ *   INPUT: term -- terminal the row belongs to
+ *          row -- NUM_COLS character/attribute cells
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void sb_push(uint8_t term, const uint16_t * row) {
+    memcpy(sb_ring[term][sb_head[term]], row, NUM_COLS * sizeof(uint16_t));
+    sb_head[term] = (sb_head[term] + 1) & SCROLLBACK_MASK;
+    if (sb_count[term] < SCROLLBACK_LINES)
+        sb_count[term]++;
+}
+
+/* sb_line
+ *   DESCRIPTION: looks up a line of history
+ *   INPUT: term -- terminal
+ *          back -- 1 for the line that scrolled off last, 2 for the one before...
+ *   OUTPUT: none
+ *   RETURN VALUE: pointer to NUM_COLS cells, NULL if the history is not that long
+ *   SIDE EFFECT: none
+ */
+uint16_t * sb_line(uint8_t term, uint32_t back) {
+    if (back == 0 || back > sb_count[term])
+        return NULL;
+    return sb_ring[term][(sb_head[term] - back) & SCROLLBACK_MASK];
+}
+
+/* sb_render
+ *   DESCRIPTION: fills the view page with the displayed terminal's screen as it looked
+ *                sb_view lines ago, taking the rows that are still on the live screen
+ *                from video memory
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: writes the view page and shows it
+ */
+static void sb_render(void) {
+    uint16_t * view = (uint16_t *)(VIDEO + VGA_VIEW_OFFSET);
+    uint16_t * live = (uint16_t *)term_screen(cur_term);
+    uint32_t row;
+
+    for (row = 0; row < NUM_ROWS; row++) {
+        if (row < sb_view)
+            memcpy(view + row * NUM_COLS, sb_line(cur_term, sb_view - row), NUM_COLS * sizeof(uint16_t));
+        else
+            memcpy(view + row * NUM_COLS, live + (row - sb_view) * NUM_COLS, NUM_COLS * sizeof(uint16_t));
+    }
+    vga_set_start(VGA_VIEW_OFFSET / sizeof(uint16_t));
+}
+
+/* sb_scroll_view
+ *   DESCRIPTION: moves the displayed terminal's view into its history (Shift-PgUp) or back
+ *                towards the live screen (Shift-PgDn)
+ *   INPUT: lines -- positive to look further back, negative to come forward
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: changes the CRTC start address
+ */
+void sb_scroll_view(int32_t lines) {
+    int32_t view = (int32_t)sb_view + lines;
+
+    if (view < 0)
+        view = 0;
+    if (view > (int32_t)sb_count[cur_term])
+        view = sb_count[cur_term];
+    if ((uint32_t)view == sb_view)
+        return;
+
+    sb_view = view;
+    if (sb_view == 0)
+        screen_show();
+    else
+        sb_render();
+}
+
+/* sb_view_reset
+ *   DESCRIPTION: leaves the history view, e.g. when a key is typed or the terminal changes
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: shows the live screen again
+ */
+void sb_view_reset(void) {
+    if (sb_view == 0)
+        return;
+    sb_view = 0;
+    screen_show();
+}
+
+/* sb_viewing
+ *   DESCRIPTION: tells whether the displayed terminal shows its history
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: lines scrolled back, 0 for the live screen
+ *   SIDE EFFECT: none
+ */
+uint32_t sb_viewing(void) {
+    return sb_view;
+}
@@ -0,0 +1,28 @@
+#ifndef SCROLLBACK_H_
+#define SCROLLBACK_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+#define SCROLLBACK_LINES	256			/* history kept per terminal, power of two */
+#define SCROLLBACK_MASK		(SCROLLBACK_LINES - 1)
+#define SCROLLBACK_PAGE		(NUM_ROWS - 1)	/* lines moved by one Shift-PgUp / PgDn */
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* a row scrolled off the top of a terminal's screen */
+void sb_push(uint8_t term, const uint16_t * row);
+
+/* a line of history, back = 1 for the most recent one; NULL past the oldest */
+uint16_t * sb_line(uint8_t term, uint32_t back);
+
+/* scrolls the displayed terminal's view up (lines > 0) or down into its history */
+void sb_scroll_view(int32_t lines);
+
+/* back to the live screen */
+void sb_view_reset(void);
+
+/* lines the displayed terminal is scrolled back, 0 when showing the live screen */
+uint32_t sb_viewing(void);
+
+#endif
@@ -0,0 +1,281 @@
+/* serial.c - interrupt driven COM1 (16550A) console
+ *
+ * Output is queued in a ring and fed to the UART's 16 byte FIFO from the transmit
+ * interrupt, so nobody waits on the UART itself: kernel printf is mirrored here and
+ * dropped when the ring is full, user writes sleep until the ring has room. Input
+ * is drained from the receive FIFO into another ring by the interrupt handler.
+ * User programs get the port as the "serial" pseudo file. It is a raw byte device,
+ * not a terminal: there is no echo, line editing or canonical mode, and of the
+ * ioctls only FIONBIO applies; the TC_ line discipline commands are refused.
+ */
+
+#include "serial.h"
+#include "lib.h"
+#include "i8259.h"
+#include "syscalls.h"
+#include "waitqueue.h"
+
+uint8_t serial_present = 0;
+serial_stats_t serial_counters;
+
+/* head/tail are free running byte counts */
+static uint8_t tx_buf[SERIAL_TX_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static uint8_t rx_buf[SERIAL_RX_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static volatile uint8_t tx_busy = 0;		/* transmit interrupt on, the handler feeds the UART */
+static wait_queue_t serial_rx_wq;			/* readers waiting for input */
+static wait_queue_t serial_tx_wq;			/* writers waiting for room in tx_buf */
+
+/* tx_kick
+ *   DESCRIPTION: makes sure the transmit interrupt is on while there is output queued.
+ *                The UART raises it right away if its FIFO is already empty.
+ *                Interrupts must be off.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+static void tx_kick(void) {
+    if (tx_busy || tx_head == tx_tail)
+        return;
+    tx_busy = 1;
+    outb(UART_IER_RX | UART_IER_TX, COM1_PORT + UART_IER);
+}
+
+/* tx_fill
+ *   DESCRIPTION: transmit interrupt: the FIFO is empty, give it up to UART_TX_FIFO bytes.
+ *                The interrupt goes off again once the ring is empty.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: wakes writers waiting for room
+ */
+static void tx_fill(void) {
+    uint32_t n;
+
+    for (n = 0; n < UART_TX_FIFO && tx_tail != tx_head; n++) {
+        outb(tx_buf[tx_tail & SERIAL_TX_MASK], COM1_PORT + UART_DATA);
+        tx_tail++;
+    }
+    serial_counters.tx_bytes += n;
+
+    if (tx_tail == tx_head) {
+        tx_busy = 0;
+        outb(UART_IER_RX, COM1_PORT + UART_IER);
+    }
+    if (n > 0)
+        wake_up(&serial_tx_wq);
+}
+
+/* rx_drain
+ *   DESCRIPTION: receive interrupt: moves everything in the receive FIFO to rx_buf
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: wakes readers
+ */
+static void rx_drain(void) {
+    uint8_t c;
+
+    while (inb(COM1_PORT + UART_LSR) & UART_LSR_DR) {
+        c = inb(COM1_PORT + UART_DATA);
+        serial_counters.rx_bytes++;
+        if (rx_head - rx_tail >= SERIAL_RX_SIZE) {
+            serial_counters.rx_dropped++;
+            continue;
+        }
+        rx_buf[rx_head & SERIAL_RX_MASK] = c;
+        rx_head++;
+    }
+    wake_up(&serial_rx_wq);
+}
+
+/* serial_init
+ *   DESCRIPTION: checks COM1 is there with a loopback self test, then sets it up for
+ *                115200 8N1 with the FIFOs on and the receive interrupt enabled
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: sets serial_present, enables IRQ 4
+ */
+void serial_init(void) {
+    outb(0x00, COM1_PORT + UART_IER);
+    outb(UART_LCR_DLAB, COM1_PORT + UART_LCR);
+    outb(UART_DIVISOR & 0xFF, COM1_PORT + UART_DATA);
+    outb(UART_DIVISOR >> 8, COM1_PORT + UART_IER);
+    outb(UART_LCR_8N1, COM1_PORT + UART_LCR);
+    outb(UART_FCR_ENABLE, COM1_PORT + UART_FCR);
+
+    /* no UART answers with all ones; a working one echoes the byte in loopback */
+    outb(UART_MCR_LOOPBACK, COM1_PORT + UART_MCR);
+    outb(UART_TEST_BYTE, COM1_PORT + UART_DATA);
+    if (inb(COM1_PORT + UART_DATA) != UART_TEST_BYTE)
+        return;
+    outb(UART_MCR_NORMAL, COM1_PORT + UART_MCR);
+
+    init_wait_queue(&serial_rx_wq);
+    init_wait_queue(&serial_tx_wq);
+    serial_present = 1;
+    outb(UART_IER_RX, COM1_PORT + UART_IER);
+    enable_irq(SERIAL_IRQ_LINE);
+}
+
+/* serial_interrupt_handler
+ *   DESCRIPTION: IRQ 4, services the UART until it has nothing pending
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void serial_interrupt_handler(void) {
+    uint8_t iir;
+
+    send_eoi(SERIAL_IRQ_LINE);
+    serial_counters.interrupts++;
+
+    while (!((iir = inb(COM1_PORT + UART_IIR)) & UART_IIR_NONE)) {
+        switch (iir & UART_IIR_ID_MASK) {
+            case UART_IIR_RX:
+            case UART_IIR_RX_TIMEOUT:
+                rx_drain();
+                break;
+            case UART_IIR_TX:
+                tx_fill();
+                break;
+            default:
+                /* line status: reading the LSR clears it */
+                inb(COM1_PORT + UART_LSR);
+                break;
+        }
+    }
+}
+
+/* serial_putc
+ *   DESCRIPTION: queues a character of kernel output, '\n' going out as "\r\n". Never
+ *                waits: the character is dropped when the ring is full.
+ *   INPUT: c -- character
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void serial_putc(uint8_t c) {
+    uint32_t flags;
+
+    if (!serial_present)
+        return;
+
+    cli_and_save(flags);
+    if (tx_head - tx_tail > SERIAL_TX_SIZE - 2) {
+        serial_counters.tx_dropped++;
+    } else {
+        if (c == '\n')
+            tx_buf[tx_head++ & SERIAL_TX_MASK] = '\r';
+        tx_buf[tx_head++ & SERIAL_TX_MASK] = c;
+        tx_kick();
+    }
+    restore_flags(flags);
+}
+
+/* serial_puts
+ *   DESCRIPTION: serial_putc for a string
+ *   INPUT: s -- NUL terminated string
+ *   OUTPUT: none
+ *   RETURN VALUE: characters in s
+ *   SIDE EFFECT: none
+ */
+int32_t serial_puts(const int8_t* s) {
+    int32_t i;
+
+    for (i = 0; s[i] != '\0'; i++)
+        serial_putc(s[i]);
+    return i;
+}
+
+/* serial_open
+ *   DESCRIPTION: opens the serial pseudo file
+ *   INPUT: filename -- ignored
+ *   OUTPUT: none
+ *   RETURN VALUE: 0, -1 without a UART
+ *   SIDE EFFECT: none
+ */
+int32_t serial_open(const uint8_t* filename) {
+    return serial_present ? 0 : -1;
+}
+
+/* serial_read
+ *   DESCRIPTION: copies out received bytes, sleeping until there is at least one unless
+ *                the fd is non-blocking (FIONBIO)
+ *   INPUT: fd -- file descriptor
+ *          buf -- user buffer
+ *          nbytes -- room in buf
+ *   OUTPUT: bytes in buf
+ *   RETURN VALUE: bytes read, 0 if a non-blocking fd had nothing, -1 on a bad buffer
+ *   SIDE EFFECT: none
+ */
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes) {
+    uint8_t * out = (uint8_t *)buf;
+    uint32_t flags;
+    int32_t i;
+
+    if (nbytes < 0 || bad_userspace_addr(buf, nbytes))
+        return -1;
+    if (nbytes == 0)
+        return 0;
+
+    cli_and_save(flags);
+    if (!get_pcb_ptr()->fds[fd].nonblock)
+        wait_event(&serial_rx_wq, rx_head != rx_tail);
+    for (i = 0; i < nbytes && rx_tail != rx_head; i++)
+        out[i] = rx_buf[rx_tail++ & SERIAL_RX_MASK];
+    restore_flags(flags);
+    return i;
+}
+
+/* serial_write
+ *   DESCRIPTION: queues raw bytes for the UART. When the ring is full the caller sleeps
+ *                until the transmit interrupt makes room, or with a non-blocking fd
+ *                gets back how much was queued.
+ *   INPUT: fd -- file descriptor
+ *          buf -- user buffer
+ *          nbytes -- bytes to write
+ *   OUTPUT: none
+ *   RETURN VALUE: bytes queued, -1 on a bad buffer
+ *   SIDE EFFECT: none
+ */
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes) {
+    const uint8_t * in = (const uint8_t *)buf;
+    uint8_t nonblock = get_pcb_ptr()->fds[fd].nonblock;
+    uint32_t flags;
+    int32_t done = 0;
+
+    if (nbytes < 0 || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    cli_and_save(flags);
+    while (done < nbytes) {
+        if (tx_head - tx_tail >= SERIAL_TX_SIZE) {
+            if (nonblock)
+                break;
+            wait_event(&serial_tx_wq, tx_head - tx_tail < SERIAL_TX_SIZE);
+        }
+        while (done < nbytes && tx_head - tx_tail < SERIAL_TX_SIZE)
+            tx_buf[tx_head++ & SERIAL_TX_MASK] = in[done++];
+        tx_kick();
+    }
+    restore_flags(flags);
+    return done;
+}
+
+/* serial_close
+ *   DESCRIPTION: closes the serial pseudo file, queued output still goes out
+ *   INPUT: fd -- ignored
+ *   OUTPUT: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECT: none
+ */
+int32_t serial_close(int32_t fd) {
+    return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef SERIAL_H_
+#define SERIAL_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+/* COM1, a 16550A UART */
+#define COM1_PORT			0x3F8
+#define SERIAL_IRQ_LINE		4
+#define SERIAL_VECTOR		0x24
+
+/* register offsets from COM1_PORT */
+#define UART_DATA			0		/* RBR / THR, divisor low with DLAB */
+#define UART_IER			1		/* interrupt enable, divisor high with DLAB */
+#define UART_IIR			2		/* interrupt identification (read) */
+#define UART_FCR			2		/* FIFO control (write) */
+#define UART_LCR			3		/* line control */
+#define UART_MCR			4		/* modem control */
+#define UART_LSR			5		/* line status */
+#define UART_SCRATCH		7
+
+#define UART_IER_RX			0x01	/* received data available */
+#define UART_IER_TX			0x02	/* transmit holding register empty */
+#define UART_IIR_NONE		0x01	/* no interrupt pending */
+#define UART_IIR_ID_MASK	0x0E
+#define UART_IIR_TX			0x02
+#define UART_IIR_RX			0x04
+#define UART_IIR_RX_TIMEOUT	0x0C
+#define UART_IIR_LINE		0x06
+#define UART_FCR_ENABLE		0xC7	/* FIFOs on and cleared, RX interrupt at 14 bytes */
+#define UART_LCR_DLAB		0x80
+#define UART_LCR_8N1		0x03
+#define UART_MCR_NORMAL		0x0B	/* DTR, RTS and OUT2 (routes the interrupt to the PIC) */
+#define UART_MCR_LOOPBACK	0x1E	/* RTS, OUT1, OUT2 and loopback, for the self test */
+#define UART_LSR_DR			0x01	/* data ready */
+#define UART_LSR_THRE		0x20	/* transmit holding register empty */
+#define UART_DIVISOR		1		/* 115200 baud */
+#define UART_TX_FIFO		16		/* bytes the transmit FIFO takes when empty */
+#define UART_TEST_BYTE		0xAE
+
+#define SERIAL_TX_SIZE		4096	/* power of two */
+#define SERIAL_TX_MASK		(SERIAL_TX_SIZE - 1)
+#define SERIAL_RX_SIZE		256		/* power of two */
+#define SERIAL_RX_MASK		(SERIAL_RX_SIZE - 1)
+#define SERIAL_FILE_NAME	"serial"	/* pseudo file next to the file system image */
+
+#ifndef ASM
+
+/* counted since boot */
+typedef struct {
+	uint32_t tx_bytes;		/* handed to the UART */
+	uint32_t rx_bytes;		/* received */
+	uint32_t tx_dropped;	/* kernel output that found the transmit ring full */
+	uint32_t rx_dropped;	/* received with the receive ring full */
+	uint32_t interrupts;
+} serial_stats_t;
+
+/* ======================================================================= */
+
+extern uint8_t serial_present;
+extern serial_stats_t serial_counters;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* probe COM1 and set it up for interrupt driven I/O */
+void serial_init(void);
+
+/* IRQ 4 */
+void serial_interrupt_handler(void);
+
+/* kernel output: queued without waiting, dropped when the ring is full */
+void serial_putc(uint8_t c);
+int32_t serial_puts(const int8_t* s);
+
+/* the "serial" pseudo file */
+int32_t serial_open(const uint8_t* filename);
+int32_t serial_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t serial_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t serial_close(int32_t fd);
+
+#endif /* ASM */
+
+#endif
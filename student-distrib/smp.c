@@ -0,0 +1,613 @@
+#include "smp.h"
+#include "apic.h"
+#include "clock.h"
+#include "fpu.h"
+#include "ioapic.h"
+#include "lib.h"
+#include "paging.h"
+#include "scheduler.h"
+#include "syscalls.h"
+#include "terminal.h"
+
+/* ============================== GLOBAL VARIABLES ======================START= */
+/* paging structures of the application processors (the boot processor uses paging.c's) */
+static uint32_t ap_page_dir[MAX_CPUS - 1][NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
+static uint32_t ap_user_pt[MAX_CPUS - 1][NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
+static uint32_t ap_video_pt[MAX_CPUS - 1][NUM_ENTRIES] __attribute__((aligned(ALIGN_BITS)));
+static tss_t ap_tss[MAX_CPUS - 1];
+static uint8_t ap_stack[MAX_CPUS - 1][AP_STACK_SIZE] __attribute__((aligned(AP_STACK_SIZE)));
+
+/* entry 0 is the boot processor, usable before smp_init runs */
+cpu_t cpus[MAX_CPUS] = {
+    { .id = 0, .online = 1, .cur_term = 0, .runq = 0x01, .fpu_owner = FPU_NO_OWNER, .armed_ticks = 1, .tss = &tss,
+      .page_dir = page_directory, .user_pt = user_page_table, .video_pt = video_page_table },
+};
+volatile uint32_t smp_ncpus = 1;
+/* CPU that runs each terminal's process, NO_CPU while it waits to be picked */
+volatile uint8_t term_cpu[MAX_TERMINALS] = { 0, NO_CPU, NO_CPU };
+
+/* APIC ID -> index into cpus[] */
+static uint8_t apic_to_cpu[NUM_VEC];
+/* the floating pointer says the board boots in PIC mode behind an IMCR */
+static uint8_t mp_imcr = 0;
+
+/* the big kernel lock */
+static volatile uint32_t kernel_lock_word = 0;
+static volatile uint8_t kernel_lock_owner = NO_CPU;
+static uint32_t kernel_lock_count = 0;
+
+/* the trampoline in ap_boot.S and the fields smp_init fills in */
+extern uint8_t ap_trampoline[], ap_trampoline_end[];
+extern uint8_t ap_gdt_desc[], ap_cr3[], ap_stack_top[];
+#define TRAMPOLINE_VAR(type, label)	(*(type *)(AP_TRAMPOLINE + ((label) - ap_trampoline)))
+/* =============================================================================END= */
+
+/* MP floating pointer structure */
+typedef struct __attribute__((packed)) {
+    uint32_t signature;
+    uint32_t config;
+    uint8_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    uint8_t type;
+    uint8_t features[4];
+} mp_float_t;
+
+/* MP configuration table header, followed by entry_count entries */
+typedef struct __attribute__((packed)) {
+    uint32_t signature;
+    uint16_t length;
+    uint8_t spec_rev;
+    uint8_t checksum;
+    int8_t oem_id[8];
+    int8_t product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_count;
+    uint32_t lapic_addr;
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+} mp_config_t;
+
+/* processor entry of the MP configuration table */
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} mp_cpu_t;
+
+/* bus entry of the MP configuration table */
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t bus_id;
+    int8_t bus_type[6];     /* "ISA   ", "PCI   ", ... */
+} mp_bus_t;
+
+/* IO APIC entry of the MP configuration table */
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t apic_id;
+    uint8_t apic_version;
+    uint8_t flags;
+    uint32_t addr;
+} mp_ioapic_t;
+
+/* IO interrupt assignment entry of the MP configuration table */
+typedef struct __attribute__((packed)) {
+    uint8_t type;
+    uint8_t int_type;
+    uint16_t flags;         /* polarity and trigger mode */
+    uint8_t src_bus;
+    uint8_t src_irq;
+    uint8_t dst_apic;
+    uint8_t dst_pin;
+} mp_ioint_t;
+
+static mp_config_t * mp_find_config(void);
+static void mp_ioapic_setup(mp_config_t * config);
+static mp_float_t * mp_scan(uint32_t addr, uint32_t len);
+static uint8_t mp_checksum(const uint8_t * p, uint32_t len);
+static int ap_start(cpu_t * cpu);
+static void ap_setup_tss(cpu_t * cpu);
+
+
+/* smp_percpu_init
+ *   DESCRIPTION: builds the processor's per-CPU data segment, based at its cpus[] entry, and
+ *                loads it into GS, so cpu_this is a single load instead of reading the local
+ *                APIC ID. Returning to user space clears GS (the segment is ring 0 only), so
+ *                interrupt and system call entry load it again from the task register.
+ *   INPUT: cpu -- the executing processor's entry, id filled in
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: changes the shared GDT and GS
+ */
+void smp_percpu_init(cpu_t * cpu) {
+    seg_desc_t the_percpu_desc;
+
+    the_percpu_desc.val[0]        = 0;
+    the_percpu_desc.val[1]        = 0;
+    the_percpu_desc.granularity   = 0;
+    the_percpu_desc.opsize        = 1;
+    the_percpu_desc.present       = 1;
+    the_percpu_desc.dpl           = 0x0;
+    the_percpu_desc.sys           = 1;
+    the_percpu_desc.type          = 0x2;      /* data, read/write */
+
+    SET_LDT_PARAMS(the_percpu_desc, cpu, sizeof(cpu_t) - 1);
+    percpu_desc_ptr[cpu->id] = the_percpu_desc;
+
+    cpu->self = cpu;
+    asm volatile("movw %w0, %%gs" : : "r"(KERNEL_PERCPU + cpu->id * sizeof(seg_desc_t)) : "memory");
+}
+
+/* smp_init
+ *   DESCRIPTION: reads the processors out of the BIOS's MP table and starts each enabled
+ *                application processor with INIT / startup IPIs. APs are started one at a
+ *                time since they share the trampoline. Stays uniprocessor without an MP
+ *                table or an APIC timer (the APs have no other tick source). Device
+ *                interrupts move to the IO APIC if the table lists one.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: maps low memory while it works, fills in cpus[]
+ */
+void smp_init(void) {
+    mp_config_t * config;
+    uint8_t * entry;
+    mp_cpu_t * mp_cpu;
+    cpu_t * cpu;
+    uint32_t i;
+    uint32_t count = 1;
+
+    if (!apic_timer_ready)
+        return;
+
+    cpus[0].apic_id = apic_id();
+    apic_to_cpu[cpus[0].apic_id] = 0;
+
+    config = mp_find_config();
+    if (config == NULL) {
+        low_mem_map(0, MP_BIOS_ROM_END, 0);
+        return;
+    }
+
+    /* before the APs copy the page tables, which must include the IO APIC mapping */
+    mp_ioapic_setup(config);
+
+    /* the trampoline has to sit below 1MB for the startup IPI (mp_find_config mapped it) */
+    memcpy((void *)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+    memcpy(&TRAMPOLINE_VAR(uint8_t, ap_gdt_desc), &gdt_desc, sizeof(uint16_t) + sizeof(uint32_t));
+
+    entry = (uint8_t *)(config + 1);
+    for (i = 0; i < config->entry_count && count < MAX_CPUS; i++) {
+        if (*entry != MP_ENTRY_CPU) {
+            entry += 8;     /* all other entry types are 8 bytes */
+            continue;
+        }
+
+        mp_cpu = (mp_cpu_t *)entry;
+        entry += sizeof(mp_cpu_t);
+        if (!(mp_cpu->flags & MP_CPU_ENABLED) || (mp_cpu->flags & MP_CPU_BSP))
+            continue;
+
+        cpu = &cpus[count];
+        cpu->id = count;
+        cpu->apic_id = mp_cpu->apic_id;
+        cpu->idle = 1;
+        cpu->cur_term = NO_TERM;
+        cpu->armed_ticks = 1;
+        cpu->tss = &ap_tss[count - 1];
+        cpu->page_dir = ap_page_dir[count - 1];
+        cpu->user_pt = ap_user_pt[count - 1];
+        cpu->video_pt = ap_video_pt[count - 1];
+        apic_to_cpu[cpu->apic_id] = count;
+
+        if (ap_start(cpu) == 0)
+            count++;
+    }
+
+    /* every terminal starts out on the boot processor, idle APs steal from there */
+    smp_ncpus = count;
+    low_mem_map(0, MP_BIOS_ROM_END, 0);
+}
+
+/* ap_start
+ *   DESCRIPTION: prepares one application processor (page tables, TSS, idle stack) and sends
+ *                it INIT and startup IPIs, then gives it AP_WAIT_ROUNDS windows to check in
+ *   INPUT: cpu -- processor to start
+ *   OUTPUT: none
+ *   RETURN VALUE: 0 once the processor is online, -1 if it never showed up
+ *   SIDE EFFECT: writes the trampoline's cr3 and stack fields
+ */
+static int ap_start(cpu_t * cpu) {
+    uint32_t i;
+
+    paging_clone(cpu);
+    ap_setup_tss(cpu);
+    TRAMPOLINE_VAR(uint32_t, ap_cr3) = (uint32_t)cpu->page_dir;
+    TRAMPOLINE_VAR(uint32_t, ap_stack_top) = (uint32_t)ap_stack[cpu->id - 1] + AP_STACK_SIZE;
+
+    apic_send_ipi(cpu->apic_id, ICR_INIT);
+    pit_delay_start(AP_WAIT_MS);
+    pit_delay_wait();
+    for (i = 0; i < AP_STARTUP_TRIES && !cpu->online; i++) {
+        apic_send_ipi(cpu->apic_id, ICR_STARTUP | (AP_TRAMPOLINE / ALIGN_BITS));
+        pit_delay_start(1);
+        pit_delay_wait();
+    }
+
+    for (i = 0; i < AP_WAIT_ROUNDS && !cpu->online; i++) {
+        pit_delay_start(AP_WAIT_MS);
+        pit_delay_wait();
+    }
+
+    return cpu->online ? 0 : -1;
+}
+
+/* ap_setup_tss
+ *   DESCRIPTION: builds the processor's TSS descriptor in its GDT slot, like entry() does
+ *                for the boot processor's
+ *   INPUT: cpu -- application processor
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: changes the shared GDT
+ */
+static void ap_setup_tss(cpu_t * cpu) {
+    seg_desc_t the_tss_desc;
+
+    the_tss_desc.granularity    = 0;
+    the_tss_desc.opsize         = 0;
+    the_tss_desc.reserved       = 0;
+    the_tss_desc.avail          = 0;
+    the_tss_desc.seg_lim_19_16  = TSS_SIZE & 0x000F0000;
+    the_tss_desc.present        = 1;
+    the_tss_desc.dpl            = 0x0;
+    the_tss_desc.sys            = 0;
+    the_tss_desc.type           = 0x9;
+    the_tss_desc.seg_lim_15_00  = TSS_SIZE & 0x0000FFFF;
+
+    SET_TSS_PARAMS(the_tss_desc, cpu->tss, tss_size);
+    ap_tss_desc_ptr[cpu->id - 1] = the_tss_desc;
+
+    cpu->tss->ldt_segment_selector = KERNEL_LDT;
+    cpu->tss->ss0 = KERNEL_DS;
+    cpu->tss->esp0 = (uint32_t)ap_stack[cpu->id - 1] + AP_STACK_SIZE;
+}
+
+/* ap_main
+ *   DESCRIPTION: C entry of an application processor, on its idle stack with paging on.
+ *                Loads the shared IDT, its own TSS and enables its APIC, then idles until
+ *                a timer interrupt or a kick from another CPU gives it a terminal to run.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: never returns
+ *   SIDE EFFECT: marks the processor online
+ */
+void ap_main(void) {
+    cpu_t * cpu = &cpus[apic_to_cpu[apic_id() & (NUM_VEC - 1)]];
+
+    asm volatile("lidt idt_desc_ptr" : : : "memory");
+    ltr(KERNEL_AP_TSS + (cpu->id - 1) * sizeof(seg_desc_t));
+    smp_percpu_init(cpu);
+    asm volatile("lldt %%ax" : : "a"(KERNEL_LDT) : "memory");
+    apic_ap_init();
+    fpu_init();
+
+    cpu->online = 1;
+
+    /* the scheduler switches away from this stack for good once there is work */
+    while (1)
+        asm volatile("sti; hlt; cli" : : : "memory", "cc");
+}
+
+/* smp_set_terminal
+ *   DESCRIPTION: makes this CPU the one running term's process and moves term into its run
+ *                queue. The terminal it ran before goes back to waiting in this queue, and a
+ *                hungry CPU is kicked so it can steal it.
+ *   INPUT: term -- terminal index
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: updates cur_active_terminal, term_cpu and the run queues
+ */
+void smp_set_terminal(uint8_t term) {
+    cpu_t * cpu = cpu_this();
+    uint8_t old = cpu->cur_term;
+    uint32_t i;
+
+    if (!cpu->idle && old != term && term_cpu[old] == cpu->id) {
+        term_cpu[old] = NO_CPU;
+        smp_kick_terminal(old);
+    }
+
+    for (i = 0; i < smp_ncpus; i++)
+        cpus[i].runq &= ~(1 << term);
+    cpu->runq |= (1 << term);
+
+    cpu->idle = 0;
+    cpu->cur_term = term;
+    term_cpu[term] = cpu->id;
+}
+
+/* smp_allowed
+ *   DESCRIPTION: a CPU may run a terminal that isn't running on another CPU and that is in
+ *                its run queue. A CPU with nothing of its own to run may steal from the
+ *                other queues; smp_set_terminal moves the stolen terminal to its queue.
+ *   INPUT: term -- terminal index
+ *          steal -- 1 to look at other CPUs' queues too
+ *   OUTPUT: none
+ *   RETURN VALUE: 1 if the terminal may be picked, 0 otherwise
+ *   SIDE EFFECT: none
+ */
+int smp_allowed(uint8_t term, uint8_t steal) {
+    cpu_t * cpu = cpu_this();
+
+    if (term_cpu[term] != NO_CPU && term_cpu[term] != cpu->id)
+        return 0;
+    return steal || (cpu->runq & (1 << term)) || term_cpu[term] == cpu->id;
+}
+
+/* smp_kick_terminal
+ *   DESCRIPTION: sends a reschedule IPI to the CPU that runs term, or whose queue holds it.
+ *                If that is this CPU, a hungry CPU is kicked instead so it can steal term.
+ *   INPUT: term -- terminal index
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: the other CPU runs its scheduler as soon as it can take the kernel lock
+ */
+void smp_kick_terminal(uint8_t term) {
+    uint32_t i;
+    uint8_t target = term_cpu[term];
+    uint8_t me;
+
+    if (smp_ncpus == 1)
+        return;
+    me = cpu_this()->id;
+
+    if (target == NO_CPU) {
+        for (i = 0; i < smp_ncpus; i++) {
+            if (cpus[i].runq & (1 << term))
+                target = i;
+        }
+    }
+
+    if (target == NO_CPU || target == me) {
+        target = NO_CPU;
+        for (i = 0; i < smp_ncpus; i++) {
+            if (i != me && (cpus[i].idle || cpus[i].hungry))
+                target = i;
+        }
+    }
+
+    if (target != NO_CPU)
+        apic_send_ipi(cpus[target].apic_id, APIC_ICR_FIXED | APIC_RESCHED_VECTOR);
+}
+
+/* kernel_lock
+ *   DESCRIPTION: takes the big kernel lock. Only one CPU runs kernel code at a time, so the
+ *                existing (uniprocessor) kernel data needs no further locking. Every interrupt
+ *                and system call takes it, the timer tick and scheduler included, so the CPUs
+ *                only overlap in user code. The owner may take it again, e.g. for an interrupt
+ *                during a system call.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: spins while another CPU holds the lock, flushes a stale TLB; interrupts
+ *                must be off
+ */
+void kernel_lock(void) {
+    cpu_t * cpu;
+    uint8_t me;
+    uint32_t taken;
+
+    if (smp_ncpus == 1)
+        return;
+
+    cpu = cpu_this();
+    me = cpu->id;
+    if (kernel_lock_owner == me) {
+        kernel_lock_count++;
+        return;
+    }
+
+    do {
+        while (kernel_lock_word)
+            asm volatile("pause");
+        taken = 1;
+        asm volatile("xchgl %0, %1" : "+r"(taken), "+m"(kernel_lock_word) : : "memory");
+    } while (taken);
+
+    kernel_lock_owner = me;
+    kernel_lock_count = 1;
+
+    /* kernel_pde_set changed a mapping while this CPU was out of the kernel */
+    if (cpu->tlb_stale) {
+        cpu->tlb_stale = 0;
+        flush_tlb();
+    }
+}
+
+/* kernel_unlock
+ *   DESCRIPTION: gives up one level of the big kernel lock
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: other CPUs may enter the kernel once the last level is gone
+ */
+void kernel_unlock(void) {
+    if (smp_ncpus == 1 || kernel_lock_owner != cpu_this()->id)
+        return;
+
+    if (--kernel_lock_count == 0) {
+        kernel_lock_owner = NO_CPU;
+        asm volatile("" : : : "memory");
+        kernel_lock_word = 0;
+    }
+}
+
+/* kernel_unlock_all
+ *   DESCRIPTION: drops every level of the big kernel lock this CPU holds, for halting and for
+ *                returning to user space
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: number of levels held, for kernel_relock
+ *   SIDE EFFECT: none
+ */
+uint32_t kernel_unlock_all(void) {
+    uint32_t depth;
+
+    if (smp_ncpus == 1 || kernel_lock_owner != cpu_this()->id)
+        return 0;
+
+    depth = kernel_lock_count;
+    kernel_lock_count = 1;
+    kernel_unlock();
+    return depth;
+}
+
+/* kernel_relock
+ *   DESCRIPTION: takes the big kernel lock back at the depth kernel_unlock_all dropped
+ *   INPUT: depth -- levels to hold
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: may spin
+ */
+void kernel_relock(uint32_t depth) {
+    if (depth == 0)
+        return;
+    kernel_lock();
+    kernel_lock_count = depth;
+}
+
+/* kernel_lock_depth / kernel_lock_set_depth
+ *   DESCRIPTION: the lock stays with the CPU across a context switch, but the nesting belongs
+ *                to the kernel stack being left; process_contextswitch saves it in the PCB
+ *   INPUT: depth -- levels the resumed stack expects to release
+ *   OUTPUT: none
+ *   RETURN VALUE: current depth
+ *   SIDE EFFECT: none
+ */
+uint32_t kernel_lock_depth(void) {
+    return kernel_lock_count;
+}
+
+void kernel_lock_set_depth(uint32_t depth) {
+    if (smp_ncpus > 1 && kernel_lock_owner == cpu_this()->id)
+        kernel_lock_count = depth;
+}
+
+/* mp_find_config
+ *   DESCRIPTION: looks for the MP floating pointer where the spec puts it: the first KB of
+ *                the EBDA, the last KB of base memory and the BIOS ROM
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: the MP configuration table, NULL if there is none we can reach
+ *   SIDE EFFECT: maps the first MB of memory, smp_init unmaps it again
+ */
+static mp_config_t * mp_find_config(void) {
+    mp_float_t * mp;
+    mp_config_t * config;
+    uint32_t ebda;
+
+    low_mem_map(0, MP_BIOS_ROM_END, 1);
+
+    ebda = (uint32_t)(*(uint16_t *)MP_EBDA_PTR) << 4;
+    mp = NULL;
+    if (ebda != 0)
+        mp = mp_scan(ebda, 1024);
+    if (mp == NULL)
+        mp = mp_scan(MP_BASE_MEM_END, 1024);
+    if (mp == NULL)
+        mp = mp_scan(MP_BIOS_ROM, MP_BIOS_ROM_END - MP_BIOS_ROM);
+
+    /* only the first 4MB are identity mapped here */
+    if (mp == NULL || mp->config == 0 || mp->config >= _4MB)
+        return NULL;
+
+    config = (mp_config_t *)mp->config;
+    if (config->signature != MP_CONFIG_SIG || mp_checksum((uint8_t *)config, config->length) != 0)
+        return NULL;
+    mp_imcr = (mp->features[1] & MP_FEATURE_IMCR) != 0;
+    return config;
+}
+
+/* mp_ioapic_setup
+ *   DESCRIPTION: finds the first usable IO APIC and the ISA bus in the MP table, records
+ *                the ISA interrupt entries that go to that IO APIC and hands the device
+ *                interrupts over to it. Leaves the 8259 in charge if there is none.
+ *   INPUT: config -- MP configuration table
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: see ioapic_init
+ */
+static void mp_ioapic_setup(mp_config_t * config) {
+    mp_ioapic_t * io = NULL;
+    mp_ioint_t * irq;
+    uint8_t * entry = (uint8_t *)(config + 1);
+    uint8_t isa_bus = NO_BUS;
+    uint32_t i;
+
+    /* buses and IO APICs come before the interrupt entries that refer to them */
+    for (i = 0; i < config->entry_count; i++) {
+        switch (*entry) {
+            case MP_ENTRY_CPU:
+                entry += sizeof(mp_cpu_t);
+                continue;
+            case MP_ENTRY_BUS:
+                if (strncmp(((mp_bus_t *)entry)->bus_type, MP_BUS_ISA, sizeof(MP_BUS_ISA) - 1) == 0)
+                    isa_bus = ((mp_bus_t *)entry)->bus_id;
+                break;
+            case MP_ENTRY_IOAPIC:
+                if (io == NULL && (((mp_ioapic_t *)entry)->flags & MP_IOAPIC_ENABLED))
+                    io = (mp_ioapic_t *)entry;
+                break;
+            case MP_ENTRY_IOINT:
+                irq = (mp_ioint_t *)entry;
+                if (io != NULL && irq->int_type == MP_INT_VECTORED && irq->src_bus == isa_bus &&
+                    (irq->dst_apic == io->apic_id || irq->dst_apic == MP_ALL_IOAPICS))
+                    ioapic_route(irq->src_irq, irq->dst_pin, irq->flags);
+                break;
+        }
+        entry += 8;     /* all other entry types are 8 bytes */
+    }
+
+    if (io != NULL)
+        ioapic_init(io->addr, mp_imcr, cpus[0].apic_id);
+}
+
+/* mp_scan
+ *   DESCRIPTION: searches a range for a valid MP floating pointer (16 byte aligned)
+ *   INPUT: addr, len -- range to search
+ *   OUTPUT: none
+ *   RETURN VALUE: the floating pointer, NULL if not found
+ *   SIDE EFFECT: none
+ */
+static mp_float_t * mp_scan(uint32_t addr, uint32_t len) {
+    uint32_t p;
+
+    for (p = addr; p + sizeof(mp_float_t) <= addr + len; p += sizeof(mp_float_t)) {
+        if (((mp_float_t *)p)->signature == MP_FLOAT_SIG &&
+            mp_checksum((uint8_t *)p, sizeof(mp_float_t)) == 0)
+            return (mp_float_t *)p;
+    }
+    return NULL;
+}
+
+/* mp_checksum
+ *   DESCRIPTION: MP structures are valid when all their bytes add up to 0
+ *   INPUT: p, len -- bytes to add
+ *   OUTPUT: none
+ *   RETURN VALUE: the 8 bit sum
+ *   SIDE EFFECT: none
+ */
+static uint8_t mp_checksum(const uint8_t * p, uint32_t len) {
+    uint8_t sum = 0;
+
+    while (len--)
+        sum += *p++;
+    return sum;
+}
@@ -0,0 +1,118 @@
+#ifndef SMP_H_
+#define SMP_H_
+
+#include "types.h"
+#include "x86_desc.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+#define AP_TRAMPOLINE		0x8000		/* real mode entry of the application processors (page aligned, < 1MB) */
+#define AP_STACK_SIZE		_4KB		/* idle stack of an application processor */
+#define NO_CPU				0xFF
+#define NO_TERM				0xFF
+
+/* MP floating pointer and configuration table (Intel MultiProcessor Specification 1.4) */
+#define MP_FLOAT_SIG		0x5F504D5F	/* "_MP_" */
+#define MP_CONFIG_SIG		0x504D4350	/* "PCMP" */
+#define MP_EBDA_PTR			0x40E		/* BIOS data area: real mode segment of the EBDA */
+#define MP_BASE_MEM_END		0x9FC00		/* last KB of base memory if there is no EBDA */
+#define MP_BIOS_ROM			0xF0000
+#define MP_BIOS_ROM_END		0x100000
+#define MP_ENTRY_CPU		0
+#define MP_ENTRY_BUS		1
+#define MP_ENTRY_IOAPIC		2
+#define MP_ENTRY_IOINT		3
+#define MP_ENTRY_LINT		4
+#define MP_CPU_ENABLED		0x01
+#define MP_CPU_BSP			0x02
+#define MP_IOAPIC_ENABLED	0x01
+#define MP_INT_VECTORED		0			/* IO interrupt entry type: an ordinary interrupt */
+#define MP_ALL_IOAPICS		0xFF		/* IO interrupt entry aimed at every IO APIC */
+#define MP_FEATURE_IMCR		0x80		/* floating pointer feature byte 2: IMCR present */
+#define MP_BUS_ISA			"ISA"
+#define NO_BUS				0xFF
+
+/* ICR delivery modes for bringing up an AP */
+#define ICR_INIT			0x00004500	/* INIT, level assert */
+#define ICR_STARTUP			0x00004600	/* SIPI, vector = start page */
+#define AP_STARTUP_TRIES	2
+#define AP_WAIT_MS			10
+#define AP_WAIT_ROUNDS		10			/* AP_WAIT_MS windows an AP gets to check in */
+
+#ifndef ASM
+
+/* One entry per processor. cur_term is the terminal whose process runs here,
+ * runq the set of terminals (bit n = terminal n) this CPU schedules. Each CPU's
+ * GS selects a segment based at its entry, so self is at %gs:0 (see cpu_this). */
+typedef struct cpu {
+	struct cpu * self;			/* must stay first */
+	uint8_t id;					/* index into cpus[] */
+	uint8_t apic_id;
+	volatile uint8_t online;
+	volatile uint8_t idle;		/* still on its idle stack, cur_term is meaningless */
+	volatile uint8_t hungry;	/* halted with nothing to run (sched_block) */
+	volatile uint8_t cur_term;
+	volatile uint8_t next_term;	/* terminal the scheduler picked to switch to next */
+	volatile uint8_t runq;
+	uint8_t fpu_owner;			/* process whose state the FPU registers hold (fpu.c) */
+	volatile uint8_t preempt_off;	/* tasklets run with interrupts on: sched_tick must not switch */
+	volatile uint8_t tick_armed;	/* a one-shot is programmed and has not fired yet */
+	volatile uint8_t tlb_stale;		/* another CPU changed a kernel PDE: flush in kernel_lock */
+	uint32_t armed_ticks;			/* periodic ticks the pending one-shot stands for */
+	uint32_t idle_esp;
+	uint32_t idle_ebp;
+	tss_t * tss;
+	uint32_t * page_dir;
+	uint32_t * user_pt;			/* per-CPU copy of user_page_table (128MB / 136MB / 100MB mappings) */
+	uint32_t * video_pt;		/* per-CPU copy of video_page_table */
+} cpu_t;
+
+/* ======================================================================= */
+
+extern cpu_t cpus[MAX_CPUS];
+extern volatile uint32_t smp_ncpus;
+/* CPU that runs each terminal's process, NO_CPU while it waits to be picked */
+extern volatile uint8_t term_cpu[];
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* The processor executing this code: one load through GS, which every interrupt and
+ * system call entry sets up (PERCPU_LOAD in interrupts.S). Volatile so the compiler
+ * never reuses it across a context switch, after which the stack may be on another CPU. */
+static inline cpu_t * cpu_this(void) {
+	cpu_t * cpu;
+	asm volatile("movl %%gs:0, %0" : "=r"(cpu));
+	return cpu;
+}
+
+/* point GS of the executing processor at cpu */
+void smp_percpu_init(cpu_t * cpu);
+
+/* find the other processors in the MP table and start them */
+void smp_init(void);
+
+/* C entry of an application processor, called from the trampoline */
+void ap_main(void);
+
+/* make this CPU run term, releasing the terminal it ran before */
+void smp_set_terminal(uint8_t term);
+
+/* may this CPU run term? steal: also take terminals queued on other CPUs */
+int smp_allowed(uint8_t term, uint8_t steal);
+
+/* make term's CPU look at its run queue again */
+void smp_kick_terminal(uint8_t term);
+
+/* big kernel lock, recursive per CPU; entered on every interrupt and system call */
+void kernel_lock(void);
+void kernel_unlock(void);
+/* drop the lock completely (before halting or returning to user space), returns the depth held */
+uint32_t kernel_unlock_all(void);
+/* take the lock again at the depth kernel_unlock_all returned */
+void kernel_relock(uint32_t depth);
+/* lock depth of this CPU, saved in the PCB across context switches */
+uint32_t kernel_lock_depth(void);
+void kernel_lock_set_depth(uint32_t depth);
+
+#endif /* ASM */
+
+#endif
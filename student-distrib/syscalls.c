@@ -1,4 +1,10 @@
 #include "scheduler.h"
+#include "fpu.h"
+#include "trace.h"
+#include "vbe.h"
+#include "acct.h"
+#include "serial.h"
+#include "irqstat.h"
 
 /* ====================== DECLARE GLOBAL VARIABLES ====================== */
 /* Process ID Array to start a new process - only can have 6 at a time */
@@ -37,6 +43,21 @@ fops_t fops_file = {file_read,
 					file_open, 
 					file_close };
 
+fops_t fops_trace = {trace_read, 
+					trace_write, 
+					trace_open, 
+					trace_close };
+
+fops_t fops_serial = {serial_read, 
+					serial_write, 
+					serial_open, 
+					serial_close };
+
+fops_t fops_irqstat = {irqstat_read, 
+					irqstat_write, 
+					irqstat_open, 
+					irqstat_close };
+
 /* ========= fops table ptrs for ERRORS ========== */
 fops_t fops_error = {has_error, 
 					has_error, 
@@ -57,7 +78,15 @@ int32_t sys_open(const uint8_t* filename) {
 	dentry_t dir_entry;
 	/* check if file with name exist in system */
 	if (read_dentry_by_name(filename, &dir_entry) == -1) {
-		return -1;
+		/* kernel pseudo files are not in the image */
+		if (strncmp((int8_t*)filename, TRACE_FILE_NAME, FILE_NAME_SIZE) == 0)
+			dir_entry.filetype = FILE_TYPE_TRACE;
+		else if (strncmp((int8_t*)filename, SERIAL_FILE_NAME, FILE_NAME_SIZE) == 0)
+			dir_entry.filetype = FILE_TYPE_SERIAL;
+		else if (strncmp((int8_t*)filename, IRQSTAT_FILE_NAME, FILE_NAME_SIZE) == 0)
+			dir_entry.filetype = FILE_TYPE_IRQSTAT;
+		else
+			return -1;
 	}
 
 	/* Get current PCB */
@@ -69,6 +98,7 @@ int32_t sys_open(const uint8_t* filename) {
 		if (pcb->fds[index].flags == FD_OCCUP) {
 			pcb->fds[index].flags = FD_AVAIL;
 			pcb->fds[index].file_position = OFFSET_START;
+			pcb->fds[index].nonblock = 0;
 			break;
 		} else if (index == (NUM_MAX_OPEN_FILES - 1)) {
 			/* there is no avalible space in fd array */
@@ -106,6 +136,33 @@ int32_t sys_open(const uint8_t* filename) {
 			pcb->fds[index].inode = dir_entry.inodeNumber;
 			pcb->fds[index].fops_ptr = fops_file;
 			break;
+
+		case FILE_TYPE_TRACE:
+			if (trace_open(filename) != SUCCESS)
+				return -1;
+
+			/* populate fields */
+			pcb->fds[index].inode = NULL;
+			pcb->fds[index].fops_ptr = fops_trace;
+			break;
+
+		case FILE_TYPE_SERIAL:
+			if (serial_open(filename) != SUCCESS)
+				return -1;
+
+			/* populate fields */
+			pcb->fds[index].inode = NULL;
+			pcb->fds[index].fops_ptr = fops_serial;
+			break;
+
+		case FILE_TYPE_IRQSTAT:
+			if (irqstat_open(filename) != SUCCESS)
+				return -1;
+
+			/* populate fields */
+			pcb->fds[index].inode = NULL;
+			pcb->fds[index].fops_ptr = fops_irqstat;
+			break;
 	}
 	
 	return index;
@@ -202,6 +259,45 @@ int32_t sys_close(int32_t fd)
 
 
 
+/* sys_ioctl
+ * DESCRIPTION: system call for ioctl, device control on an open terminal or serial fd.
+ *              FIONBIO makes reads (and serial writes) on fd return instead of waiting;
+ *              the TC_ commands change the terminal's line discipline (see terminal_ioctl)
+ *              and fail on the serial port, which has none
+ * INPUTS: fd index, command, argument
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on failure
+ * SIDE EFFECTS: changes the fd or the calling process's terminal
+ */
+int32_t sys_ioctl(int32_t fd, int32_t cmd, int32_t arg)
+{
+	pcb_t *pcb = get_pcb_ptr();
+
+	/* ERROR CATCH: check fd bounds: 0 ~ 7 */
+	if (fd < 0 || fd > (NUM_MAX_OPEN_FILES - 1)) {
+		return -1;
+	}
+
+	/* only the terminal's input fd and the serial port take commands */
+	if (pcb->fds[fd].flags == FD_OCCUP) {
+		return -1;
+	}
+	if (pcb->fds[fd].fops_ptr.read != terminal_read && pcb->fds[fd].fops_ptr.read != serial_read) {
+		return -1;
+	}
+
+	if (cmd == FIONBIO) {
+		pcb->fds[fd].nonblock = (arg != 0);
+		return 0;
+	}
+	if (pcb->fds[fd].fops_ptr.read != terminal_read) {
+		return -1;
+	}
+	return terminal_ioctl(pcb->term, cmd, arg);
+}
+
+
+
 
 
 /* halt
@@ -220,12 +316,21 @@ int32_t halt(uint8_t status)
 	/* start critical section: stop interrupts ============================ */
 	cli();
 
+    /* the terminal this CPU runs, read once: interrupts stay off until the switch */
+    uint8_t cur_term_id = cur_active_terminal;
+
     /* Obtain PCB of current process and parent process */
-    pcb_t* current_pcb = get_pcb_ptr_process(terminal[cur_active_terminal].apn);
+    pcb_t* current_pcb = get_pcb_ptr_process(terminal[cur_term_id].apn);
     pcb_t* parent_pcb = get_pcb_ptr_process(current_pcb->parent_process_number);
 
 	/* Free spot in pid_array */
     pid_array[(uint8_t)current_pcb->process_number] = FREE;
+    fpu_release(current_pcb->process_number);
+    vbe_release(current_pcb->process_number);
+    terminal_ld_release(current_pcb->process_number);
+    term_ansi_reset(current_pcb->term->id);
+    if (current_pcb->vidmapped)
+        current_pcb->term->pinned--;
 
 	
     /* Update all flags in PCB to default -- aka free */
@@ -240,14 +345,14 @@ int32_t halt(uint8_t status)
 	
 
 	/* Set executing terminal's active process number to parent_pcb (to RESTORE to) */
-	terminal[cur_active_terminal].apn = parent_pcb->process_number;
+	terminal[cur_term_id].apn = parent_pcb->process_number;
 	
 
 	/* Make sure we do not halt last process active */
 	if (current_pcb->process_number == current_pcb->parent_process_number )
 	{
 		/* Reopen SHELL if it is the last active process that we are halting */
-		terminal[cur_active_terminal].active = FD_OCCUP;
+		terminal[cur_term_id].active = FD_OCCUP;
 		execute((uint8_t *)"shell");
 	}
 
@@ -255,7 +360,10 @@ int32_t halt(uint8_t status)
     page_remap(_128MB, _8MB + parent_pcb->process_number * _4MB);
     
     /* Reset ESP0 in TSS */
-	tss.esp0 = current_pcb->parent_ksp;
+	cpu_this()->tss->esp0 = current_pcb->parent_ksp;
+	fpu_switch(parent_pcb->process_number);
+	vbe_switch(parent_pcb->process_number);
+	acct_resume(parent_pcb);
 	
 	sti();
 	/* end critical section: start interrupts ============================ */
@@ -293,6 +401,11 @@ int32_t execute(const uint8_t* command) {
 	int i;
 	cli();
 
+	/* whoever runs here stops being charged until it gets the CPU back */
+	cpu_t * cpu = cpu_this();
+	if (terminal[cpu->cur_term].active == AVIL && !cpu->idle)
+		acct_charge(get_pcb_ptr_process(terminal[cpu->cur_term].apn));
+
 	/* DECLARE LOCAL VARIABLES */
 	int8_t parsed_cmd[MAX_COMMAND_SIZE];
 	int8_t arg[MAX_BUFFER_SIZE];
@@ -417,17 +530,24 @@ int32_t execute(const uint8_t* command) {
 	if (terminal[cur_term].active == FREE)
 	{
 		/* update process status, set self as parent and mark active */
-		cur_active_terminal = cur_term;
+		smp_set_terminal(cur_term);
 		process_control_block->parent_process_number = process_control_block->process_number;
 		terminal[cur_term].active = AVIL;
+		sched_init_process(process_control_block, SCHED_TOP_LEVEL);
 	}
 	/* update parent's process number */
 	else {
 		parent_PCB = get_pcb_ptr_process(terminal[cur_term].apn);
 		process_control_block->parent_process_number = parent_PCB->process_number;
+		sched_init_process(process_control_block, parent_PCB->sched_prio);
 	}
 
 
+	/* no FPU state until its first #NM */
+	process_control_block->fpu_used = 0;
+	process_control_block->vidmapped = 0;
+	acct_init_process(process_control_block, parsed_cmd);
+
 	/* PCB's arg is stored */
 	strcpy(process_control_block->argbuf, arg);
 	
@@ -440,6 +560,7 @@ int32_t execute(const uint8_t* command) {
  		process_control_block->fds[i].inode = -1; 
  		/* set offset to 0 */
 		process_control_block->fds[i].file_position = OFFSET_START;
+		process_control_block->fds[i].nonblock = 0;
 		/* set flag to avaliable */
  		process_control_block->fds[i].flags = FD_OCCUP;
  	}
@@ -456,11 +577,18 @@ int32_t execute(const uint8_t* command) {
 	/* Update the terminal number and process number to the actve one */
 	process_control_block->term = &terminal[cur_term];
 	terminal[cur_term].apn = process_control_block->process_number;
+	/* a new terminal coming up may leave more than one process to preempt */
+	tick_next();
 
 
     /* CONTEXT SWITCH: Save SS0 and ESP0 */
-    tss.ss0 = KERNEL_DS;
-    tss.esp0 = _8MB - _8KB * (new_process_num) - 4;
+    cpu_this()->tss->ss0 = KERNEL_DS;
+    cpu_this()->tss->esp0 = _8MB - _8KB * (new_process_num) - 4;
+    fpu_switch(new_process_num);
+    vbe_switch(new_process_num);
+
+    /* user space never holds the kernel lock */
+    kernel_unlock_all();
 
     sti();
 	/* end critical section: start interrupts ============================ */
@@ -531,8 +659,17 @@ int32_t vidmap(uint8_t ** screen_start)
 	{
 		return -1;
 	}
+	/* the program draws at the start of video memory, stop hardware scrolling its terminal */
+	pcb_t * pcb = get_pcb_ptr();
+	if (pcb->vidmapped == 0) {
+		pcb->vidmapped = 1;
+		pcb->term->pinned++;
+		terminal_out_flush(pcb->term->id);
+		screen_rebase(pcb->term->id);
+	}
+
 	/*fix paging*/
-	table_remap((uint32_t)_136MB, (uint32_t)VIDEO);
+	table_remap((uint32_t)_136MB, (uint32_t)pcb->term->video_mem);
 
 	/* where screen should start */
 	*screen_start = (uint8_t*)_136MB;
@@ -588,22 +725,16 @@ int32_t get_proc_num()
 
 /*
 *	get_pcb_ptr()
-*	DESCRIPTION: fetches a pointer to the PCB
+*	DESCRIPTION: fetches a pointer to the PCB of the process the executing CPU runs. This used
+*				 to mask ESP, which breaks on an AP's idle stack; every CPU keeps its own
+*				 cur_active_terminal, whose active process is the one running.
 *	INPUT: none
 *	OUTPUT: pointer to the PCB
 *	SIDE EFFECT: none
 */
 pcb_t* get_pcb_ptr(void)
 {
-	pcb_t* ptr;
-	asm volatile("				   \n\
-				andl %%esp, %%eax  \n\
-				"
-				:"=a"(ptr)
-				:"a"(PCB_PTR_MASK)
-				:"cc"
-				);
-	return ptr;
+	return get_pcb_ptr_process(terminal[cur_active_terminal].apn);
 };
 
 /*
@@ -21,6 +21,9 @@
 #define PROG_NOT_ACTIVE 0
 #define PROG_ACTIVE 1
 
+#define PROC_RUNNABLE 0
+#define PROC_BLOCKED 1
+
 #define FD_OCCUP 0
 #define FD_AVAIL 1
 
@@ -54,6 +57,9 @@
 #define FILE_TYPE_RTC	0 
 #define FILE_TYPE_DIR	1
 #define	FILE_TYPE_FILE	2
+#define FILE_TYPE_TRACE	3	/* kernel pseudo file, not in the file system image */
+#define FILE_TYPE_SERIAL	4	/* COM1, also a pseudo file */
+#define FILE_TYPE_IRQSTAT	5	/* per-vector interrupt counters, read only */
 
 #define FILE_NAME_SIZE 32
 
@@ -74,6 +80,7 @@ typedef struct {
 	int32_t inode; 
 	int32_t file_position; 
 	int32_t flags; 
+	int32_t nonblock;	/* set by FIONBIO: terminal reads return instead of waiting */
 } file_desc_t;
 
 /*struct for defining pcb*/
@@ -89,9 +96,26 @@ typedef struct {
 	term_t * term;
     uint32_t esp;
     uint32_t ebp;
+	volatile uint8_t state;	/* PROC_RUNNABLE or PROC_BLOCKED on a wait queue */
+	uint8_t sched_level;	/* current MLFQ level, 0 is the highest */
+	uint8_t sched_prio;		/* best level the process may run at (set_priority) */
+	uint8_t sched_ticks;	/* PIT ticks left in the current slice */
+	uint32_t lock_depth;	/* kernel lock nesting of this stack while switched out */
+	uint8_t fpu_used;		/* has touched the FPU, its save area in fpu.c is valid */
+	uint8_t vidmapped;		/* called vidmap, counted in term->pinned */
+	uint8_t acct_mode;		/* ACCT_USER or ACCT_SYS, see acct.c */
+	uint64_t acct_stamp;	/* clock_ns() when the process was last charged */
+	uint64_t utime_ns;
+	uint64_t stime_ns;
+	uint32_t nvcsw;			/* switched out while blocked */
+	uint32_t nivcsw;		/* switched out while runnable (preempted) */
+	uint32_t nsyscalls;
+	uint8_t name[FILE_NAME_SIZE];	/* program name */
  } pcb_t; 
  
  extern uint8_t process_id_array [NUM_MAX_PROCESSES];
+ /* process numbers in use (FREE or 1) */
+ extern uint8_t pid_array [NUM_MAX_PROCESSES];
 
 /* halt programs */
 int32_t halt (uint8_t status);
@@ -111,6 +135,9 @@ int32_t sys_open (const uint8_t* filename);
 /* close programs */
 int32_t sys_close (int32_t fd);
 
+/* terminal line discipline and non-blocking reads */
+int32_t sys_ioctl (int32_t fd, int32_t cmd, int32_t arg);
+
 /* get arguments */
 int32_t getargs (uint8_t* buf, int32_t nbytes);
 
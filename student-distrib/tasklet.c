@@ -0,0 +1,148 @@
+/* tasklet.c - deferred work for interrupt handlers
+ *
+ * Handlers queue a tasklet_t instead of doing their work with interrupts off. The queue
+ * is drained by tasklet_run with interrupts on, once per interrupt on the way out and by
+ * the scheduler before it decides what to run next. Everything happens under the big
+ * kernel lock, so one queue serves all CPUs; while it is drained the CPU is not preempted
+ * (preempt_off), which keeps the drain from being stranded on a sleeping process's stack.
+ */
+
+#include "tasklet.h"
+#include "clock.h"
+#include "lib.h"
+#include "smp.h"
+
+tasklet_stats_t tasklet_stats;
+tasklet_t * tasklet_list = NULL;
+
+/* FIFO of queued tasklets */
+static tasklet_t * tasklet_head = NULL;
+static tasklet_t * tasklet_tail = NULL;
+/* somebody further down some stack is draining the queue */
+static volatile uint8_t tasklet_running = 0;
+
+/* tasklet_init
+ *   DESCRIPTION: sets up a tasklet and lists it for the statistics
+ *   INPUT: t -- tasklet, usually static in the driver
+ *          name -- shown in the interrupts file
+ *          func -- work to do, called with data
+ *          data -- argument of func
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: must be called once per tasklet, before it is scheduled
+ */
+void tasklet_init(tasklet_t * t, const int8_t * name, void (*func)(uint32_t), uint32_t data) {
+    uint32_t flags;
+
+    t->func = func;
+    t->data = data;
+    t->name = name;
+    t->queued = 0;
+    t->next = NULL;
+    t->runs = 0;
+    t->max_latency = 0;
+    t->latency = 0;
+
+    cli_and_save(flags);
+    t->all = tasklet_list;
+    tasklet_list = t;
+    restore_flags(flags);
+}
+
+/* tasklet_schedule
+ *   DESCRIPTION: puts a tasklet at the end of the queue. A tasklet that is queued already
+ *                stays where it is: its one run will see whatever the handler left for it.
+ *                A running tasklet can be queued again.
+ *   INPUT: t -- tasklet to run
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void tasklet_schedule(tasklet_t * t) {
+    uint32_t flags;
+
+    cli_and_save(flags);
+    if (t->queued) {
+        tasklet_stats.coalesced++;
+        restore_flags(flags);
+        return;
+    }
+
+    t->queued = 1;
+    t->next = NULL;
+    t->queued_at = clock_has_tsc ? rdtsc() : 0;
+    if (tasklet_tail == NULL)
+        tasklet_head = t;
+    else
+        tasklet_tail->next = t;
+    tasklet_tail = t;
+
+    tasklet_stats.scheduled++;
+    if (++tasklet_stats.depth > tasklet_stats.max_depth)
+        tasklet_stats.max_depth = tasklet_stats.depth;
+    restore_flags(flags);
+}
+
+/* tasklet_run
+ *   DESCRIPTION: runs queued tasklets in order, each with interrupts on, until the queue is
+ *                empty. Interrupts that arrive meanwhile only queue more; a nested call
+ *                returns at once and leaves them to this loop.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: returns with interrupts off (some handlers come back with them on)
+ */
+void tasklet_run(void) {
+    tasklet_t * t;
+    uint32_t waited;
+
+    cli();
+    if (tasklet_running || tasklet_head == NULL)
+        return;
+    tasklet_running = 1;
+    cpu_this()->preempt_off++;
+
+    while ((t = tasklet_head) != NULL) {
+        tasklet_head = t->next;
+        if (tasklet_head == NULL)
+            tasklet_tail = NULL;
+        t->queued = 0;
+        tasklet_stats.depth--;
+
+        if (clock_has_tsc) {
+            waited = (uint32_t)(rdtsc() - t->queued_at);
+            t->latency += waited;
+            if (waited > t->max_latency)
+                t->max_latency = waited;
+        }
+        t->runs++;
+
+        sti();
+        t->func(t->data);
+        cli();
+
+        /* it detached and came back: the run it belonged to is over, start a new one */
+        if (!tasklet_running) {
+            tasklet_run();
+            return;
+        }
+    }
+
+    cpu_this()->preempt_off--;
+    tasklet_running = 0;
+}
+
+/* tasklet_detach
+ *   DESCRIPTION: ends the current run from inside a tasklet that may not return, such as a
+ *                terminal switch that starts a new shell. The rest of the queue is left for
+ *                the next interrupt; if the tasklet does return, tasklet_run starts over.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: returns with interrupts off, the scheduler may preempt again
+ */
+void tasklet_detach(void) {
+    cli();
+    cpu_this()->preempt_off--;
+    tasklet_running = 0;
+}
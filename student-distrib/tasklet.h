@@ -0,0 +1,55 @@
+#ifndef TASKLET_H_
+#define TASKLET_H_
+
+#include "types.h"
+
+#ifndef ASM
+
+/* A small piece of work an interrupt handler leaves for later. Queued tasklets run
+ * with interrupts on, under the kernel lock, at the end of the interrupt (see HANDLER
+ * in interrupts.S) or before the scheduler picks a process. They must not sleep. */
+typedef struct tasklet {
+	void (*func)(uint32_t data);
+	uint32_t data;
+	const int8_t * name;
+	volatile uint8_t queued;	/* on the queue; scheduling it again does nothing */
+	struct tasklet * next;		/* on the queue */
+	struct tasklet * all;		/* every initialized tasklet, for the statistics */
+	uint64_t queued_at;			/* TSC when it was queued */
+	uint32_t runs;
+	uint32_t max_latency;		/* longest wait on the queue, in cycles */
+	uint64_t latency;			/* sum of the waits */
+} tasklet_t;
+
+/* queue as a whole, since boot */
+typedef struct {
+	uint32_t scheduled;		/* tasklet_schedule calls that queued something */
+	uint32_t coalesced;		/* ... that found the tasklet queued already */
+	uint32_t depth;			/* tasklets on the queue now */
+	uint32_t max_depth;
+} tasklet_stats_t;
+
+/* ======================================================================= */
+
+extern tasklet_stats_t tasklet_stats;
+/* first of the tasklets tasklet_init has seen, linked through all */
+extern tasklet_t * tasklet_list;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* set up a tasklet that calls func(data) */
+void tasklet_init(tasklet_t * t, const int8_t * name, void (*func)(uint32_t), uint32_t data);
+
+/* queue a tasklet unless it is queued already; safe from interrupt handlers */
+void tasklet_schedule(tasklet_t * t);
+
+/* run everything on the queue; returns with interrupts off */
+void tasklet_run(void);
+
+/* called by a running tasklet that may not return (it switches terminals): ends the run
+ * so later interrupts run the queue again; returns with interrupts off */
+void tasklet_detach(void);
+
+#endif /* ASM */
+
+#endif
@@ -5,7 +5,9 @@
 #include "i8259.h"
 #include "paging.h"
 #include "scheduler.h"
-#define LOCATION	 2*NUM_ROWS*NUM_COLS
+#include "scrollback.h"
+#include "vbe.h"
+#include "clock.h"
 
 /* current terminal declaration */
 volatile uint8_t cur_term;
@@ -27,28 +29,34 @@ void init_terminal()
 	for (i = 0; i < MAX_TERM; i++) {
 
 		terminal[i].id = i;
-		terminal[i].pos_x = 0;
-		terminal[i].pos_y = 0;
 		terminal[i].active = 0;
 		terminal[i].apn = -1;
 		terminal[i].key_buffer_idx = 0;
 		terminal[i].eflag = 0;
+		terminal[i].pinned = 0;
+		terminal[i].out_head = terminal[i].out_tail = 0;
+		terminal[i].ld_mode = LD_CANON;
+		terminal[i].ld_vmin = 1;
+		terminal[i].ld_vtime = 0;
+		terminal[i].ld_owner = LD_NO_OWNER;
+		terminal[i].raw_head = terminal[i].raw_tail = 0;
+		terminal[i].read_deadline = 0;
+		init_wait_queue(&terminal[i].read_wq);
 
 		/* fill the buffer up with keyboard */
 		for (j = 0; j < KEY_BUFFER_SIZE; j++)
 			terminal[i].key_buffer[j] = '\0';
 
-		/* set paging and video mapping */
-		table_to_page_mapping(_100MB, _100MB+((i+1)*_4KB), i+1);
-		terminal[i].video_mem = (uint8_t *)_100MB+((i+1)*_4KB);
+		/* each terminal draws into its own video memory, the displayed one is picked by the CRTC */
+		terminal[i].video_mem = (uint8_t *)TERM_VGA(i);
 
-		/*clear memory*/
+		/*clear the other terminals' screens, the first one still shows the boot messages*/
+		if (i == 0)
+			continue;
 		for (j = 0; j < NUM_ROWS*NUM_COLS; j++) {
 			*(uint8_t *)(terminal[i].video_mem + (j << 1)) = ' ';
 
 			/*set color -- change it later*/
-        	if (i == 0)
-        		*(uint8_t *)(terminal[i].video_mem + (j << 1) + 1) = ATTRIB_TERM1;
 	    	if (i == 1)
         		*(uint8_t *)(terminal[i].video_mem + (j << 1) + 1) = ATTRIB_TERM2;
 	   		if (i == 2)
@@ -60,13 +68,15 @@ void init_terminal()
 	key_buffer = terminal[0].key_buffer;
 	save_restore(0,1);
 	cur_term = 0;
+	screen_show();
 	/* always execute shell */
 	execute((uint8_t*)"shell");
 }
 
 /*
 * init_terminal()
-*   DESCRIPTION:  switches into the new terminal, saving and restoring  
+*   DESCRIPTION:  switches into the new terminal by pointing the CRTC at its video
+*                 memory (no screen copy), and swapping the keyboard buffer
 *   INPUT:        uint8_t term_num -- terminal to be switched into 
 *   OUTPUT:       returns 0 on success
 *   RETURN VALUE: none
@@ -85,18 +95,17 @@ int32_t switch_terminal(uint8_t term_num)
 	if (term_num == cur_term) return 0;
 
 	/* Terminal is already active - simply restoring state (keyboard buff, vidmem) */
+	sb_view_reset();
 	if (terminal[term_num].active == 1) {
 		/* only switch if it can be switched */
 		if (switch_helper(cur_term, term_num) == -1) return -1;
 
 		key_buffer = terminal[term_num].key_buffer;
 		cur_term = term_num;
-        /* Remap video memory to 136 MB */
-        uint8_t * scr_str;
-        vidmap(&scr_str);
-        if (terminal[cur_active_terminal].id != cur_term) {
-            vidmem_remap((uint32_t)scr_str, (uint32_t)terminal[cur_active_terminal].video_mem);
-        }
+		terminal_out_flush(term_num);
+		screen_show();
+		cursor_flush();
+		vbe_show();
 
 		return 0;
 	}
@@ -109,6 +118,9 @@ int32_t switch_terminal(uint8_t term_num)
 	pcb_t * old_pcb = get_pcb_ptr_process(terminal[cur_active_terminal].apn);
 	key_buffer = terminal[term_num].key_buffer;
 	save_restore(term_num,1);	
+	screen_show();
+	cursor_flush();
+	vbe_show();
 
     /* Save the ebp/esp of the process we are switching away from. */
     asm volatile("			\n\
@@ -117,6 +129,7 @@ int32_t switch_terminal(uint8_t term_num)
                  "
                  :"=a"(old_pcb->ebp), "=b"(old_pcb->esp)
 	);
+	old_pcb->lock_depth = kernel_lock_depth();
 
 	/*											CRITICAL SECTION END
 	---------------------------------------------------------------------------------------------------------------------------- */
@@ -129,7 +142,8 @@ int32_t switch_terminal(uint8_t term_num)
 
 /*
 * save_restore(uint8_t term_num, uint8_t s_or_r)
-*   DESCRIPTION:  restores or saves the state of a terminal  
+*   DESCRIPTION:  restores or saves the keyboard state of a terminal; the screen stays
+*                 where it is in video memory
 *   INPUT:        uint8_t term_num -- terminal 1 2 or 3 to be saved/restored
 *				  uint8_t s_or_r -- 0 for save, 1 for restore
 *   OUTPUT:       0 on success
@@ -138,17 +152,10 @@ int32_t switch_terminal(uint8_t term_num)
 */
 int32_t save_restore(uint8_t term_num, uint8_t s_or_r) 
 {
-	if (s_or_r == 0) {
-	terminal[term_num].pos_x = get_screen_x();
-	terminal[term_num].pos_y = get_screen_y();
-	terminal[term_num].key_buffer_idx = key_buffer_idx;
-	memcpy((uint8_t *)terminal[term_num].video_mem, (uint8_t *)VIDEO, LOCATION);
-	}
-	else {
-	key_buffer_idx = terminal[term_num].key_buffer_idx;
-	set_screen_pos(terminal[term_num].pos_x, terminal[term_num].pos_y);
-	memcpy((uint8_t *)VIDEO, (uint8_t *)terminal[term_num].video_mem, LOCATION);
-	}
+	if (s_or_r == 0)
+		terminal[term_num].key_buffer_idx = key_buffer_idx;
+	else
+		key_buffer_idx = terminal[term_num].key_buffer_idx;
 	return 0;
 }
 
@@ -170,63 +177,247 @@ int32_t switch_helper(uint8_t old, uint8_t new)
 	return 0;
 }
 
+/*
+ * raw_wait()
+ * DESCRIPTION: sleeps until a raw mode read can return, the way VMIN and VTIME say: with
+ *              VTIME 0 until need keys are in; with VMIN 0 until a key comes or VTIME runs
+ *              out; with both set VTIME is the gap allowed between keys once the first
+ *              one is in. Interrupts must be off.
+ * INPUTS: -- term_t* term: reader's terminal
+ *         -- uint32_t need: keys that satisfy the read
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: sets read_deadline while a timeout is running
+ */
+static void raw_wait(term_t * term, uint32_t need)
+{
+	uint64_t timeout = (uint64_t)term->ld_vtime * NS_PER_DECISEC;
+	uint32_t seen = 0;
+	uint32_t avail;
+
+	term->read_deadline = term->ld_vmin ? 0 : clock_ns() + timeout;
+	while ((avail = term->raw_head - term->raw_tail) < need) {
+		if (term->ld_vtime) {
+			/* every key restarts the gap timer */
+			if (avail != seen) {
+				seen = avail;
+				term->read_deadline = clock_ns() + timeout;
+			}
+			if (term->read_deadline && clock_ns() >= term->read_deadline)
+				break;
+			/* make sure a timer interrupt comes to end the wait */
+			tick_next();
+		}
+		sleep_on(&term->read_wq);
+	}
+	term->read_deadline = 0;
+}
+
 /*
  * terminal_read()
- * DESCRIPTION: Reads from the keyoard input buffer and copies to buffer in userspace
+ * DESCRIPTION: Reads keyboard input through the terminal's line discipline. In canonical
+ *              mode it waits for Enter and copies the line, newline included. In raw mode
+ *              it copies the keys typed so far, waiting first as VMIN/VTIME say (see
+ *              raw_wait). A non-blocking fd (FIONBIO) never waits in raw mode, and
+ *              returns 0 in canonical mode while no line is complete.
  * INPUTS: -- int32_t fd: file directory
  * 		   -- char *buffer: userspace buffer will hold input buffer data
  *         -- uint32_t num_bytes: maximum number of bytes to copy between buffers
  * OUTPUTS: none
  * RETURN VALUE: number of bytes copied between buffers
- * SIDE EFFECTS: fills user buffer with terminal's input buffer data
+ * SIDE EFFECTS: consumes the copied input
  */
 int32_t terminal_read(int32_t fd, void* buf, int32_t num_bytes) 
 {
-	uint8_t i;
+	pcb_t * pcb = get_pcb_ptr();
+	term_t * term = pcb->term;
+	uint8_t nonblock = pcb->fds[fd].nonblock;
+	int8_t * buffer = (int8_t *)buf;
+	uint32_t need, flags;
+	int32_t i;
+
+	if (num_bytes <= 0)
+		return 0;
+
+	if (term->ld_mode == LD_RAW) {
+		cli_and_save(flags);
+		need = term->ld_vmin;
+		if (need > (uint32_t)num_bytes)
+			need = num_bytes;
+		if (!nonblock && (need || term->ld_vtime))
+			raw_wait(term, need ? need : 1);
+		for (i = 0; i < num_bytes && term->raw_tail != term->raw_head; i++)
+			buffer[i] = term->raw_buf[term->raw_tail++ & TERM_RAW_MASK];
+		restore_flags(flags);
+		return i;
+	}
+
+	if (nonblock && term->eflag == 0)
+		return 0;
+
+	/* sleep until the keyboard handler sees enter on our terminal */
+	wait_event(&term->read_wq, term->eflag != 0);
 	/* set flag equal to zero */
-	while (get_pcb_ptr()->term->eflag == 0);
-	get_pcb_ptr()->term->eflag = 0;
+	term->eflag = 0;
 	
-	/* fill the buffer */
-	int8_t * buffer = (int8_t *)buf;
-	/* load into buffer */
-	for (i = 0; (i < num_bytes-1) && (i < KEY_BUFFER_SIZE); i++) {
-		buffer[i] = key_buffer[i];
+	/* copy the line up to and including its newline, from our terminal's buffer: the
+	 * global key_buffer follows whichever terminal is displayed */
+	cli_and_save(flags);
+	for (i = 0; (i < num_bytes) && (i <= KEY_BUFFER_SIZE); i++) {
+		buffer[i] = term->key_buffer[i];
+		if (term->key_buffer[i] == '\n') {
+			i++;
+			break;
+		}
 	}
 	
-	clear_buf();
+	if (term->id == cur_term) {
+		clear_buf();
+	} else {
+		memset((void*)term->key_buffer, '\0', KEY_BUFFER_SIZE);
+		term->key_buffer_idx = 0;
+	}
+	restore_flags(flags);
 	return i;
 }
 
 /*
  * terminal_write()
- * DESCRIPTION: writes string (buf of chars) to screen until a null character
-                or the number of chars to write is reached
- * INPUTS: -- uint8_t* buffer: holding the string to write to screen
- *         -- uint32_t num_bytes: maximum number of characters to write
+ * DESCRIPTION: writes num_bytes raw bytes of buf to the caller's terminal, shown or not
+ * INPUTS: -- uint8_t* buffer: holding the bytes to write to screen
+ *         -- uint32_t num_bytes: number of bytes to write
  * OUTPUTS: outputs to video memory
- * RETURN VALUE: number of characters wrote to video mem/screen (max at num_chars)
- * SIDE EFFECTS: writes to video memory/terminal screen
+ * RETURN VALUE: number of bytes written, -1 on a bad buffer
+ * SIDE EFFECTS: see terminal_out_write
  */
 int32_t terminal_write(int32_t fd, const void* buf, int32_t num_bytes) 
 {
-	int32_t idx;
+	/* terminal_out_write memcpy's straight out of buf */
+	if (buf == NULL || num_bytes < 0 || bad_userspace_addr(buf, num_bytes))
+		return -1;
 
-	cli();
-	/* ============= START critical section to write buffer ============= */
+	return terminal_out_write(get_pcb_ptr()->term, (const uint8_t *)buf, num_bytes);
+}
 
-	if (cur_term == cur_active_terminal) {
-		idx = printf((int8_t *)buf);
+/*
+ * out_render()
+ * DESCRIPTION: draws up to max bytes of a terminal's pending output into its video memory.
+ *              Called with interrupts off; the writer of the ring only ever adds to out_head.
+ * INPUTS: -- term: terminal to draw
+ *         -- max: most bytes to draw
+ * OUTPUTS: outputs to video memory
+ * RETURN VALUE: none
+ * SIDE EFFECTS: advances out_tail
+ */
+static void out_render(term_t * term, uint32_t max)
+{
+	uint32_t tail = term->out_tail;
+	uint32_t len = term->out_head - tail;
+	uint32_t seg;
+
+	if (len > max)
+		len = max;
+	while (len > 0) {
+		/* the part up to the end of the ring */
+		seg = TERM_OUT_SIZE - (tail & TERM_OUT_MASK);
+		if (seg > len)
+			seg = len;
+		term_write(term->id, &term->out_buf[tail & TERM_OUT_MASK], seg);
+		tail += seg;
+		len -= seg;
 	}
-	else {
-		idx = printf_terminal_active((int8_t *)buf);
+	term->out_tail = tail;
+}
 
+/*
+ * terminal_out_write()
+ * DESCRIPTION: queues output for a terminal. The bytes are copied into the terminal's ring
+ *              with interrupts on. The displayed terminal is then drawn TERM_OUT_BATCH bytes
+ *              at a time, with interrupts let in between batches; a hidden terminal keeps
+ *              its output queued until it is shown, and only draws into its video memory
+ *              when the ring is full.
+ * INPUTS: -- term: terminal to write to
+ *         -- buf: raw bytes, checked by the caller if they come from user space
+ *         -- nbytes: number of bytes in buf
+ * OUTPUTS: outputs to video memory
+ * RETURN VALUE: nbytes
+ * SIDE EFFECTS: none
+ */
+int32_t terminal_out_write(term_t * term, const uint8_t* buf, int32_t nbytes)
+{
+	int32_t done = 0;
+	uint32_t head, room, seg, flags;
+
+	while (done < nbytes) {
+		/* append what fits */
+		head = term->out_head;
+		room = TERM_OUT_SIZE - (head - term->out_tail);
+		if (room > (uint32_t)(nbytes - done))
+			room = nbytes - done;
+		while (room > 0) {
+			seg = TERM_OUT_SIZE - (head & TERM_OUT_MASK);
+			if (seg > room)
+				seg = room;
+			memcpy(&term->out_buf[head & TERM_OUT_MASK], buf + done, seg);
+			head += seg;
+			done += seg;
+			room -= seg;
+		}
+		/* publish the bytes only once they are in the ring */
+		term->out_head = head;
+
+		if (term->id == cur_term) {
+			while (term->out_head != term->out_tail) {
+				cli_and_save(flags);
+				out_render(term, TERM_OUT_BATCH);
+				restore_flags(flags);
+			}
+		} else if (done < nbytes) {
+			/* hidden and full: draw the oldest batch to make room */
+			cli_and_save(flags);
+			out_render(term, TERM_OUT_BATCH);
+			restore_flags(flags);
+		}
 	}
 
-	/* ============== END critical section to write buffer ============== */
-	sti();
+	cli_and_save(flags);
+	cursor_flush();
+	restore_flags(flags);
+	return nbytes;
+}
+
+/*
+ * terminal_out_flush()
+ * DESCRIPTION: draws all of a terminal's pending output, before the terminal is shown or
+ *              anything else is drawn on it
+ * INPUTS: -- term_id: terminal to draw
+ * OUTPUTS: outputs to video memory
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void terminal_out_flush(uint8_t term_id)
+{
+	uint32_t flags;
+
+	if (terminal[term_id].out_head == terminal[term_id].out_tail)
+		return;
+	cli_and_save(flags);
+	out_render(&terminal[term_id], TERM_OUT_SIZE);
+	restore_flags(flags);
+}
 
-	return idx;
+/*
+ * terminal_out_tick()
+ * DESCRIPTION: timer tick: draws a batch of the displayed terminal's output, for a writer
+ *              that was preempted between batches
+ * INPUTS: none
+ * OUTPUTS: outputs to video memory
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void terminal_out_tick(void)
+{
+	out_render(&terminal[cur_term], TERM_OUT_BATCH);
 }
 
 /*
@@ -257,4 +448,154 @@ int32_t terminal_close(int32_t fd)
 	return 0;
 }
 
+/*
+ * vga_stats()
+ * DESCRIPTION: system call that reports the terminal output counters
+ * INPUTS: -- buf: user buffer for a vga_stats_t
+ *         -- nbytes: size of buf
+ * OUTPUTS: none
+ * RETURN VALUE: number of bytes copied, -1 on a bad buffer
+ * SIDE EFFECTS: none
+ */
+int32_t vga_stats(void* buf, int32_t nbytes)
+{
+	/* check exactly the bytes the copy writes */
+	if (nbytes < (int32_t)sizeof(vga_stats_t) || bad_userspace_addr(buf, sizeof(vga_stats_t)))
+		return -1;
+
+	memcpy(buf, &vga_counters, sizeof(vga_stats_t));
+	return sizeof(vga_stats_t);
+}
+
+/*
+ * terminal_raw_key()
+ * DESCRIPTION: keyboard handler side of raw mode: queues a key for the displayed terminal
+ *              and wakes its reader. Keys are dropped while the queue is full.
+ * INPUTS: -- uint8_t key: key as translated by the keyboard handler
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: wakes read_wq
+ */
+void terminal_raw_key(uint8_t key)
+{
+	term_t * term = &terminal[cur_term];
+
+	if (term->raw_head - term->raw_tail >= TERM_RAW_SIZE)
+		return;
+	term->raw_buf[term->raw_head & TERM_RAW_MASK] = key;
+	term->raw_head++;
+	wake_up(&term->read_wq);
+}
+
+/*
+ * terminal_ioctl()
+ * DESCRIPTION: changes a terminal's line discipline (see the TC_ commands in terminal.h).
+ *              Going raw discards a half typed line; going back to canonical discards
+ *              raw keys nobody read.
+ * INPUTS: -- term_t* term: terminal to change
+ *         -- int32_t cmd: TC_SETMODE, TC_SETVMIN or TC_SETVTIME
+ *         -- int32_t arg: new value
+ * OUTPUTS: none
+ * RETURN VALUE: 0 on success, -1 on a bad command or value
+ * SIDE EFFECTS: the calling process becomes ld_owner, readers are woken to re-check
+ */
+int32_t terminal_ioctl(term_t * term, int32_t cmd, int32_t arg)
+{
+	uint32_t flags;
+
+	if (arg < 0 || arg > LD_MAX_PARAM)
+		return -1;
+
+	cli_and_save(flags);
+	switch (cmd) {
+		case TC_SETMODE:
+			if (arg != LD_CANON && arg != LD_RAW) {
+				restore_flags(flags);
+				return -1;
+			}
+			if (arg != term->ld_mode) {
+				if (term->id == cur_term)
+					clear_buf();
+				else
+					term->key_buffer_idx = 0;
+				term->eflag = 0;
+				term->raw_tail = term->raw_head;
+			}
+			term->ld_mode = arg;
+			break;
+		case TC_SETVMIN:
+			term->ld_vmin = arg;
+			break;
+		case TC_SETVTIME:
+			term->ld_vtime = arg;
+			break;
+		default:
+			restore_flags(flags);
+			return -1;
+	}
+	term->ld_owner = get_pcb_ptr()->process_number;
+	wake_up(&term->read_wq);
+	restore_flags(flags);
+	return 0;
+}
+
+/*
+ * terminal_ld_release()
+ * DESCRIPTION: a halting process that changed its terminal's line discipline leaves it
+ *              canonical again, so the shell it returns to can read lines
+ * INPUTS: -- uint8_t process: process number halting
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void terminal_ld_release(uint8_t process)
+{
+	term_t * term = get_pcb_ptr_process(process)->term;
+
+	if (term == NULL || term->ld_owner != process)
+		return;
+	term->ld_mode = LD_CANON;
+	term->ld_vmin = 1;
+	term->ld_vtime = 0;
+	term->ld_owner = LD_NO_OWNER;
+	term->raw_tail = term->raw_head;
+}
+
+/*
+ * terminal_read_deadline()
+ * DESCRIPTION: earliest time a VTIME read has to be woken at, for tick_next
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: clock_ns() deadline, 0 when no read is timing out
+ * SIDE EFFECTS: none
+ */
+uint64_t terminal_read_deadline(void)
+{
+	uint64_t earliest = 0;
+	uint8_t i;
+
+	for (i = 0; i < MAX_TERM; i++) {
+		if (terminal[i].read_deadline && (!earliest || terminal[i].read_deadline < earliest))
+			earliest = terminal[i].read_deadline;
+	}
+	return earliest;
+}
 
+/*
+ * terminal_read_tick()
+ * DESCRIPTION: timer interrupt side of VTIME: wakes readers whose timeout passed
+ * INPUTS: none
+ * OUTPUTS: none
+ * RETURN VALUE: none
+ * SIDE EFFECTS: none
+ */
+void terminal_read_tick(void)
+{
+	uint64_t now = clock_ns();
+	uint8_t i;
+
+	for (i = 0; i < MAX_TERM; i++) {
+		if (terminal[i].read_deadline && now >= terminal[i].read_deadline)
+			wake_up(&terminal[i].read_wq);
+	}
+}
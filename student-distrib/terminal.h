@@ -3,18 +3,33 @@
 
 #include "types.h"
 #include "keyboard.h"
+#include "waitqueue.h"
 
 #define MAX_TERM  3
+#define TERM_OUT_SIZE   4096    /* bytes of output waiting to be drawn, power of two */
+#define TERM_OUT_MASK   (TERM_OUT_SIZE - 1)
+#define TERM_OUT_BATCH  512     /* bytes drawn per interrupts-off stretch */
+#define TERM_RAW_SIZE   64      /* keys waiting for a raw mode read, power of two */
+#define TERM_RAW_MASK   (TERM_RAW_SIZE - 1)
+#define NS_PER_DECISEC  100000000
+
+/* line discipline modes */
+#define LD_CANON        0       /* whole lines, echoed and editable with backspace (default) */
+#define LD_RAW          1       /* every key as it is typed, no echo or editing */
+#define LD_NO_OWNER     -1
+
+/* ioctl commands */
+#define TC_SETMODE      1       /* arg: LD_CANON or LD_RAW */
+#define TC_SETVMIN      2       /* arg: keys a raw read waits for, 0 to 255 */
+#define TC_SETVTIME     3       /* arg: tenths of a second a raw read waits, 0 to 255 */
+#define FIONBIO         4       /* arg: nonzero to make reads on the fd return at once */
+#define LD_MAX_PARAM    255
 
 /**TERMINAL STRUCT **/
 typedef struct {
     /*which terminal we are on*/
     uint8_t id;
 
-    /*current cursor pos*/
-    uint32_t pos_x;
-    uint32_t pos_y;
-
 	/*does our terminal have an active process?*/
     uint8_t active;
 
@@ -28,8 +43,33 @@ typedef struct {
     /*flag*/
     volatile uint8_t eflag;
 
-    //ptr to video memory for terminal
+    /*processes sleeping in terminal_read until eflag is set or a raw key arrives*/
+    wait_queue_t read_wq;
+
+    /*line discipline, see terminal_ioctl; ld_owner gets canonical mode back when it halts*/
+    uint8_t ld_mode;
+    uint8_t ld_vmin;
+    uint8_t ld_vtime;
+    int8_t ld_owner;
+
+    /*raw mode keys; raw_head/raw_tail are free running counts*/
+    volatile uint8_t raw_buf[TERM_RAW_SIZE];
+    volatile uint32_t raw_head;
+    volatile uint32_t raw_tail;
+
+    /*clock_ns() at which a VTIME read gives up, 0 when nobody is timing out*/
+    volatile uint64_t read_deadline;
+
+    //ptr to the terminal's own part of video memory (TERM_VGA), drawn into even while hidden
     uint8_t *video_mem;
+
+    /*processes drawing through vidmap, the screen must stay at the start of video memory*/
+    uint8_t pinned;
+
+    /*written but not yet drawn output; out_head/out_tail are free running byte counts*/
+    uint8_t out_buf[TERM_OUT_SIZE];
+    volatile uint32_t out_head;
+    volatile uint32_t out_tail;
 } term_t;
 
 /* variables */
@@ -45,5 +85,14 @@ int32_t terminal_open(const uint8_t* filename);
 int32_t terminal_close(int32_t fd);
 int32_t terminal_read(int32_t fd, void* buf, int32_t nbytes);
 int32_t terminal_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t terminal_out_write(term_t * term, const uint8_t* buf, int32_t nbytes);
+void terminal_out_flush(uint8_t term_id);
+void terminal_out_tick(void);
+int32_t vga_stats(void* buf, int32_t nbytes);
+void terminal_raw_key(uint8_t key);
+int32_t terminal_ioctl(term_t * term, int32_t cmd, int32_t arg);
+void terminal_ld_release(uint8_t process);
+uint64_t terminal_read_deadline(void);
+void terminal_read_tick(void);
 
 #endif /* _TERMINAL_H */
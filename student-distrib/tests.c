@@ -10,6 +10,19 @@
 #include "filesys.h"
 #include "terminal.h"
 #include "syscalls.h"
+#include "scheduler.h"
+#include "clock.h"
+#include "smp.h"
+#include "fpu.h"
+#include "trace.h"
+#include "acct.h"
+#include "scrollback.h"
+#include "vbe.h"
+#include "serial.h"
+#include "ioapic.h"
+#include "apic.h"
+#include "irqstat.h"
+#include "tasklet.h"
 
 #define PASS 1
 #define FAIL 0
@@ -848,6 +861,1219 @@ int execute_test()  {
 /* =======================================================================================END== */
 
 
+/* ==================================== SCHEDULER TESTS ==============================START== */
+/*
+ *	 sched_priority_test()
+ *   DESCRIPTION: checks the bounds of the MLFQ system calls and that a slice always
+ *                fits the level it was handed out for
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: set_priority, sched_stats, SCHED_QUANTUM
+ *   FILES: scheduler.c/h
+ */
+int sched_priority_test() {
+	TEST_HEADER;
+
+	sched_level_stats_t stats[SCHED_LEVELS];
+	int i;
+
+	/* levels outside 0 ~ SCHED_LEVELS-1 are rejected */
+	if (set_priority(-1) != -1 || set_priority(SCHED_LEVELS) != -1)
+		return FAIL;
+
+	/* stats can only be copied into user space, and only whole */
+	if (sched_stats(stats, sizeof(stats)) != -1)
+		return FAIL;
+	if (sched_stats((void*)_128MB, sizeof(sched_level_stats_t)) != -1)
+		return FAIL;
+
+	/* lower levels get longer slices */
+	for (i = 1; i < SCHED_LEVELS; i++) {
+		if (SCHED_QUANTUM(i) <= SCHED_QUANTUM(i - 1))
+			return FAIL;
+	}
+
+	return PASS;
+}
+
+/*
+ *	 sched_pick_test()
+ *   DESCRIPTION: puts fake processes at different MLFQ levels on all three terminals and
+ *                checks which one the scheduler picks: a better level beats the current
+ *                terminal, the current one keeps the CPU against worse or sleeping ones,
+ *                and equal levels take turns. The processes borrow free PCB slots and the
+ *                terminals' active/apn, which are kept locally and put back afterwards.
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none (interrupts are off while the fake processes exist)
+ *   COVERAGE: get_next_scheduled, pick_terminal, best_terminal, runnable
+ *   FILES: scheduler.c/h
+ */
+int sched_pick_test() {
+	TEST_HEADER;
+
+	cpu_t * cpu = cpu_this();
+	pcb_t saved_pcb[MAX_TERMINALS];
+	uint8_t saved_active[MAX_TERMINALS];
+	int8_t saved_apn[MAX_TERMINALS];
+	uint8_t saved_term_cpu[MAX_TERMINALS];
+	uint8_t saved_cur, saved_next, saved_idle;
+	int32_t slot[MAX_TERMINALS];
+	pcb_t * pcb[MAX_TERMINALS];
+	uint32_t flags;
+	int32_t s = NUM_MAX_PROCESSES - 1;
+	int i;
+	int result = PASS;
+
+	for (i = 0; i < MAX_TERMINALS; i++) {
+		for (; s >= 0 && pid_array[s] != FREE; s--);
+		if (s < 0)
+			return result;
+		slot[i] = s--;
+	}
+
+	cli_and_save(flags);
+	saved_cur = cpu->cur_term;
+	saved_next = cpu->next_term;
+	saved_idle = cpu->idle;
+	for (i = 0; i < MAX_TERMINALS; i++) {
+		pcb[i] = get_pcb_ptr_process(slot[i]);
+		memcpy(&saved_pcb[i], pcb[i], sizeof(pcb_t));
+		saved_active[i] = terminal[i].active;
+		saved_apn[i] = terminal[i].apn;
+		saved_term_cpu[i] = term_cpu[i];
+
+		sched_init_process(pcb[i], SCHED_TOP_LEVEL);
+		terminal[i].active = TERMINAL_ACTIVE;
+		terminal[i].apn = slot[i];
+		term_cpu[i] = cpu->id;
+	}
+	cpu->cur_term = 0;
+	cpu->idle = 0;
+
+	/* terminal 2 sits at a better level than the current terminal 0 */
+	pcb[0]->sched_level = 1;
+	pcb[1]->sched_level = 2;
+	pcb[2]->sched_level = 0;
+	if (get_next_scheduled() != slot[2] || cpu->next_term != 2)
+		result = FAIL;
+
+	/* asleep it doesn't count, and the worse terminal 1 can't take the CPU away */
+	pcb[2]->state = PROC_BLOCKED;
+	if (get_next_scheduled() != slot[0] || cpu->next_term != 0)
+		result = FAIL;
+
+	/* at the same level the next terminal gets its turn */
+	pcb[1]->sched_level = 1;
+	if (get_next_scheduled() != slot[1] || cpu->next_term != 1)
+		result = FAIL;
+
+	for (i = 0; i < MAX_TERMINALS; i++) {
+		memcpy(pcb[i], &saved_pcb[i], sizeof(pcb_t));
+		terminal[i].active = saved_active[i];
+		terminal[i].apn = saved_apn[i];
+		term_cpu[i] = saved_term_cpu[i];
+	}
+	cpu->cur_term = saved_cur;
+	cpu->next_term = saved_next;
+	cpu->idle = saved_idle;
+	restore_flags(flags);
+
+	return result;
+}
+
+/*
+ *	 wait_queue_test()
+ *   DESCRIPTION: wakes a fake sleeper and makes sure it became runnable and left the queue.
+ *                The sleeper borrows a free PCB slot: its contents are kept in a local
+ *                pcb_t and put back afterwards, and it has no terminal to kick.
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: init_wait_queue, wake_up, sched_wakeup
+ *   FILES: waitqueue.c/h, scheduler.c
+ */
+int wait_queue_test() {
+	TEST_HEADER;
+
+	wait_queue_t wq;
+	pcb_t saved;
+	pcb_t * pcb;
+	int32_t slot;
+	int result = PASS;
+
+	init_wait_queue(&wq);
+	if (wq.waiters != 0)
+		return FAIL;
+
+	/* waking an empty queue is harmless */
+	wake_up(&wq);
+
+	for (slot = NUM_MAX_PROCESSES - 1; slot >= 0 && pid_array[slot] != FREE; slot--);
+	if (slot < 0)
+		return result;
+	pcb = get_pcb_ptr_process(slot);
+	memcpy(&saved, pcb, sizeof(pcb_t));
+
+	pcb->term = NULL;
+	pcb->state = PROC_BLOCKED;
+	wq.waiters = (1 << slot);
+	wake_up(&wq);
+	if (pcb->state != PROC_RUNNABLE || wq.waiters != 0)
+		result = FAIL;
+
+	memcpy(pcb, &saved, sizeof(pcb_t));
+	return result;
+}
+
+/*
+ *	 tick_stats_test()
+ *   DESCRIPTION: checks the tick_stats buffer checks and that a one-shot always fits the
+ *                16 bit PIT counter
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: tick_stats, TICKS_PER_ONESHOT
+ *   FILES: scheduler.c/h
+ */
+int tick_stats_test() {
+	TEST_HEADER;
+
+	tick_stats_t stats;
+
+	if (tick_stats(&stats, sizeof(stats)) != -1)
+		return FAIL;
+	if (tick_stats((void*)_128MB, sizeof(tick_stats_t) - 1) != -1)
+		return FAIL;
+
+	if (TICKS_PER_ONESHOT < 1 || TICKS_PER_ONESHOT * TICK_COUNT > PIT_MAX_COUNT)
+		return FAIL;
+
+	return PASS;
+}
+
+/*
+ *	 tick_oneshot_test()
+ *   DESCRIPTION: runs the tick path on two fake processes. Terminal 0's process has
+ *                TICKS_PER_ONESHOT ticks (the longest the PIT can wait) of its slice left and
+ *                terminal 1's sits at a worse level, so tick_next must arm a single one-shot
+ *                that far out. Firing the timer hook then has to account all of them to one
+ *                interrupt, drop the process a level without switching
+ *                away, and arm the next one-shot for the new level's slice. The processes
+ *                borrow free PCB slots like sched_pick_test; everything they touch is put
+ *                back and the timer re-armed for the real processes.
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: the fake ticks stay in tickless_stats (the clock without a TSC) and
+ *                 in the boost countdown; the hook turns interrupts on for a moment
+ *   COVERAGE: tick_next, tick_program, PIT_scheduling / APIC_scheduling, sched_tick
+ *   FILES: scheduler.c/h
+ */
+int tick_oneshot_test() {
+	TEST_HEADER;
+
+#if TICKLESS
+	cpu_t * cpu = cpu_this();
+	pcb_t saved_pcb[2];
+	sched_level_stats_t saved_levels[SCHED_LEVELS];
+	uint8_t saved_active[MAX_TERMINALS];
+	int8_t saved_apn[MAX_TERMINALS];
+	uint8_t saved_term_cpu[MAX_TERMINALS];
+	uint8_t saved_cur, saved_next, saved_idle;
+	uint32_t saved_armed_ticks;
+	uint32_t taken, elapsed;
+	int32_t slot[2];
+	pcb_t * pcb[2];
+	uint32_t flags;
+	int32_t s = NUM_MAX_PROCESSES - 1;
+	int i;
+	int result = PASS;
+
+	for (i = 0; i < 2; i++) {
+		for (; s >= 0 && pid_array[s] != FREE; s--);
+		if (s < 0)
+			return result;
+		slot[i] = s--;
+	}
+
+	cli_and_save(flags);
+	saved_cur = cpu->cur_term;
+	saved_next = cpu->next_term;
+	saved_idle = cpu->idle;
+	saved_armed_ticks = cpu->armed_ticks;
+	memcpy(saved_levels, sched_level_stats, sizeof(sched_level_stats));
+	for (i = 0; i < MAX_TERMINALS; i++) {
+		saved_active[i] = terminal[i].active;
+		saved_apn[i] = terminal[i].apn;
+		saved_term_cpu[i] = term_cpu[i];
+		terminal[i].active = 0;
+	}
+	for (i = 0; i < 2; i++) {
+		pcb[i] = get_pcb_ptr_process(slot[i]);
+		memcpy(&saved_pcb[i], pcb[i], sizeof(pcb_t));
+		terminal[i].active = TERMINAL_ACTIVE;
+		terminal[i].apn = slot[i];
+		term_cpu[i] = cpu->id;
+	}
+	cpu->cur_term = 0;
+	cpu->idle = 0;
+	cpu->tick_armed = 0;
+
+	sched_init_process(pcb[0], SCHED_TOP_LEVEL);
+	pcb[0]->sched_ticks = TICKS_PER_ONESHOT;
+	sched_init_process(pcb[1], SCHED_LEVELS - 1);
+
+	/* one deadline for the rest of the slice, not a tick at a time */
+	tick_next();
+	if (!cpu->tick_armed || cpu->armed_ticks != TICKS_PER_ONESHOT)
+		result = FAIL;
+
+	/* the one-shot fires: all those ticks went by for a single interrupt */
+	taken = tickless_stats.taken;
+	elapsed = tickless_stats.elapsed;
+	if (apic_timer_ready)
+		APIC_scheduling();
+	else
+		PIT_scheduling();
+	cli();
+	if (tickless_stats.taken - taken != 1 || tickless_stats.elapsed - elapsed != TICKS_PER_ONESHOT)
+		result = FAIL;
+
+	/* the slice ran out: one level down, still on terminal 0, next deadline a full slice away */
+	if (pcb[0]->sched_level != SCHED_TOP_LEVEL + 1 || cpu->cur_term != 0)
+		result = FAIL;
+	if (!cpu->tick_armed || cpu->armed_ticks != SCHED_QUANTUM(SCHED_TOP_LEVEL + 1))
+		result = FAIL;
+
+	for (i = 0; i < 2; i++)
+		memcpy(pcb[i], &saved_pcb[i], sizeof(pcb_t));
+	for (i = 0; i < MAX_TERMINALS; i++) {
+		terminal[i].active = saved_active[i];
+		terminal[i].apn = saved_apn[i];
+		term_cpu[i] = saved_term_cpu[i];
+	}
+	memcpy(sched_level_stats, saved_levels, sizeof(sched_level_stats));
+	cpu->cur_term = saved_cur;
+	cpu->next_term = saved_next;
+	cpu->idle = saved_idle;
+	cpu->armed_ticks = saved_armed_ticks;
+	/* the fake deadline is still programmed: replace it with the real one */
+	cpu->tick_armed = 0;
+	tick_next();
+	restore_flags(flags);
+
+	return result;
+#else
+	return PASS;
+#endif
+}
+
+/*
+ *	 clock_test()
+ *   DESCRIPTION: checks the 64 bit division helper, that the clock never runs backwards
+ *                and the gettime buffer checks
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: div64_32, clock_ns, gettime
+ *   FILES: clock.c/h
+ */
+int clock_test() {
+	TEST_HEADER;
+
+	uint64_t n = ((uint64_t)3 << 32) | 7;	/* 3 * 2^32 + 7 */
+	uint64_t t0, t1;
+	timespec_t ts;
+
+	/* (3 * 2^32 + 7) / 10: the high half leaves a remainder that carries into the low half */
+	if (div64_32(&n, 10) != 5 || n != 1288490189ULL)
+		return FAIL;
+
+	t0 = clock_ns();
+	t1 = clock_ns();
+	if (t1 < t0)
+		return FAIL;
+
+	if (gettime(&ts, sizeof(ts)) != -1)
+		return FAIL;
+
+	return PASS;
+}
+
+/*
+ *	 smp_test()
+ *   DESCRIPTION: the tests run on the boot processor; checks the per-CPU lookup and that the
+ *                big kernel lock nests
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: cpu_this, kernel_lock, kernel_unlock
+ *   FILES: smp.c/h
+ */
+int smp_test() {
+	TEST_HEADER;
+
+	uint32_t depth = kernel_lock_depth();
+
+	if (smp_ncpus < 1 || smp_ncpus > MAX_CPUS)
+		return FAIL;
+	if (cpu_this() != &cpus[0] || cpus[0].id != 0)
+		return FAIL;
+
+	kernel_lock();
+	if (smp_ncpus > 1 && kernel_lock_depth() != depth + 1)
+		return FAIL;
+	kernel_unlock();
+	if (kernel_lock_depth() != depth)
+		return FAIL;
+
+	return PASS;
+}
+
+/*
+ *	 fpu_test()
+ *   DESCRIPTION: checks CR0 after fpu_init and that fpu_switch only arms the #NM trap for
+ *                processes whose state is not in the registers
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: leaves CR0.TS set, as after boot
+ *   COVERAGE: fpu_init, fpu_switch, fpu_release
+ *   FILES: fpu.c/h
+ */
+int fpu_test() {
+	TEST_HEADER;
+
+	cpu_t * cpu = cpu_this();
+	uint8_t owner = cpu->fpu_owner;
+	uint32_t cr0;
+	int result = PASS;
+
+	asm volatile("movl %%cr0, %0" : "=r"(cr0));
+	if ((cr0 & CR0_EM) || !(cr0 & CR0_MP))
+		return FAIL;
+
+	/* nobody owns the FPU: switching to process 0 must arm the trap */
+	cpu->fpu_owner = FPU_NO_OWNER;
+	fpu_switch(0);
+	asm volatile("movl %%cr0, %0" : "=r"(cr0));
+	if (!(cr0 & CR0_TS))
+		result = FAIL;
+
+	/* process 0 owns it: no trap needed */
+	cpu->fpu_owner = 0;
+	fpu_switch(0);
+	asm volatile("movl %%cr0, %0" : "=r"(cr0));
+	if (cr0 & CR0_TS)
+		result = FAIL;
+
+	fpu_release(0);
+	if (cpu->fpu_owner != FPU_NO_OWNER)
+		result = FAIL;
+
+	cpu->fpu_owner = owner;
+	stts();
+	return result;
+}
+
+#define TRACE_EXPECT_SIZE	32		/* fits "  process <pid>," */
+
+/*
+ *	 trace_test()
+ *   DESCRIPTION: traces a wakeup and the run that follows it and checks that the latency
+ *                shows up in the rendered histograms
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: leaves two records in the trace ring
+ *   COVERAGE: trace_event, trace_format
+ *   FILES: trace.c/h
+ */
+int trace_test() {
+	TEST_HEADER;
+
+	static int8_t text[TRACE_TEXT_SIZE];
+	int8_t expect[TRACE_EXPECT_SIZE];
+	int32_t len, expect_len;
+	int32_t pid = NUM_MAX_PROCESSES - 1;
+
+	trace_event(TRACE_WAKEUP, pid, 0);
+	trace_event(TRACE_RUN, pid, 0);
+
+	len = trace_format(text, TRACE_TEXT_SIZE - 1);
+	if (len <= 0 || len >= TRACE_TEXT_SIZE)
+		return FAIL;
+	text[len] = '\0';
+
+	if (!clock_has_tsc)
+		return (strncmp(text, (int8_t*)"no TSC", 6) == 0) ? PASS : FAIL;
+
+	/* "  process <pid>, n wakeups" must be in there */
+	expect_len = snprintf(expect, TRACE_EXPECT_SIZE, (int8_t*)"  process %d,", pid);
+	while (len-- > 0) {
+		if (strncmp(&text[len], expect, expect_len) == 0)
+			return PASS;
+	}
+	return FAIL;
+}
+
+#define REMAP_BENCH_ROUNDS	1000
+#define MEM_BENCH_SIZE		16384
+#define MEM_BENCH_BYTES		(1 << 20)		/* copied per size and case */
+#define MEM_BENCH_CASES		4
+#define MEM_BENCH_FAIL		0xFFFFFFFF
+
+/*
+ *	 remap_bench_test()
+ *   DESCRIPTION: benchmarks the page table work of a context switch. "before" repeats what
+ *                process_contextswitch used to do (rewrite the 128MB and 136MB entries and
+ *                reload CR3 after each), "same" switches back to the process whose pages
+ *                are mapped and "other" alternates between two processes
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL, prints TSC cycles per switch
+ *   SIDE EFFECTS: restores the 128MB / 136MB mappings it found
+ *   COVERAGE: page_remap, table_remap
+ *   FILES: paging.c/h
+ */
+int remap_bench_test() {
+	TEST_HEADER;
+
+	cpu_t * cpu = cpu_this();
+	uint32_t pde_user = cpu->page_dir[_128MB / CONVERT_4MB];
+	uint32_t pde_vid = cpu->page_dir[_136MB / CONVERT_4MB];
+	uint32_t pte_vid = cpu->user_pt[0];
+	uint64_t t0, before, same, other;
+	uint32_t i;
+
+	if (!clock_has_tsc)
+		return PASS;
+
+	t0 = rdtsc();
+	for (i = 0; i < REMAP_BENCH_ROUNDS; i++) {
+		cpu->page_dir[_128MB / CONVERT_4MB] = (_8MB + (i & 1) * _4MB) | PAGE_4MB_USER_ENTRY;
+		flush_tlb();
+		cpu->page_dir[_136MB / CONVERT_4MB] = (uint32_t)cpu->user_pt | PAGE_TABLE_PRESENT_ENTRY;
+		cpu->user_pt[0] = VIDEO | PAGE_TABLE_PRESENT_ENTRY;
+		flush_tlb();
+	}
+	before = rdtsc() - t0;
+
+	t0 = rdtsc();
+	for (i = 0; i < REMAP_BENCH_ROUNDS; i++) {
+		page_remap(_128MB, _8MB);
+		table_remap(_136MB, VIDEO);
+	}
+	same = rdtsc() - t0;
+
+	t0 = rdtsc();
+	for (i = 0; i < REMAP_BENCH_ROUNDS; i++) {
+		page_remap(_128MB, _8MB + (i & 1) * _4MB);
+		table_remap(_136MB, VIDEO);
+	}
+	other = rdtsc() - t0;
+
+	cpu->page_dir[_128MB / CONVERT_4MB] = pde_user;
+	cpu->page_dir[_136MB / CONVERT_4MB] = pde_vid;
+	cpu->user_pt[0] = pte_vid;
+	flush_tlb();
+
+	div64_32(&before, REMAP_BENCH_ROUNDS);
+	div64_32(&same, REMAP_BENCH_ROUNDS);
+	div64_32(&other, REMAP_BENCH_ROUNDS);
+	printf("remap cycles/switch: before %d, same %d, other %d\n",
+		   (uint32_t)before, (uint32_t)same, (uint32_t)other);
+
+	return (same < before) ? PASS : FAIL;
+}
+
+static uint8_t mem_bench_a[MEM_BENCH_SIZE + 16];
+static uint8_t mem_bench_b[MEM_BENCH_SIZE + 16];
+
+/*
+ *	 mem_bench_case()
+ *   DESCRIPTION: runs one memcpy / memmove case: once to check the result, then enough
+ *                times to copy MEM_BENCH_BYTES. Case 0 is aligned, 1 unaligned (src + 3 to
+ *                dst + 1), 2 overlapping with dst below src, 3 with dst above src.
+ *   INPUTS: which -- case number
+ *           n -- bytes per copy
+ *   OUTPUTS: none
+ *   RETURN VALUE: TSC cycles per 100 bytes, MEM_BENCH_FAIL if the copy came out wrong
+ *   SIDE EFFECTS: overwrites mem_bench_a / mem_bench_b
+ */
+static uint32_t mem_bench_case(uint32_t which, uint32_t n) {
+	uint8_t * a = mem_bench_a;
+	uint8_t * b = mem_bench_b;
+	uint8_t * dst = b;
+	uint8_t * src = a;
+	uint8_t * check;
+	uint32_t shift = 0;
+	uint32_t rounds = MEM_BENCH_BYTES / n;
+	uint64_t t0, cycles;
+	uint32_t i;
+
+	switch (which) {
+		case 1: dst = b + 1; src = a + 3; shift = 3; break;
+		case 2: dst = a; src = a + 1; shift = 1; break;
+		case 3: dst = a + 1; src = a; break;
+	}
+
+	for (i = 0; i < n + 3; i++)
+		a[i] = i * 7 + 1;
+	if (which < 2)
+		memcpy(dst, src, n);
+	else
+		memmove(dst, src, n);
+	check = dst;
+	for (i = 0; i < n; i++) {
+		if (check[i] != (uint8_t)((i + shift) * 7 + 1))
+			return MEM_BENCH_FAIL;
+	}
+
+	t0 = rdtsc();
+	for (i = 0; i < rounds; i++) {
+		if (which < 2)
+			memcpy(dst, src, n);
+		else
+			memmove(dst, src, n);
+	}
+	cycles = (rdtsc() - t0) * 100;
+	div64_32(&cycles, rounds * n);
+	return (uint32_t)cycles;
+}
+
+/*
+ *	 mem_bench_test()
+ *   DESCRIPTION: checks memcpy and memmove on small, medium and large copies, aligned,
+ *                unaligned and overlapping both ways, and prints what each costs
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL, prints TSC cycles per 100 bytes for each size and case
+ *   SIDE EFFECTS: none
+ *   COVERAGE: memcpy, memmove
+ *   FILES: lib.c/h
+ */
+int mem_bench_test() {
+	TEST_HEADER;
+
+	static const uint32_t sizes[] = { 8, 64, 512, 4096, MEM_BENCH_SIZE };
+	uint32_t cost[MEM_BENCH_CASES];
+	uint32_t i, j;
+
+	if (!clock_has_tsc)
+		return PASS;
+
+	printf("mem cycles/100B: aligned, unaligned, overlap down, overlap up\n");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (j = 0; j < MEM_BENCH_CASES; j++) {
+			cost[j] = mem_bench_case(j, sizes[i]);
+			if (cost[j] == MEM_BENCH_FAIL)
+				return FAIL;
+		}
+		printf("%d: %d, %d, %d, %d\n", sizes[i], cost[0], cost[1], cost[2], cost[3]);
+	}
+	return PASS;
+}
+
+/*
+ *	 acct_test()
+ *   DESCRIPTION: charges a made up process in user and then in system mode and checks
+ *                the time lands in the right counter
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: acct_init_process, acct_charge, acct_switch
+ *   FILES: acct.c/h
+ */
+int acct_test() {
+	TEST_HEADER;
+
+	static pcb_t pcb;
+	uint64_t utime;
+
+	pcb.nvcsw = pcb.nsyscalls = 1;
+	acct_init_process(&pcb, (int8_t*)"test");
+	if (pcb.utime_ns != 0 || pcb.stime_ns != 0 || pcb.nvcsw != 0 || pcb.nsyscalls != 0)
+		return FAIL;
+	if (strncmp((int8_t*)pcb.name, (int8_t*)"test", FILE_NAME_SIZE) != 0)
+		return FAIL;
+
+	/* without a TSC the clock only moves with the timer */
+	if (!clock_has_tsc)
+		return PASS;
+
+	acct_charge(&pcb);
+	utime = pcb.utime_ns;
+	if (utime == 0 || pcb.stime_ns != 0)
+		return FAIL;
+
+	pcb.acct_mode = ACCT_SYS;
+	pcb.state = PROC_BLOCKED;
+	acct_switch(&pcb, &pcb);
+	if (pcb.utime_ns != utime || pcb.stime_ns == 0 || pcb.nvcsw != 1 || pcb.nivcsw != 0)
+		return FAIL;
+
+	return PASS;
+}
+
+/*
+ *	 scrollback_test()
+ *   DESCRIPTION: pushes more rows than the ring holds into the last terminal's scrollback
+ *                and checks the newest are kept in order and the oldest dropped
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: fills the last terminal's history with test rows
+ *   COVERAGE: sb_push, sb_line
+ *   FILES: scrollback.c/h
+ */
+int scrollback_test() {
+	TEST_HEADER;
+
+	uint16_t row[NUM_COLS];
+	uint16_t * line;
+	uint32_t i;
+
+	memset_word(row, ' ', NUM_COLS);
+	for (i = 0; i <= SCROLLBACK_LINES; i++) {
+		row[0] = (uint16_t)i;
+		sb_push(MAX_TERM-1, row);
+	}
+
+	line = sb_line(MAX_TERM-1, 1);
+	if (line == NULL || line[0] != SCROLLBACK_LINES || line[1] != ' ')
+		return FAIL;
+	line = sb_line(MAX_TERM-1, SCROLLBACK_LINES);
+	if (line == NULL || line[0] != 1)
+		return FAIL;
+	if (sb_line(MAX_TERM-1, SCROLLBACK_LINES+1) != NULL || sb_line(MAX_TERM-1, 0) != NULL)
+		return FAIL;
+
+	return PASS;
+}
+
+/*
+ *	 term_page_test()
+ *   DESCRIPTION: prints to a terminal that is not displayed and checks the text lands in
+ *                that terminal's own video memory while the displayed screen is untouched
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: moves the last terminal's cursor back to the top left
+ *   COVERAGE: printf_term, term_screen, term_set_pos
+ *   FILES: lib.c/h
+ */
+int term_page_test() {
+	TEST_HEADER;
+
+	uint8_t term = MAX_TERM-1;
+	uint8_t * screen;
+	uint8_t shown;
+
+	if (term == cur_term)
+		return PASS;
+
+	shown = *term_screen(cur_term);
+	term_set_pos(term, 0, 0);
+	printf_term(term, "%d", 42);
+	screen = term_screen(term);
+	if ((uint32_t)screen < TERM_VGA(term) || (uint32_t)screen >= TERM_VGA(term) + TERM_VGA_SIZE)
+		return FAIL;
+	if (screen[0] != '4' || screen[2] != '2')
+		return FAIL;
+	if (*term_screen(cur_term) != shown)
+		return FAIL;
+
+	screen[0] = screen[2] = ' ';
+	term_set_pos(term, 0, 0);
+	return PASS;
+}
+
+/*
+ *	 snprintf_test()
+ *   DESCRIPTION: formats widths, flags, %p and 64-bit numbers into a buffer, then a line
+ *                longer than printf's buffer onto a terminal that is not displayed
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: moves the last terminal's cursor back to the top left
+ *   COVERAGE: snprintf, vsnprintf, printf_term
+ *   FILES: lib.c/h
+ */
+int snprintf_test() {
+	TEST_HEADER;
+
+	static const int8_t expect[] = "[  -42|7   |0042|0x00C0FFEE|0000BEEF|ab |18446744073709551615]";
+	uint8_t term = MAX_TERM-1;
+	uint8_t * screen;
+	int8_t buf[80];
+	int32_t len, i;
+
+	len = snprintf(buf, sizeof(buf), "[%5d|%-4u|%04x|%p|%#x|%-3.2s|%llu]",
+			-42, 7, 0x42, (void*)0xC0FFEE, 0xBEEF, "abc", 0xFFFFFFFFFFFFFFFFULL);
+	if (len != sizeof(expect) - 1 || strncmp(buf, expect, sizeof(expect)) != 0)
+		return FAIL;
+
+	/* cut short: NUL terminated, the full length still reported */
+	if (snprintf(buf, 4, "%lld", -123456789012LL) != 13 || strncmp(buf, "-12", 4) != 0)
+		return FAIL;
+
+	if (term == cur_term)
+		return PASS;
+	term_set_pos(term, 0, 0);
+	if (printf_term(term, "%*d", PRINTF_BUF_SIZE + 2, 5) != PRINTF_BUF_SIZE + 2)
+		return FAIL;
+	screen = term_screen(term);
+	if (screen[(PRINTF_BUF_SIZE + 1) * 2] != '5')
+		return FAIL;
+
+	for (i = 0; i < PRINTF_BUF_SIZE + 2; i++)
+		screen[i * 2] = ' ';
+	term_set_pos(term, 0, 0);
+	return PASS;
+}
+
+/*
+ *	 term_write_test()
+ *   DESCRIPTION: writes raw bytes holding a '%' and a newline to a hidden terminal and
+ *                checks they are copied as they are and no further than nbytes
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: moves the last terminal's cursor back to the top left
+ *   COVERAGE: term_write
+ *   FILES: lib.c/h
+ */
+int term_write_test() {
+	TEST_HEADER;
+
+	uint8_t term = MAX_TERM-1;
+	uint8_t * screen;
+	int32_t ret;
+
+	if (term == cur_term)
+		return PASS;
+
+	term_set_pos(term, 0, 0);
+	screen = term_screen(term);
+	screen[(NUM_COLS + 1) << 1] = ' ';
+	ret = term_write(term, (uint8_t *)"%d\nab", 5);
+	screen = term_screen(term);
+	if (ret != 5 || screen[0] != '%' || screen[2] != 'd')
+		return FAIL;
+	if (screen[NUM_COLS << 1] != 'a' || screen[(NUM_COLS + 1) << 1] != ' ')
+		return FAIL;
+
+	memset_word(screen, ATTRIB_TERM3 << 8 | ' ', 2 * NUM_COLS);
+	term_set_pos(term, 0, 0);
+	return PASS;
+}
+
+/*
+ *	 term_out_test()
+ *   DESCRIPTION: queues output for a hidden terminal and checks nothing is drawn until the
+ *                terminal's ring is flushed
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: moves the last terminal's cursor back to the top left
+ *   COVERAGE: terminal_out_write, terminal_out_flush
+ *   FILES: terminal.c/h
+ */
+int term_out_test() {
+	TEST_HEADER;
+
+	uint8_t term = MAX_TERM-1;
+	uint8_t * screen;
+
+	if (term == cur_term)
+		return PASS;
+
+	terminal[term].id = term;
+	term_set_pos(term, 0, 0);
+	screen = term_screen(term);
+	screen[0] = ' ';
+	if (terminal_out_write(&terminal[term], (uint8_t *)"q", 1) != 1 || screen[0] != ' ')
+		return FAIL;
+	if (terminal[term].out_head - terminal[term].out_tail != 1)
+		return FAIL;
+
+	terminal_out_flush(term);
+	if (screen[0] != 'q' || terminal[term].out_head != terminal[term].out_tail)
+		return FAIL;
+
+	screen[0] = ' ';
+	term_set_pos(term, 0, 0);
+	return PASS;
+}
+
+/*
+ *	 vbe_test()
+ *   DESCRIPTION: checks the back buffer is mapped for the kernel and the adapter is still
+ *                in text mode when no process owns the display
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: vbe_init, kernel_map
+ *   FILES: vbe.c/h, paging.c/h
+ */
+int vbe_test() {
+	TEST_HEADER;
+
+	volatile uint32_t * back = (uint32_t *)VBE_BACK_PHYS;
+	uint32_t old;
+
+	/* no Bochs adapter: nothing was mapped */
+	if (!vbe_present)
+		return PASS;
+
+	old = back[0];
+	back[0] = 0x12345678;
+	if (back[0] != 0x12345678)
+		return FAIL;
+	back[0] = old;
+
+	outw(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_IOPORT_INDEX);
+	if (inw(VBE_DISPI_IOPORT_DATA) & VBE_DISPI_ENABLED)
+		return FAIL;
+	return PASS;
+}
+
+/*
+ *	 ansi_test()
+ *   DESCRIPTION: positions the cursor, colors a character and erases a line with escape
+ *                sequences on a hidden terminal, with one sequence split across two writes
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: blanks the last terminal's screen and moves its cursor to the top left
+ *   COVERAGE: term_write, ansi_putc, ansi_csi, ansi_sgr, ansi_erase
+ *   FILES: lib.c/h
+ */
+int ansi_test() {
+	TEST_HEADER;
+
+	uint8_t term = MAX_TERM-1;
+	uint16_t * screen;
+
+	if (term == cur_term)
+		return PASS;
+
+	term_set_pos(term, 0, 0);
+	term_write(term, (uint8_t *)"\x1b[2J\x1b[2;", 8);
+	term_write(term, (uint8_t *)"3H\x1b[32mX\x1b[0mY", 13);
+	screen = (uint16_t *)term_screen(term);
+	if ((screen[NUM_COLS + 2] & 0xFF) != 'X' || (screen[NUM_COLS + 2] >> 8) != ((ATTRIB_TERM3 & ~VGA_FG_COLOR) | 2))
+		return FAIL;
+	if (screen[NUM_COLS + 3] != (ATTRIB_TERM3 << 8 | 'Y'))
+		return FAIL;
+
+	term_write(term, (uint8_t *)"\x1b[1G\x1b[K", 7);
+	if (screen[NUM_COLS + 2] != (ATTRIB_TERM3 << 8 | ' ') || screen[NUM_COLS + 3] != (ATTRIB_TERM3 << 8 | ' '))
+		return FAIL;
+
+	term_ansi_reset(term);
+	term_set_pos(term, 0, 0);
+	return PASS;
+}
+
+/*
+ *	 ld_raw_test()
+ *   DESCRIPTION: in raw mode a key goes to the raw queue without touching the line buffer,
+ *                the queue drops keys once full, and a pending VTIME read is reported to
+ *                tick_next
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: empties the displayed terminal's raw queue
+ *   COVERAGE: handle_key_press, terminal_raw_key, terminal_read_deadline
+ *   FILES: terminal.c/h, keyboard.c/h
+ */
+int ld_raw_test() {
+	TEST_HEADER;
+
+	term_t * term = &terminal[cur_term];
+	uint8_t mode = term->ld_mode;
+	uint8_t idx = key_buffer_idx;
+	int32_t i;
+
+	if (keyboard_enabled != 1)
+		return PASS;
+
+	term->ld_mode = LD_RAW;
+	term->raw_tail = term->raw_head;
+	handle_key_press(ENTER);
+	term->ld_mode = mode;
+	if (term->raw_head - term->raw_tail != 1 || term->raw_buf[term->raw_tail & TERM_RAW_MASK] != '\n')
+		return FAIL;
+	if (key_buffer_idx != idx)
+		return FAIL;
+
+	for (i = 0; i < TERM_RAW_SIZE; i++)
+		terminal_raw_key('a');
+	if (term->raw_head - term->raw_tail != TERM_RAW_SIZE)
+		return FAIL;
+	term->raw_tail = term->raw_head;
+
+	term->read_deadline = 1;
+	if (terminal_read_deadline() != 1)
+		return FAIL;
+	term->read_deadline = 0;
+	return PASS;
+}
+
+/*
+ *	 kbd_bh_test()
+ *   DESCRIPTION: queues shift + h, i as raw scancodes and lets the bottom half decode them
+ *                into a raw mode terminal; then overfills the ring, which must drop the rest
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: empties the displayed terminal's raw queue
+ *   COVERAGE: kbd_ring_push, keyboard_bh, tasklet_run
+ *   FILES: keyboard.c/h
+ */
+int kbd_bh_test() {
+	TEST_HEADER;
+
+	static const uint8_t scancodes[] = { 0x2A, 0x23, 0xA3, 0xAA, 0x17, 0x97 };	/* H i */
+	term_t * term = &terminal[cur_term];
+	uint8_t mode = term->ld_mode;
+	uint32_t dropped = kbd_dropped;
+	uint32_t flags, i;
+	int32_t result = PASS;
+
+	if (keyboard_enabled != 1)
+		return PASS;
+
+	cli_and_save(flags);
+	term->ld_mode = LD_RAW;
+	term->raw_tail = term->raw_head;
+	for (i = 0; i < sizeof(scancodes); i++)
+		kbd_ring_push(scancodes[i]);
+	tasklet_run();
+	if (term->raw_head - term->raw_tail != 2 ||
+		term->raw_buf[term->raw_tail & TERM_RAW_MASK] != 'H' ||
+		term->raw_buf[(term->raw_tail + 1) & TERM_RAW_MASK] != 'i')
+		result = FAIL;
+
+	/* key releases only, nothing reaches the terminal */
+	for (i = 0; i <= KBD_RING_SIZE; i++)
+		kbd_ring_push(0x97);
+	if (kbd_dropped != dropped + 1)
+		result = FAIL;
+	tasklet_run();
+
+	term->raw_tail = term->raw_head;
+	term->ld_mode = mode;
+	restore_flags(flags);
+	return result;
+}
+
+/*
+ *	 ioapic_test()
+ *   DESCRIPTION: once the IO APIC has the device interrupts, the keyboard arrives on the
+ *                8259's old vector, the 8259 stays masked and enable_irq / disable_irq
+ *                flip the RTC's redirection entry
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none, the RTC is left as it was
+ *   COVERAGE: ioapic_init, enable_irq, disable_irq
+ *   FILES: ioapic.c/h, i8259.c/h
+ */
+int ioapic_test() {
+	TEST_HEADER;
+
+	uint32_t rtc_masked;
+	uint32_t flags;
+	int32_t result = PASS;
+
+	if (!ioapic_ready)
+		return PASS;
+
+	if ((ioapic_entry(1) & (IOAPIC_MASKED | IOAPIC_VECTOR_MASK)) != IRQ_VECTOR_BASE + 1)
+		return FAIL;
+	if (inb(MASTER_8259_DATA_PORT) != PIC_IRQ_MASK || inb(SLAVE_8259_DATA_PORT) != PIC_IRQ_MASK)
+		return FAIL;
+
+	cli_and_save(flags);
+	rtc_masked = ioapic_entry(RTC_IRQ_NUM) & IOAPIC_MASKED;
+	disable_irq(RTC_IRQ_NUM);
+	if (!(ioapic_entry(RTC_IRQ_NUM) & IOAPIC_MASKED))
+		result = FAIL;
+	enable_irq(RTC_IRQ_NUM);
+	if ((ioapic_entry(RTC_IRQ_NUM) & (IOAPIC_MASKED | IOAPIC_VECTOR_MASK)) != IRQ_VECTOR_BASE + RTC_IRQ_NUM)
+		result = FAIL;
+	if (rtc_masked)
+		disable_irq(RTC_IRQ_NUM);
+	restore_flags(flags);
+	return result;
+}
+
+/*
+ *	 rtc_virtual_test()
+ *   DESCRIPTION: two RTC fds at 2 Hz and 32 Hz run the hardware at 32 Hz; closing the fast
+ *                one slows it back down, and a rate that is not a power of two is refused
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: uses the RTC slots of the running process's last two fds
+ *   COVERAGE: rtc_write, rtc_close
+ *   FILES: rtc.c/h
+ */
+int rtc_virtual_test() {
+	TEST_HEADER;
+
+	int32_t slow_fd = NUM_MAX_OPEN_FILES - 2;
+	int32_t fast_fd = NUM_MAX_OPEN_FILES - 1;
+	int32_t freq;
+	int32_t result = PASS;
+
+	freq = RTC_MIN_FREQ;
+	if (rtc_write(slow_fd, &freq, 4) != 4)
+		return FAIL;
+	freq = 32;
+	if (rtc_write(fast_fd, &freq, 4) != 4 || rtc_cur_freq < 32)
+		result = FAIL;
+	freq = 3;
+	if (rtc_write(slow_fd, &freq, 4) != -1)
+		result = FAIL;
+	rtc_close(fast_fd);
+	if (rtc_cur_freq == 32)
+		result = FAIL;
+	rtc_close(slow_fd);
+	return result;
+}
+
+/* tasklet_test's tasklet: counts its runs in *data */
+static void tasklet_test_func(uint32_t data) {
+	(*(uint32_t *)data)++;
+}
+
+/*
+ *	 tasklet_test()
+ *   DESCRIPTION: a tasklet scheduled twice before the queue is drained runs once, and the
+ *                queue is empty again afterwards
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: the test tasklet stays listed in the interrupts file
+ *   COVERAGE: tasklet_init, tasklet_schedule, tasklet_run
+ *   FILES: tasklet.c/h
+ */
+int tasklet_test() {
+	TEST_HEADER;
+
+	static tasklet_t t;
+	static uint32_t ran;
+	uint32_t coalesced = tasklet_stats.coalesced;
+	uint32_t flags;
+	int32_t result = PASS;
+
+	if (t.func == NULL)
+		tasklet_init(&t, "test", tasklet_test_func, (uint32_t)&ran);
+	ran = 0;
+
+	cli_and_save(flags);
+	tasklet_schedule(&t);
+	tasklet_schedule(&t);
+	if (!t.queued || tasklet_stats.coalesced != coalesced + 1)
+		result = FAIL;
+	tasklet_run();
+	if (ran != 1 || t.queued || tasklet_stats.depth != 0)
+		result = FAIL;
+	restore_flags(flags);
+	return result;
+}
+
+/*
+ *	 irq_stats_test()
+ *   DESCRIPTION: runs irq_enter / irq_exit around nothing on an unused vector: it is counted
+ *                once and, with a TSC, timed once with min <= max. A context switch in between
+ *                keeps the run out of the times.
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none, the vector's counters are put back
+ *   COVERAGE: irq_enter, irq_exit, irqstat_format
+ *   FILES: irqstat.c/h
+ */
+int irq_stats_test() {
+	TEST_HEADER;
+
+	irq_stat_t * s = &irq_stats[IRQSTAT_TEST_VECTOR];
+	irq_stat_t saved = *s;
+	irq_frame_t frame;
+	int8_t text[IRQSTAT_TEXT_SIZE];
+	uint32_t flags;
+	int32_t result = PASS;
+
+	cli_and_save(flags);
+	s->count = s->timed = 0;
+	irq_enter(IRQSTAT_TEST_VECTOR, &frame);
+	irq_exit(&frame);
+	if (s->count != 1 || s->timed != (clock_has_tsc ? 1 : 0) || s->min > s->max)
+		result = FAIL;
+
+	irq_enter(IRQSTAT_TEST_VECTOR, &frame);
+	frame.switches--;
+	irq_exit(&frame);
+	if (s->count != 2 || s->timed != (clock_has_tsc ? 1 : 0))
+		result = FAIL;
+	*s = saved;
+	restore_flags(flags);
+
+	if (irqstat_format(text, IRQSTAT_TEXT_SIZE) <= 0 || irqstat_format(text, 8) != 7)
+		result = FAIL;
+	return result;
+}
+
+/*
+ *	 serial_test()
+ *   DESCRIPTION: with interrupts off nothing drains the transmit ring; printing more than
+ *                it holds must still return, dropping the rest instead of waiting on the UART
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: sends a ring's worth of '.' out of COM1
+ *   COVERAGE: serial_putc
+ *   FILES: serial.c/h
+ */
+int serial_test() {
+	TEST_HEADER;
+
+	uint32_t dropped = serial_counters.tx_dropped;
+	uint32_t flags;
+	int32_t i;
+
+	if (!serial_present)
+		return PASS;
+
+	cli_and_save(flags);
+	for (i = 0; i < SERIAL_TX_SIZE + 1; i++)
+		serial_putc('.');	/* printable: whatever is on COM1 shows it */
+	restore_flags(flags);
+
+	if (serial_counters.tx_dropped == dropped)
+		return FAIL;
+	return PASS;
+}
+
+/*
+ *	 cursor_flush_test()
+ *   DESCRIPTION: moves the cursor many times and checks only one update reaches the CRTC
+ *   INPUTS: none
+ *   OUTPUTS: PASS/FAIL
+ *   SIDE EFFECTS: none
+ *   COVERAGE: set_cursor_pos, cursor_flush
+ *   FILES: lib.c/h
+ */
+int cursor_flush_test() {
+	TEST_HEADER;
+
+	uint32_t writes, flushes;
+	int32_t i;
+
+	cursor_flush();
+	writes = vga_counters.port_writes;
+	flushes = vga_counters.cursor_flushes;
+	for (i = 0; i < NUM_COLS; i++)
+		set_screen_pos(i, get_screen_y());
+	cursor_flush();
+	cursor_flush();
+
+	if (vga_counters.port_writes - writes > 2 || vga_counters.cursor_flushes - flushes > 1)
+		return FAIL;
+	return PASS;
+}
+/* =======================================================================================END== */
+
+
 /* Test suite entry point */
 void launch_tests(){
 	//TEST_OUTPUT("idt_test", idt_test());
@@ -860,6 +2086,36 @@ void launch_tests(){
 	clear();
 	printf(" ========== STARTING TESTS ==========\n");
 
+	/* ============================================== launch SCHEDULER TESTS here */
+	TEST_OUTPUT("sched_priority_test", sched_priority_test());
+	TEST_OUTPUT("sched_pick_test", sched_pick_test());
+	TEST_OUTPUT("wait_queue_test", wait_queue_test());
+	TEST_OUTPUT("tick_stats_test", tick_stats_test());
+	TEST_OUTPUT("tick_oneshot_test", tick_oneshot_test());
+	TEST_OUTPUT("clock_test", clock_test());
+	TEST_OUTPUT("smp_test", smp_test());
+	TEST_OUTPUT("fpu_test", fpu_test());
+	TEST_OUTPUT("trace_test", trace_test());
+	TEST_OUTPUT("remap_bench_test", remap_bench_test());
+	TEST_OUTPUT("mem_bench_test", mem_bench_test());
+	TEST_OUTPUT("snprintf_test", snprintf_test());
+	TEST_OUTPUT("kbd_bh_test", kbd_bh_test());
+	TEST_OUTPUT("ioapic_test", ioapic_test());
+	TEST_OUTPUT("irq_stats_test", irq_stats_test());
+	TEST_OUTPUT("rtc_virtual_test", rtc_virtual_test());
+	TEST_OUTPUT("tasklet_test", tasklet_test());
+	TEST_OUTPUT("acct_test", acct_test());
+	TEST_OUTPUT("scrollback_test", scrollback_test());
+	TEST_OUTPUT("term_page_test", term_page_test());
+	TEST_OUTPUT("term_write_test", term_write_test());
+	TEST_OUTPUT("term_out_test", term_out_test());
+	TEST_OUTPUT("cursor_flush_test", cursor_flush_test());
+	TEST_OUTPUT("vbe_test", vbe_test());
+	TEST_OUTPUT("ld_raw_test", ld_raw_test());
+	TEST_OUTPUT("ansi_test", ansi_test());
+	TEST_OUTPUT("serial_test", serial_test());
+	/* ============================================================== END SCHED ==== */
+
 	/* ============================================== launch CHECKPOINT 3 TESTS here */
 	// TEST_OUTPUT("open_sys_test()", open_sys_test());
 	// TEST_OUTPUT("close_sys_test()", close_sys_test());
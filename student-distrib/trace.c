@@ -0,0 +1,349 @@
+/* trace.c - scheduler latency and timer jitter tracing
+ *
+ * Wakeups, context switches and timer interrupts append TSC stamped records to
+ * a fixed ring. Writers claim a slot with one locked add and never wait, so
+ * any CPU can trace from any context; when the ring is full the oldest records
+ * are overwritten. Reading the "trace" pseudo file turns whatever the ring
+ * holds into per-process wakeup latency and per-CPU tick jitter histograms.
+ */
+
+#include "trace.h"
+#include "lib.h"
+#include "clock.h"
+#include "smp.h"
+#include "scheduler.h"
+#include "syscalls.h"
+
+static trace_rec_t trace_ring[TRACE_RING_SIZE];
+/* records ever claimed; the next one goes to trace_ring[trace_head & TRACE_RING_MASK] */
+static volatile uint32_t trace_head = 0;
+
+/* histograms built by trace_format */
+static uint32_t wake_hist[NUM_MAX_PROCESSES][TRACE_BUCKETS];
+static uint32_t tick_hist[MAX_CPUS][TRACE_BUCKETS];
+
+/* text handed out by trace_read, rebuilt whenever a reader starts at offset 0 */
+static int8_t trace_text[TRACE_TEXT_SIZE];
+static int32_t trace_text_len = 0;
+
+/* where put_str / put_num append */
+static int8_t * out_buf;
+static int32_t out_len;
+static int32_t out_size;
+
+/* trace_event
+ *   DESCRIPTION: stamps an event with the TSC and stores it in the next ring slot
+ *   INPUT: type -- TRACE_WAKEUP ... TRACE_TICK
+ *          pid -- process the event is about, TRACE_NO_PROC if none
+ *          arg -- type specific, see trace.h
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: may overwrite the oldest record; does nothing without a TSC
+ */
+void trace_event(uint8_t type, uint8_t pid, uint32_t arg) {
+    uint32_t idx = 1;
+    trace_rec_t * rec;
+
+    if (!clock_has_tsc)
+        return;
+
+    asm volatile("lock xaddl %0, %1" : "+r"(idx), "+m"(trace_head) : : "memory");
+    rec = &trace_ring[idx & TRACE_RING_MASK];
+
+    rec->seq = 0;
+    asm volatile("" : : : "memory");
+    rec->tsc = rdtsc();
+    rec->arg = arg;
+    rec->type = type;
+    rec->cpu = cpu_this()->id;
+    rec->pid = pid;
+    asm volatile("" : : : "memory");
+    rec->seq = idx + 1;
+}
+
+/* trace_us
+ *   DESCRIPTION: converts TSC cycles to microseconds
+ *   INPUT: cycles -- TSC difference
+ *   OUTPUT: none
+ *   RETURN VALUE: microseconds, saturated to 32 bits
+ *   SIDE EFFECT: none
+ */
+static uint32_t trace_us(uint64_t cycles) {
+    uint64_t us = cycles * 1000;
+
+    div64_32(&us, tsc_khz);
+    if (us >> 32)
+        return 0xFFFFFFFF;
+    return (uint32_t)us;
+}
+
+/* trace_bucket
+ *   DESCRIPTION: histogram bucket of a duration: bucket k holds [2^(k-1), 2^k) us, bucket 0
+ *                anything under 1us and the last one everything longer
+ *   INPUT: us -- duration in microseconds
+ *   OUTPUT: none
+ *   RETURN VALUE: bucket index
+ *   SIDE EFFECT: none
+ */
+static uint32_t trace_bucket(uint32_t us) {
+    uint32_t k = 0;
+
+    while (k < TRACE_BUCKETS - 1 && us >= ((uint32_t)1 << k))
+        k++;
+    return k;
+}
+
+/* put_str
+ *   DESCRIPTION: appends a string to the text being built, dropping what does not fit
+ *   INPUT: s -- string to append
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: advances out_len
+ */
+static void put_str(const int8_t * s) {
+    while (*s != '\0' && out_len < out_size)
+        out_buf[out_len++] = *s++;
+}
+
+/* put_num
+ *   DESCRIPTION: appends a decimal number right aligned to the given width
+ *   INPUT: value -- number to append
+ *          width -- minimum number of characters
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: advances out_len
+ */
+static void put_num(uint32_t value, int32_t width) {
+    int8_t num[12];
+    int32_t len;
+
+    itoa(value, num, 10);
+    for (len = strlen(num); len < width; len++)
+        put_str(" ");
+    put_str(num);
+}
+
+/* put_hist
+ *   DESCRIPTION: appends the non-empty buckets of a histogram, one per line
+ *   INPUT: hist -- TRACE_BUCKETS counters
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: advances out_len
+ */
+static void put_hist(const uint32_t * hist) {
+    uint32_t k;
+
+    for (k = 0; k < TRACE_BUCKETS; k++) {
+        if (hist[k] == 0)
+            continue;
+        if (k < TRACE_BUCKETS - 1) {
+            put_str("     <");
+            put_num((uint32_t)1 << k, 6);
+        } else {
+            put_str("    >=");
+            put_num((uint32_t)1 << (k - 1), 6);
+        }
+        put_str("us ");
+        put_num(hist[k], 6);
+        put_str("\n");
+    }
+}
+
+/* hist_total
+ *   DESCRIPTION: sums a histogram
+ *   INPUT: hist -- TRACE_BUCKETS counters
+ *   OUTPUT: none
+ *   RETURN VALUE: number of samples
+ *   SIDE EFFECT: none
+ */
+static uint32_t hist_total(const uint32_t * hist) {
+    uint32_t k, total = 0;
+
+    for (k = 0; k < TRACE_BUCKETS; k++)
+        total += hist[k];
+    return total;
+}
+
+/* trace_format
+ *   DESCRIPTION: walks the ring oldest first. A wakeup is paired with the next switch to or
+ *                return from sched_block of the same process; the time in between is its
+ *                wakeup latency. A timer interrupt is compared with the moment its one-shot
+ *                was armed (or, for a periodic timer, the previous interrupt) and the
+ *                deviation from the ticks it stood for is its jitter. Records overwritten
+ *                while being read are skipped.
+ *   INPUT: text -- buffer for the text
+ *          size -- its size
+ *   OUTPUT: human readable histograms in text (not NUL terminated)
+ *   RETURN VALUE: number of characters written
+ *   SIDE EFFECT: none
+ */
+int32_t trace_format(int8_t * text, int32_t size) {
+    uint64_t woken[NUM_MAX_PROCESSES];
+    uint64_t armed[MAX_CPUS];
+    uint64_t last_tick[MAX_CPUS];
+    trace_rec_t rec;
+    trace_rec_t * slot;
+    uint32_t head, start, i, seq;
+    uint32_t used = 0, lost = 0;
+    uint32_t elapsed, expected;
+    uint64_t ref;
+
+    out_buf = text;
+    out_len = 0;
+    out_size = size;
+
+    if (!clock_has_tsc || tsc_khz == 0) {
+        put_str("no TSC, tracing is off\n");
+        return out_len;
+    }
+
+    memset(wake_hist, 0, sizeof(wake_hist));
+    memset(tick_hist, 0, sizeof(tick_hist));
+    memset(woken, 0, sizeof(woken));
+    memset(armed, 0, sizeof(armed));
+    memset(last_tick, 0, sizeof(last_tick));
+
+    head = trace_head;
+    start = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+
+    for (i = start; i != head; i++) {
+        slot = &trace_ring[i & TRACE_RING_MASK];
+        seq = slot->seq;
+        asm volatile("" : : : "memory");
+        rec = *slot;
+        asm volatile("" : : : "memory");
+        if (seq != i + 1 || slot->seq != seq || rec.cpu >= MAX_CPUS) {
+            lost++;
+            continue;
+        }
+        used++;
+
+        switch (rec.type) {
+            case TRACE_WAKEUP:
+                if (rec.pid < NUM_MAX_PROCESSES && woken[rec.pid] == 0)
+                    woken[rec.pid] = rec.tsc;
+                break;
+
+            case TRACE_SWITCH:
+            case TRACE_RUN:
+                if (rec.pid < NUM_MAX_PROCESSES && woken[rec.pid] != 0) {
+                    wake_hist[rec.pid][trace_bucket(trace_us(rec.tsc - woken[rec.pid]))]++;
+                    woken[rec.pid] = 0;
+                }
+                break;
+
+            case TRACE_ARM:
+                armed[rec.cpu] = rec.tsc;
+                break;
+
+            case TRACE_TICK:
+                ref = armed[rec.cpu] ? armed[rec.cpu] : last_tick[rec.cpu];
+                if (ref != 0) {
+                    elapsed = trace_us(rec.tsc - ref);
+                    expected = rec.arg * (1000000 / SET_FREQ);
+                    tick_hist[rec.cpu][trace_bucket(elapsed > expected ? elapsed - expected
+                                                                      : expected - elapsed)]++;
+                }
+                armed[rec.cpu] = 0;
+                last_tick[rec.cpu] = rec.tsc;
+                break;
+        }
+    }
+
+    put_str("wakeup latency\n");
+    for (i = 0; i < NUM_MAX_PROCESSES; i++) {
+        if (hist_total(wake_hist[i]) == 0)
+            continue;
+        put_str("  process ");
+        put_num(i, 0);
+        put_str(", ");
+        put_num(hist_total(wake_hist[i]), 0);
+        put_str(" wakeups\n");
+        put_hist(wake_hist[i]);
+    }
+
+    put_str("tick jitter\n");
+    for (i = 0; i < MAX_CPUS; i++) {
+        if (hist_total(tick_hist[i]) == 0)
+            continue;
+        put_str("  cpu ");
+        put_num(i, 0);
+        put_str(", ");
+        put_num(hist_total(tick_hist[i]), 0);
+        put_str(" ticks\n");
+        put_hist(tick_hist[i]);
+    }
+
+    put_str("records ");
+    put_num(used, 0);
+    put_str(" of ");
+    put_num(head, 0);
+    put_str(", ");
+    put_num(lost, 0);
+    put_str(" torn\n");
+
+    return out_len;
+}
+
+/* trace_open
+ *   DESCRIPTION: opens the trace pseudo file
+ *   INPUT: filename -- ignored
+ *   OUTPUT: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECT: none
+ */
+int32_t trace_open(const uint8_t* filename) {
+    return 0;
+}
+
+/* trace_read
+ *   DESCRIPTION: reads the histograms as text. Reading from offset 0 takes a new snapshot
+ *                of the ring.
+ *   INPUT: fd -- file descriptor
+ *          buf -- user buffer
+ *          nbytes -- bytes wanted
+ *   OUTPUT: text in buf
+ *   RETURN VALUE: bytes read, 0 at the end of the text, -1 if buf is not user memory
+ *   SIDE EFFECT: advances the file position
+ */
+int32_t trace_read(int32_t fd, void* buf, int32_t nbytes) {
+    pcb_t * pcb = get_pcb_ptr();
+    int32_t pos = pcb->fds[fd].file_position;
+
+    if (nbytes < 0 || bad_userspace_addr(buf, nbytes))
+        return -1;
+
+    if (pos == 0)
+        trace_text_len = trace_format(trace_text, TRACE_TEXT_SIZE);
+
+    if (pos >= trace_text_len)
+        return 0;
+    if (nbytes > trace_text_len - pos)
+        nbytes = trace_text_len - pos;
+
+    memcpy(buf, trace_text + pos, nbytes);
+    pcb->fds[fd].file_position += nbytes;
+    return nbytes;
+}
+
+/* trace_write
+ *   DESCRIPTION: the trace file is read only
+ *   INPUT: fd, buf, nbytes -- ignored
+ *   OUTPUT: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECT: none
+ */
+int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes) {
+    return -1;
+}
+
+/* trace_close
+ *   DESCRIPTION: closes the trace pseudo file
+ *   INPUT: fd -- ignored
+ *   OUTPUT: none
+ *   RETURN VALUE: 0
+ *   SIDE EFFECT: none
+ */
+int32_t trace_close(int32_t fd) {
+    return 0;
+}
@@ -0,0 +1,46 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+#define TRACE_RING_SIZE		1024		/* records kept, power of two */
+#define TRACE_RING_MASK		(TRACE_RING_SIZE - 1)
+#define TRACE_BUCKETS		18			/* log2 microsecond buckets, the last one is open ended */
+#define TRACE_TEXT_SIZE		4096		/* room for the text read out of the trace file */
+#define TRACE_FILE_NAME		"trace"		/* pseudo file next to the file system image */
+#define TRACE_NO_PROC		0xFF
+
+/* record types */
+#define TRACE_WAKEUP		0			/* pid became runnable */
+#define TRACE_SWITCH		1			/* context switch to pid, arg = process switched from */
+#define TRACE_RUN			2			/* pid returned from sched_block */
+#define TRACE_ARM			3			/* one-shot armed, arg = periodic ticks until it fires */
+#define TRACE_TICK			4			/* timer interrupt, arg = periodic ticks it stands for */
+
+/* one event. seq is written last (index + 1 of the record) so a reader can tell
+ * a complete record from one being overwritten. */
+typedef struct {
+	uint64_t tsc;
+	volatile uint32_t seq;
+	uint32_t arg;
+	uint8_t type;
+	uint8_t cpu;
+	uint8_t pid;
+} trace_rec_t;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* appends a record to the ring, from any CPU and any context */
+void trace_event(uint8_t type, uint8_t pid, uint32_t arg);
+
+/* renders wakeup latency and tick jitter histograms of the ring's records, returns the length */
+int32_t trace_format(int8_t * text, int32_t size);
+
+/* trace file operations */
+int32_t trace_open(const uint8_t* filename);
+int32_t trace_read(int32_t fd, void* buf, int32_t nbytes);
+int32_t trace_write(int32_t fd, const void* buf, int32_t nbytes);
+int32_t trace_close(int32_t fd);
+
+#endif
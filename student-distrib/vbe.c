@@ -0,0 +1,432 @@
+/* vbe.c - Bochs/QEMU VBE linear framebuffer with a back buffer
+ *
+ * One process at a time may own the display (fbmap). It draws into a back
+ * buffer in RAM mapped at VBE_USER_ADDR and calls fbflush with the rectangle
+ * it changed; only those rows are copied to the framebuffer. Graphics are
+ * only on while the owner's terminal is displayed; the other terminals keep
+ * using text mode. The LFB shares video memory with the text planes and the
+ * font, so the visible screen is moved past them (VBE_FB_OFFSET), and the VGA
+ * registers the adapter reprograms are saved before graphics and restored after.
+ *
+ * Past that offset there are two screens. A flush copies into the hidden one and
+ * then points the DISPI Y offset at it; the adapter picks the new start up once
+ * per frame, so the picture never shows half of a flush (no tearing) and nobody
+ * waits for the retrace. The hidden screen is also missing what the previous flush
+ * drew on the other one, so that rectangle is copied again with the new one.
+ */
+
+#include "vbe.h"
+#include "lib.h"
+#include "paging.h"
+#include "syscalls.h"
+#include "terminal.h"
+#include "tasklet.h"
+
+uint8_t vbe_present = 0;
+static uint32_t vbe_lfb = VBE_DEFAULT_LFB;
+static uint8_t vbe_owner = VBE_NO_OWNER;
+static uint8_t vbe_term;
+static uint8_t vbe_enabled = 0;
+static uint8_t vbe_front = 0;               /* screen page being shown */
+static fb_rect_t vbe_stale;                 /* drawn on the front page, not yet on the back */
+static volatile uint8_t vbe_busy = 0;       /* a flush is copying */
+static volatile uint8_t vbe_redraw_full = 0;    /* the next flush copies the whole screen */
+/* redraws the screen after a terminal switch, once interrupts are back on */
+static tasklet_t vbe_tasklet;
+
+/* text mode register state, saved by vga_save when graphics go on */
+static struct {
+    uint8_t misc;
+    uint8_t seq[VGA_NUM_SEQ];
+    uint8_t crtc[VGA_NUM_CRTC];
+    uint8_t gc[VGA_NUM_GC];
+    uint8_t ac[VGA_NUM_AC];
+} vga_text_regs;
+
+/* vbe_write
+ *   DESCRIPTION: sets one DISPI register
+ *   INPUT: index -- register
+ *          value -- new value
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+static void vbe_write(uint16_t index, uint16_t value) {
+    outw(index, VBE_DISPI_IOPORT_INDEX);
+    outw(value, VBE_DISPI_IOPORT_DATA);
+}
+
+/* vbe_read
+ *   DESCRIPTION: reads one DISPI register
+ *   INPUT: index -- register
+ *   OUTPUT: none
+ *   RETURN VALUE: register value
+ *   SIDE EFFECT: none
+ */
+static uint16_t vbe_read(uint16_t index) {
+    outw(index, VBE_DISPI_IOPORT_INDEX);
+    return inw(VBE_DISPI_IOPORT_DATA);
+}
+
+/* pci_read
+ *   DESCRIPTION: reads a dword of a bus 0 device's configuration space
+ *   INPUT: slot -- device number
+ *          reg -- register offset, dword aligned
+ *   OUTPUT: none
+ *   RETURN VALUE: register value, all ones if there is no device
+ *   SIDE EFFECT: none
+ */
+static uint32_t pci_read(uint32_t slot, uint32_t reg) {
+    outl(PCI_CONFIG_ENABLE | (slot << 11) | reg, PCI_CONFIG_ADDRESS);
+    return inl(PCI_CONFIG_DATA);
+}
+
+/* vga_save
+ *   DESCRIPTION: records the miscellaneous, sequencer, CRTC, graphics controller and
+ *                attribute registers of text mode
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: the display blanks until the attribute index gets VGA_AC_VIDEO_ON again
+ */
+static void vga_save(void) {
+    uint32_t i;
+
+    vga_text_regs.misc = inb(VGA_MISC_READ);
+    for (i = 0; i < VGA_NUM_SEQ; i++) {
+        outb(i, VGA_SEQ_INDEX);
+        vga_text_regs.seq[i] = inb(VGA_SEQ_DATA);
+    }
+    for (i = 0; i < VGA_NUM_CRTC; i++) {
+        outb(i, VGA_CRTC_PORT);
+        vga_text_regs.crtc[i] = inb(VGA_CRTC_DATA);
+    }
+    for (i = 0; i < VGA_NUM_GC; i++) {
+        outb(i, VGA_GC_INDEX);
+        vga_text_regs.gc[i] = inb(VGA_GC_DATA);
+    }
+    for (i = 0; i < VGA_NUM_AC; i++) {
+        inb(VGA_STATUS_PORT);
+        outb(i, VGA_AC_INDEX);
+        vga_text_regs.ac[i] = inb(VGA_AC_READ);
+    }
+    inb(VGA_STATUS_PORT);
+    outb(VGA_AC_VIDEO_ON, VGA_AC_INDEX);
+}
+
+/* vga_restore
+ *   DESCRIPTION: puts back the registers vga_save recorded. The start address and cursor
+ *                location are left alone: screen_show and set_cursor_pos own them and may
+ *                have moved them to another terminal meanwhile.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: reprograms the VGA
+ */
+static void vga_restore(void) {
+    uint32_t i;
+
+    outb(vga_text_regs.misc, VGA_MISC_WRITE);
+
+    outb(VGA_SEQ_RESET, VGA_SEQ_INDEX);
+    outb(VGA_SEQ_RESET_SYNC, VGA_SEQ_DATA);
+    for (i = 1; i < VGA_NUM_SEQ; i++) {
+        outb(i, VGA_SEQ_INDEX);
+        outb(vga_text_regs.seq[i], VGA_SEQ_DATA);
+    }
+    outb(VGA_SEQ_RESET, VGA_SEQ_INDEX);
+    outb(VGA_SEQ_RESET_RUN, VGA_SEQ_DATA);
+
+    /* lift the write protection of CRTC 0 ~ 7 first, the saved 0x11 brings it back */
+    outb(VGA_CRTC_VSYNC_END, VGA_CRTC_PORT);
+    outb(vga_text_regs.crtc[VGA_CRTC_VSYNC_END] & ~VGA_CRTC_PROTECT, VGA_CRTC_DATA);
+    for (i = 0; i < VGA_NUM_CRTC; i++) {
+        if (i >= VGA_CRTC_START_HIGH && i <= VGA_CRTC_CURSOR_LOW)
+            continue;
+        outb(i, VGA_CRTC_PORT);
+        outb(vga_text_regs.crtc[i], VGA_CRTC_DATA);
+    }
+
+    for (i = 0; i < VGA_NUM_GC; i++) {
+        outb(i, VGA_GC_INDEX);
+        outb(vga_text_regs.gc[i], VGA_GC_DATA);
+    }
+
+    inb(VGA_STATUS_PORT);
+    for (i = 0; i < VGA_NUM_AC; i++) {
+        outb(i, VGA_AC_INDEX);
+        outb(vga_text_regs.ac[i], VGA_AC_INDEX);
+    }
+    inb(VGA_STATUS_PORT);
+    outb(VGA_AC_VIDEO_ON, VGA_AC_INDEX);
+}
+
+/* vbe_enable
+ *   DESCRIPTION: switches the adapter to VBE_WIDTH x VBE_HEIGHT x VBE_BPP with the linear
+ *                framebuffer, showing it from VBE_FB_OFFSET, or back to VGA text mode with
+ *                the registers it had before
+ *   INPUT: on -- 1 for graphics, 0 for text
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+static void vbe_enable(uint8_t on) {
+    if (on == vbe_enabled)
+        return;
+    vbe_enabled = on;
+
+    if (!on) {
+        vbe_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_DISABLED);
+        vga_restore();
+        return;
+    }
+
+    vga_save();
+    vbe_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_DISABLED);
+    vbe_write(VBE_DISPI_INDEX_XRES, VBE_WIDTH);
+    vbe_write(VBE_DISPI_INDEX_YRES, VBE_HEIGHT);
+    vbe_write(VBE_DISPI_INDEX_BPP, VBE_BPP);
+    vbe_write(VBE_DISPI_INDEX_ENABLE, VBE_DISPI_ENABLED | VBE_DISPI_LFB_ENABLED | VBE_DISPI_NOCLEARMEM);
+    /* enabling resets the offsets */
+    vbe_write(VBE_DISPI_INDEX_X_OFFSET, 0);
+    vbe_write(VBE_DISPI_INDEX_Y_OFFSET, VBE_PAGE_ROWS(vbe_front));
+}
+
+/* vbe_copy
+ *   DESCRIPTION: copies a rectangle of the back buffer to a screen page
+ *   INPUT: page -- screen page in video memory
+ *          r -- rectangle, already clipped to the screen
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+static void vbe_copy(uint32_t page, const fb_rect_t * r) {
+    uint32_t offset = r->y * VBE_PITCH + r->x * (VBE_BPP / 8);
+    uint32_t len = r->w * (VBE_BPP / 8);
+    uint32_t h;
+
+    for (h = r->h; h > 0; h--, offset += VBE_PITCH)
+        memcpy((uint8_t *)vbe_lfb + VBE_PAGE_OFFSET(page) + offset,
+               (uint8_t *)VBE_BACK_PHYS + offset, len);
+}
+
+/* vbe_flip
+ *   DESCRIPTION: brings the hidden page up to date with the back buffer in r and flips to
+ *                it. Runs with interrupts on; a redraw asked for meanwhile (vbe_redraw) is
+ *                done before returning.
+ *   INPUT: r -- rectangle the caller changed, already clipped; may be empty
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: changes the page shown
+ */
+static void vbe_flip(fb_rect_t r) {
+    fb_rect_t copy;
+    uint32_t back;
+
+    vbe_busy = 1;
+    do {
+        if (vbe_redraw_full) {
+            vbe_redraw_full = 0;
+            r.x = 0;
+            r.y = 0;
+            r.w = VBE_WIDTH;
+            r.h = VBE_HEIGHT;
+        }
+
+        /* the bounding box of r and what the last flush drew on the other page */
+        copy = r;
+        if (vbe_stale.w > 0 && vbe_stale.h > 0) {
+            if (copy.w == 0 || copy.h == 0) {
+                copy = vbe_stale;
+            } else {
+                copy.x = (r.x < vbe_stale.x) ? r.x : vbe_stale.x;
+                copy.y = (r.y < vbe_stale.y) ? r.y : vbe_stale.y;
+                copy.w = ((r.x + r.w > vbe_stale.x + vbe_stale.w) ? r.x + r.w
+                                                                  : vbe_stale.x + vbe_stale.w) - copy.x;
+                copy.h = ((r.y + r.h > vbe_stale.y + vbe_stale.h) ? r.y + r.h
+                                                                  : vbe_stale.y + vbe_stale.h) - copy.y;
+            }
+        }
+        if (copy.w == 0 || copy.h == 0 || !vbe_enabled)
+            break;
+
+        back = vbe_front ^ 1;
+        vbe_copy(back, &copy);
+        vbe_write(VBE_DISPI_INDEX_Y_OFFSET, VBE_PAGE_ROWS(back));
+        vbe_front = back;
+        vbe_stale = r;
+        r.w = 0;
+    } while (vbe_redraw_full);
+    vbe_busy = 0;
+}
+
+/* vbe_redraw
+ *   DESCRIPTION: tasklet queued by vbe_show: copies the whole back buffer to the screen.
+ *                If a flush is copying right now, it does the whole screen instead.
+ *   INPUT: data -- unused
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+static void vbe_redraw(uint32_t data) {
+    fb_rect_t none = { 0, 0, 0, 0 };
+
+    vbe_redraw_full = 1;
+    if (!vbe_busy)
+        vbe_flip(none);
+}
+
+/* vbe_init
+ *   DESCRIPTION: looks for the Bochs graphics adapter and its framebuffer BAR, and maps
+ *                the framebuffer (uncached) and the back buffer for the kernel. Runs
+ *                before smp_init so every processor gets the mappings.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: sets vbe_present
+ */
+void vbe_init(void) {
+    uint16_t id = vbe_read(VBE_DISPI_INDEX_ID);
+    uint32_t slot;
+
+    if (id < VBE_DISPI_ID_MIN || id > VBE_DISPI_ID_MAX)
+        return;
+
+    for (slot = 0; slot < PCI_MAX_SLOTS; slot++) {
+        if (pci_read(slot, PCI_REG_ID) == BGA_PCI_ID) {
+            vbe_lfb = pci_read(slot, PCI_REG_BAR0) & PCI_BAR_MEM_MASK;
+            break;
+        }
+    }
+
+    /* both screen pages must fit the 4MB page mapped for the framebuffer */
+    if ((vbe_lfb & (_4MB - 1)) + VBE_PAGE_OFFSET(VBE_FB_PAGES) > _4MB)
+        return;
+
+    mmio_map(vbe_lfb);
+    kernel_map(VBE_BACK_PHYS);
+    tasklet_init(&vbe_tasklet, "vbe redraw", vbe_redraw, 0);
+    vbe_present = 1;
+}
+
+/* vbe_show
+ *   DESCRIPTION: called after the displayed terminal changed, with interrupts off. Graphics
+ *                are switched on when the display owner's terminal came up, and text mode
+ *                comes back otherwise. Copying the whole back buffer takes too long to do
+ *                here, so it is left to vbe_redraw.
+ *   INPUT: none
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: queues vbe_redraw
+ */
+void vbe_show(void) {
+    if (vbe_owner == VBE_NO_OWNER)
+        return;
+    if (vbe_term == cur_term) {
+        vbe_enable(1);
+        tasklet_schedule(&vbe_tasklet);
+    } else {
+        vbe_enable(0);
+    }
+}
+
+/* vbe_switch
+ *   DESCRIPTION: maps the back buffer for the display owner and unmaps it for any other
+ *                process about to run on this processor
+ *   INPUT: process -- process number about to run
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: changes this CPU's page directory
+ */
+void vbe_switch(uint8_t process) {
+    if (process == vbe_owner)
+        page_remap(VBE_USER_ADDR, VBE_BACK_PHYS);
+    else
+        page_unmap(VBE_USER_ADDR);
+}
+
+/* vbe_release
+ *   DESCRIPTION: a halting process gives up the display
+ *   INPUT: process -- process number halting
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: back to text mode, back buffer unmapped
+ */
+void vbe_release(uint8_t process) {
+    if (process != vbe_owner)
+        return;
+    vbe_enable(0);
+    page_unmap(VBE_USER_ADDR);
+    vbe_owner = VBE_NO_OWNER;
+}
+
+/* fbmap
+ *   DESCRIPTION: system call, the graphics variant of vidmap. Gives the calling process
+ *                the display: the back buffer is cleared and mapped at VBE_USER_ADDR, and
+ *                the screen switches to graphics whenever the caller's terminal is shown.
+ *   INPUT: info -- user buffer for the mode and back buffer address
+ *   OUTPUT: none
+ *   RETURN VALUE: 0 on success, -1 without an adapter, on a bad buffer or if another
+ *                 process owns the display
+ *   SIDE EFFECT: none
+ */
+int32_t fbmap(fb_info_t * info) {
+    pcb_t * pcb = get_pcb_ptr();
+
+    if (!vbe_present || bad_userspace_addr(info, sizeof(fb_info_t)))
+        return -1;
+    if (vbe_owner != VBE_NO_OWNER && vbe_owner != pcb->process_number)
+        return -1;
+
+    if (vbe_owner == VBE_NO_OWNER) {
+        vbe_owner = pcb->process_number;
+        vbe_term = pcb->term->id;
+        memset((void *)VBE_BACK_PHYS, 0, VBE_FB_SIZE);
+        vbe_switch(vbe_owner);
+        if (vbe_term == cur_term) {
+            vbe_enable(1);
+            vbe_redraw(0);
+        }
+    }
+
+    info->addr = VBE_USER_ADDR;
+    info->width = VBE_WIDTH;
+    info->height = VBE_HEIGHT;
+    info->bpp = VBE_BPP;
+    info->pitch = VBE_PITCH;
+    return 0;
+}
+
+/* fbflush
+ *   DESCRIPTION: system call, copies the part of the back buffer the caller changed to the
+ *                hidden screen page and flips to it (see vbe_flip), so the update shows
+ *                all at once. Nothing is copied while the owner's terminal is hidden; the
+ *                whole back buffer goes up when it is shown again.
+ *   INPUT: rect -- dirty rectangle, NULL for the whole screen
+ *   OUTPUT: none
+ *   RETURN VALUE: 0 on success, -1 if the caller does not own the display or on a bad buffer
+ *   SIDE EFFECT: none
+ */
+int32_t fbflush(const fb_rect_t * rect) {
+    fb_rect_t r = { 0, 0, VBE_WIDTH, VBE_HEIGHT };
+
+    if (vbe_owner != get_pcb_ptr()->process_number)
+        return -1;
+    if (rect != NULL) {
+        if (bad_userspace_addr(rect, sizeof(fb_rect_t)))
+            return -1;
+        r = *rect;
+    }
+
+    /* clip to the screen */
+    if (r.x >= VBE_WIDTH || r.y >= VBE_HEIGHT)
+        return 0;
+    if (r.w > VBE_WIDTH - r.x)
+        r.w = VBE_WIDTH - r.x;
+    if (r.h > VBE_HEIGHT - r.y)
+        r.h = VBE_HEIGHT - r.y;
+
+    if (vbe_enabled && r.w > 0 && r.h > 0)
+        vbe_flip(r);
+    return 0;
+}
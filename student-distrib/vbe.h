@@ -0,0 +1,124 @@
+#ifndef VBE_H_
+#define VBE_H_
+
+#include "types.h"
+
+/* ======================== CONSTANTS DEFINITION ======================== */
+/* Bochs / QEMU display interface (the "VBE DISPI" registers of the Bochs graphics adapter) */
+#define VBE_DISPI_IOPORT_INDEX	0x01CE
+#define VBE_DISPI_IOPORT_DATA	0x01CF
+#define VBE_DISPI_INDEX_ID		0
+#define VBE_DISPI_INDEX_XRES	1
+#define VBE_DISPI_INDEX_YRES	2
+#define VBE_DISPI_INDEX_BPP		3
+#define VBE_DISPI_INDEX_ENABLE	4
+#define VBE_DISPI_INDEX_X_OFFSET	8
+#define VBE_DISPI_INDEX_Y_OFFSET	9
+#define VBE_DISPI_ID_MIN		0xB0C2		/* first version with a linear framebuffer */
+#define VBE_DISPI_ID_MAX		0xB0CF
+#define VBE_DISPI_DISABLED		0x00
+#define VBE_DISPI_ENABLED		0x01
+#define VBE_DISPI_LFB_ENABLED	0x40
+#define VBE_DISPI_NOCLEARMEM	0x80
+#define VBE_DEFAULT_LFB			0xE0000000	/* where Bochs puts the framebuffer without PCI */
+
+/* PCI configuration mechanism #1, used to find the adapter's framebuffer BAR */
+#define PCI_CONFIG_ADDRESS		0xCF8
+#define PCI_CONFIG_DATA			0xCFC
+#define PCI_CONFIG_ENABLE		0x80000000
+#define PCI_MAX_SLOTS			32
+#define PCI_REG_ID				0x00
+#define PCI_REG_BAR0			0x10
+#define PCI_BAR_MEM_MASK		0xFFFFFFF0
+#define BGA_PCI_ID				0x11111234	/* device 0x1111, vendor 0x1234 */
+
+/* the one mode we set: 640x480, 32 bits per pixel (0x00RRGGBB) */
+#define VBE_WIDTH				640
+#define VBE_HEIGHT				480
+#define VBE_BPP					32
+#define VBE_PITCH				(VBE_WIDTH * VBE_BPP / 8)
+#define VBE_FB_SIZE				(VBE_PITCH * VBE_HEIGHT)
+/* The LFB starts at VRAM offset 0, where the text planes and the font live; the visible
+ * screen starts VBE_FB_ROWS rows further down so graphics never overwrite them */
+#define VGA_VRAM_SIZE			0x40000		/* 4 planes x 64KB */
+#define VBE_FB_ROWS				((VGA_VRAM_SIZE + VBE_PITCH - 1) / VBE_PITCH)
+#define VBE_FB_OFFSET			(VBE_FB_ROWS * VBE_PITCH)
+/* two screens after that: fbflush draws into the hidden one and flips the Y offset to it */
+#define VBE_FB_PAGES			2
+#define VBE_PAGE_ROWS(page)		(VBE_FB_ROWS + (page) * VBE_HEIGHT)
+#define VBE_PAGE_OFFSET(page)	(VBE_FB_OFFSET + (page) * VBE_FB_SIZE)
+
+/* the back buffer: one 4MB page of RAM, mapped for the owning process at VBE_USER_ADDR */
+#define VBE_BACK_PHYS			_100MB
+#define VBE_USER_ADDR			_144MB
+#define VBE_NO_OWNER			0xFF
+
+/* VGA registers the adapter changes when VBE is enabled, saved and restored around it */
+#define VGA_MISC_READ			0x3CC
+#define VGA_MISC_WRITE			0x3C2
+#define VGA_SEQ_INDEX			0x3C4
+#define VGA_SEQ_DATA			0x3C5
+#define VGA_GC_INDEX			0x3CE
+#define VGA_GC_DATA				0x3CF
+#define VGA_AC_INDEX			0x3C0		/* index and data writes alternate on one port */
+#define VGA_AC_READ				0x3C1
+#define VGA_CRTC_DATA			0x3D5
+#define VGA_STATUS_PORT			0x3DA		/* reading it resets the attribute flip-flop */
+#define VGA_NUM_SEQ				5
+#define VGA_NUM_CRTC			25
+#define VGA_NUM_GC				9
+#define VGA_NUM_AC				21
+#define VGA_AC_VIDEO_ON			0x20		/* attribute index bit: palette back to the display */
+#define VGA_SEQ_RESET			0x00
+#define VGA_SEQ_RESET_SYNC		0x01		/* synchronous reset while the clocking changes */
+#define VGA_SEQ_RESET_RUN		0x03
+#define VGA_CRTC_VSYNC_END		0x11		/* bit 7 write-protects CRTC 0 ~ 7 */
+#define VGA_CRTC_PROTECT		0x80
+#define VGA_CRTC_START_HIGH		0x0C		/* 0x0C ~ 0x0F: start address and cursor, owned by lib.c */
+#define VGA_CRTC_CURSOR_LOW		0x0F
+
+#ifndef ASM
+
+/* filled in by fbmap */
+typedef struct {
+	uint32_t addr;			/* back buffer in user space */
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+	uint32_t pitch;			/* bytes per row */
+} fb_info_t;
+
+/* part of the back buffer fbflush copies to the screen */
+typedef struct {
+	uint32_t x;
+	uint32_t y;
+	uint32_t w;
+	uint32_t h;
+} fb_rect_t;
+
+/* ======================================================================= */
+
+extern uint8_t vbe_present;
+
+
+/* ======================== FUNCTION DECLARATION ======================== */
+/* find the adapter and map its framebuffer and the back buffer (before smp_init) */
+void vbe_init(void);
+
+/* the displayed terminal changed: show graphics if its process owns them, text otherwise.
+ * Only switches the mode; the screen is redrawn by a tasklet, with interrupts on */
+void vbe_show(void);
+
+/* context switch: the back buffer is only mapped for its owner */
+void vbe_switch(uint8_t process);
+
+/* process is halting, give the display back to text mode */
+void vbe_release(uint8_t process);
+
+/* system calls: take over the display / copy a dirty rectangle to the screen */
+int32_t fbmap(fb_info_t * info);
+int32_t fbflush(const fb_rect_t * rect);
+
+#endif /* ASM */
+
+#endif
@@ -0,0 +1,50 @@
+#include "waitqueue.h"
+#include "scheduler.h"
+
+/* init_wait_queue
+ *   DESCRIPTION: empties a wait queue
+ *   INPUT: wq -- queue to initialize
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: none
+ */
+void init_wait_queue(wait_queue_t * wq) {
+    wq->waiters = 0;
+}
+
+/* sleep_on
+ *   DESCRIPTION: adds the current process to wq and blocks it. The scheduler runs
+ *                somebody else (or halts the CPU) until wake_up is called on wq.
+ *                Must be called with interrupts disabled; returns with them disabled.
+ *   INPUT: wq -- queue to sleep on
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: context switches away from the current process
+ */
+void sleep_on(wait_queue_t * wq) {
+    pcb_t * pcb = get_pcb_ptr_process(terminal[cur_active_terminal].apn);
+
+    wq->waiters |= (1 << pcb->process_number);
+    sched_block();
+}
+
+/* wake_up
+ *   DESCRIPTION: makes every process sleeping on wq runnable. Safe to call from
+ *                interrupt handlers.
+ *   INPUT: wq -- queue to wake
+ *   OUTPUT: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECT: empties wq
+ */
+void wake_up(wait_queue_t * wq) {
+    uint32_t i;
+    uint32_t flags;
+
+    cli_and_save(flags);
+    for (i = 0; i < NUM_MAX_PROCESSES; i++) {
+        if (wq->waiters & (1 << i))
+            sched_wakeup(i);
+    }
+    wq->waiters = 0;
+    restore_flags(flags);
+}
@@ -0,0 +1,33 @@
+#ifndef WAITQUEUE_H_
+#define WAITQUEUE_H_
+
+#include "types.h"
+#include "lib.h"
+
+/* A wait queue is the set of processes sleeping on one event. There are at
+ * most NUM_MAX_PROCESSES processes, so a bitmask of process numbers is enough. */
+typedef struct {
+	volatile uint32_t waiters;	/* bit n set: process n sleeps here */
+} wait_queue_t;
+
+/* empty a wait queue */
+void init_wait_queue(wait_queue_t * wq);
+
+/* put the current process to sleep on wq; interrupts must be off */
+void sleep_on(wait_queue_t * wq);
+
+/* make every process sleeping on wq runnable again */
+void wake_up(wait_queue_t * wq);
+
+/* Sleep on wq until cond holds. cond is checked with interrupts off so a
+ * wake_up from an interrupt handler can't slip in between check and sleep. */
+#define wait_event(wq, cond)            \
+do {                                    \
+	uint32_t _wait_flags;               \
+	cli_and_save(_wait_flags);          \
+	while (!(cond))                     \
+		sleep_on(wq);                   \
+	restore_flags(_wait_flags);         \
+} while (0)
+
+#endif
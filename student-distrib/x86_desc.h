@@ -15,6 +15,11 @@
 #define USER_DS     0x002B
 #define KERNEL_TSS  0x0030
 #define KERNEL_LDT  0x0038
+#define KERNEL_AP_TSS 0x0040    /* first application processor's TSS, one more per CPU after it */
+#define KERNEL_PERCPU (KERNEL_AP_TSS + (MAX_CPUS - 1) * 8)   /* GS of CPU 0, one more per CPU after it */
+
+/* Most processors the kernel brings up (see smp.c) */
+#define MAX_CPUS    4
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
@@ -122,6 +127,8 @@ extern uint32_t ldt;
 
 extern uint32_t tss_size;
 extern seg_desc_t tss_desc_ptr;
+extern seg_desc_t ap_tss_desc_ptr[MAX_CPUS - 1];
+extern seg_desc_t percpu_desc_ptr[MAX_CPUS];
 extern tss_t tss;
 
 /* Sets runtime-settable parameters in the GDT entry for the LDT */
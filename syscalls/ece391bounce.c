@@ -0,0 +1,101 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define DEFAULT_FRAMES  256
+#define RTC_FREQ        32      /* frames per second */
+#define BOX_SIZE        48
+#define BOX_COLOR       0x00FFC000
+#define BACKGROUND      0x00102040
+#define BUFSIZE         32
+
+static struct fb_info fb;
+
+/* fills a rectangle of the back buffer with one color */
+static void fill (uint32_t x, uint32_t y, uint32_t w, uint32_t h, uint32_t color)
+{
+    uint32_t row, col;
+    uint32_t* line;
+
+    for (row = y; row < y + h; row++) {
+        line = (uint32_t*)(fb.addr + row * fb.pitch);
+        for (col = x; col < x + w; col++)
+            line[col] = color;
+    }
+}
+
+int main ()
+{
+    struct fb_rect dirty;
+    int32_t frames = DEFAULT_FRAMES;
+    int32_t frame, i, rtc_fd, garbage;
+    uint8_t key;
+    int32_t x = 0, y = 0, dx = 5, dy = 3;
+    uint8_t buf[BUFSIZE];
+
+    if (0 == ece391_getargs(buf, BUFSIZE)) {
+        frames = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            frames = frames * 10 + (buf[i] - '0');
+        if (frames <= 0)
+            frames = DEFAULT_FRAMES;
+    }
+
+    if (-1 == ece391_fbmap(&fb)) {
+        ece391_fdputs(1, (uint8_t*)"no framebuffer\n");
+        return 2;
+    }
+
+    rtc_fd = ece391_open((uint8_t*)"rtc");
+    garbage = RTC_FREQ;
+    if (-1 == rtc_fd || -1 == ece391_write(rtc_fd, &garbage, 4)) {
+        ece391_fdputs(1, (uint8_t*)"could not set up the rtc\n");
+        return 3;
+    }
+
+    /* keys are polled once a frame: raw, and read returns at once */
+    ece391_ioctl(0, TC_SETMODE, TC_RAW);
+    ece391_ioctl(0, TC_SETVMIN, 0);
+    ece391_ioctl(0, FIONBIO, 1);
+
+    fill(0, 0, fb.width, fb.height, BACKGROUND);
+    ece391_fbflush(0);
+
+    for (frame = 0; frame < frames; frame++) {
+        /* q quits early */
+        if (1 == ece391_read(0, &key, 1) && 'q' == key)
+            break;
+
+        /* the box's old and new position make up the dirty rectangle */
+        dirty.x = x;
+        dirty.y = y;
+        fill(x, y, BOX_SIZE, BOX_SIZE, BACKGROUND);
+
+        x += dx;
+        y += dy;
+        if (x < 0 || x + BOX_SIZE > (int32_t)fb.width) {
+            dx = -dx;
+            x += 2 * dx;
+        }
+        if (y < 0 || y + BOX_SIZE > (int32_t)fb.height) {
+            dy = -dy;
+            y += 2 * dy;
+        }
+        fill(x, y, BOX_SIZE, BOX_SIZE, BOX_COLOR);
+
+        if ((uint32_t)x < dirty.x)
+            dirty.x = x;
+        if ((uint32_t)y < dirty.y)
+            dirty.y = y;
+        dirty.w = BOX_SIZE + (dx < 0 ? -dx : dx);
+        dirty.h = BOX_SIZE + (dy < 0 ? -dy : dy);
+        ece391_fbflush(&dirty);
+
+        /* one frame per RTC interrupt */
+        ece391_read(rtc_fd, &garbage, 4);
+    }
+
+    ece391_close(rtc_fd);
+    return 0;
+}
@@ -5,9 +5,31 @@
 
 #define BUFSIZE 1024
 
+/* milliseconds since boot */
+static uint32_t now_ms (void)
+{
+    struct timespec ts;
+
+    if (-1 == ece391_gettime(&ts, sizeof(ts)))
+        return 0;
+    return ts.sec * 1000 + ts.nsec / 1000000;
+}
+
+/* results also go to the serial port, when there is one, so headless runs can log them */
+static int32_t serial_fd = -1;
+
+static void report (uint8_t* s)
+{
+    ece391_fdputs(1, s);
+    if (-1 != serial_fd)
+        ece391_fdputs(serial_fd, s);
+}
+
 int main ()
 {
     uint32_t i, cnt, max = 0;
+    uint32_t bytes = 0, start, ms;
+    struct vga_stats before, after;
     uint8_t buf[BUFSIZE];
 
     ece391_fdputs(1, (uint8_t*)"Enter the Test Number: (0): 100, (1): 10000, (2): 100000\n");
@@ -34,12 +56,50 @@ int main ()
         }
     }
 
+    if (-1 == ece391_vga_stats(&before, sizeof(before)))
+        before.port_writes = before.cursor_updates = 0;
+    start = now_ms();
     for (i = 0; i < max; i++) {
         ece391_itoa(i+1, buf, 10);
         ece391_fdputs(1, buf);
         ece391_fdputs(1, (uint8_t*)"\n");
+        bytes += ece391_strlen(buf) + 1;
+    }
+    ms = now_ms() - start;
+    if (-1 == ece391_vga_stats(&after, sizeof(after)))
+        after = before;
+
+    /* report the terminal output rate */
+    serial_fd = ece391_open((uint8_t*)"serial");
+    ece391_itoa(bytes, buf, 10);
+    report(buf);
+    report((uint8_t*)" bytes in ");
+    ece391_itoa(ms, buf, 10);
+    report(buf);
+    report((uint8_t*)" ms");
+    if (ms != 0) {
+        report((uint8_t*)", ");
+        ece391_itoa(bytes * 1000 / ms, buf, 10);
+        report(buf);
+        report((uint8_t*)" bytes/sec");
+    }
+    report((uint8_t*)"\n");
+
+    /* and what it cost in VGA port writes */
+    ece391_itoa(after.port_writes - before.port_writes, buf, 10);
+    report(buf);
+    report((uint8_t*)" port writes for ");
+    ece391_itoa(after.cursor_updates - before.cursor_updates, buf, 10);
+    report(buf);
+    report((uint8_t*)" cursor moves, ");
+    if (bytes != 0) {
+        ece391_itoa((after.port_writes - before.port_writes) * 1000 / bytes, buf, 10);
+        report(buf);
     }
+    report((uint8_t*)" per 1000 bytes\n");
 
+    if (-1 != serial_fd)
+        ece391_close(serial_fd);
     return 0;
 }
 
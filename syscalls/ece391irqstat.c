@@ -0,0 +1,67 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE         1024
+#define RTC_FREQ        2       /* two RTC reads between prints: once a second */
+
+/* copies the interrupts file to the terminal, 0 on success */
+static int32_t show (void)
+{
+    int32_t fd, cnt;
+    uint8_t buf[BUFSIZE];
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"interrupts"))) {
+        ece391_fdputs (1, (uint8_t*)"no interrupts file\n");
+        return 2;
+    }
+
+    while (0 != (cnt = ece391_read (fd, buf, BUFSIZE))) {
+        if (-1 == cnt || -1 == ece391_write (1, buf, cnt)) {
+            ece391_close (fd);
+            return 3;
+        }
+    }
+
+    ece391_close (fd);
+    return 0;
+}
+
+/* irqstat [rounds]: prints the per-vector interrupt counts and handler times,
+   again every second for the given number of rounds */
+int main ()
+{
+    int32_t rounds = 1;
+    int32_t round, i, rtc_fd, garbage, ret;
+    uint8_t buf[BUFSIZE];
+
+    if (0 == ece391_getargs (buf, BUFSIZE)) {
+        rounds = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            rounds = rounds * 10 + (buf[i] - '0');
+        if (rounds <= 0)
+            rounds = 1;
+    }
+
+    if (0 != (ret = show ()) || 1 == rounds)
+        return ret;
+
+    rtc_fd = ece391_open ((uint8_t*)"rtc");
+    garbage = RTC_FREQ;
+    if (-1 == rtc_fd || -1 == ece391_write (rtc_fd, &garbage, 4)) {
+        ece391_fdputs (1, (uint8_t*)"could not set up the rtc\n");
+        return 3;
+    }
+
+    for (round = 2; round <= rounds; round++) {
+        for (i = 0; i < RTC_FREQ; i++)
+            ece391_read (rtc_fd, &garbage, 4);
+        ece391_fdputs (1, (uint8_t*)"\n");
+        if (0 != (ret = show ()))
+            break;
+    }
+
+    ece391_close (rtc_fd);
+    return ret;
+}
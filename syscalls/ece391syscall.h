@@ -21,6 +21,105 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_set_priority (int32_t prio);
+extern int32_t ece391_sched_stats (void* buf, int32_t nbytes);
+extern int32_t ece391_tick_stats (void* buf, int32_t nbytes);
+extern int32_t ece391_gettime (void* buf, int32_t nbytes);
+extern int32_t ece391_proc_stats (void* buf, int32_t nbytes);
+extern int32_t ece391_vga_stats (void* buf, int32_t nbytes);
+extern int32_t ece391_fbmap (void* info);
+extern int32_t ece391_fbflush (const void* rect);
+extern int32_t ece391_ioctl (int32_t fd, int32_t cmd, int32_t arg);
+
+/* 
+ * Scheduler priority levels: 0 is the highest. set_priority returns the
+ * previous level; sched_stats fills one entry per level.
+ */
+#define SCHED_LEVELS 3
+
+struct sched_level_stats {
+	uint32_t ticks;
+	uint32_t dispatches;
+	uint32_t promotions;
+	uint32_t demotions;
+};
+
+/* tick_stats: PIT interrupts taken vs. periodic ticks that were skipped */
+struct tick_stats {
+	uint32_t taken;
+	uint32_t elapsed;
+	uint32_t avoided;
+};
+
+/* gettime: monotonic time since boot */
+struct timespec {
+	uint32_t sec;
+	uint32_t nsec;
+};
+
+/* proc_stats: one entry per live process, returns the number of entries */
+#define PROC_STAT_RUNNING  0
+#define PROC_STAT_RUNNABLE 1
+#define PROC_STAT_BLOCKED  2
+#define PROC_STAT_WAITING  3
+
+struct proc_stat {
+	uint32_t pid;
+	uint32_t parent;
+	uint32_t term;
+	uint32_t state;
+	uint32_t level;
+	uint32_t utime_ms;
+	uint32_t stime_ms;
+	uint32_t nvcsw;
+	uint32_t nivcsw;
+	uint32_t nsyscalls;
+	uint8_t name[32];
+};
+
+/* vga_stats: terminal output and the VGA port writes it cost, counted since boot */
+struct vga_stats {
+	uint32_t bytes;
+	uint32_t port_writes;
+	uint32_t cursor_updates;
+	uint32_t cursor_flushes;
+};
+
+/*
+ * fbmap: take over the display in 32 bit graphics mode. Draw into the back
+ * buffer at addr (0x00RRGGBB pixels, pitch bytes per row) and hand the
+ * changed rectangle to fbflush (NULL for all of it) to put it on screen.
+ */
+struct fb_info {
+	uint32_t addr;
+	uint32_t width;
+	uint32_t height;
+	uint32_t bpp;
+	uint32_t pitch;
+};
+
+struct fb_rect {
+	uint32_t x;
+	uint32_t y;
+	uint32_t w;
+	uint32_t h;
+};
+
+/*
+ * ioctl on fd 0: the terminal's line discipline. TC_RAW hands every key to
+ * read as it is typed, without echo; read then waits for VMIN keys, or VTIME
+ * tenths of a second (between keys, once one arrived, when VMIN is set too).
+ * FIONBIO makes read return at once, 0 when there is nothing to read; it
+ * also works on the "serial" pseudo file (COM1), where writes stop waiting
+ * for room too.
+ * Canonical mode comes back when the process that changed it halts.
+ */
+#define TC_SETMODE	1
+#define TC_SETVMIN	2
+#define TC_SETVTIME	3
+#define FIONBIO		4
+#define TC_CANON	0
+#define TC_RAW		1
 
 enum signums {
 	DIV_ZERO = 0,
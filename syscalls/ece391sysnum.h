@@ -11,5 +11,14 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SET_PRIORITY 11
+#define SYS_SCHED_STATS  12
+#define SYS_TICK_STATS   13
+#define SYS_GETTIME      14
+#define SYS_PROC_STATS   15
+#define SYS_VGA_STATS    16
+#define SYS_FBMAP        17
+#define SYS_FBFLUSH      18
+#define SYS_IOCTL        19
 
 #endif /* ECE391SYSNUM_H */
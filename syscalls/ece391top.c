@@ -0,0 +1,164 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define SCREEN_COLS     80
+#define SCREEN_ROWS     25
+#define ATTRIB          0x7
+#define MAX_PROCS       6
+#define TABLE_ROW       3
+#define DEFAULT_ROUNDS  10
+#define RTC_FREQ        2       /* two RTC reads per refresh: once a second */
+#define BUFSIZE         32
+
+static uint8_t* screen;
+
+/* writes a string at row, col */
+static void put_str (int32_t row, int32_t col, const uint8_t* s)
+{
+    while ('\0' != *s && col < SCREEN_COLS) {
+        screen[(row * SCREEN_COLS + col) << 1] = *s++;
+        screen[((row * SCREEN_COLS + col) << 1) + 1] = ATTRIB;
+        col++;
+    }
+}
+
+/* writes a number right aligned in width columns ending before col + width */
+static void put_num (int32_t row, int32_t col, int32_t width, uint32_t value)
+{
+    uint8_t buf[BUFSIZE];
+    int32_t len;
+
+    ece391_itoa(value, buf, 10);
+    len = ece391_strlen(buf);
+    put_str(row, col + (len < width ? width - len : 0), buf);
+}
+
+/* blanks a whole row */
+static void clear_row (int32_t row)
+{
+    int32_t col;
+
+    for (col = 0; col < SCREEN_COLS; col++) {
+        screen[(row * SCREEN_COLS + col) << 1] = ' ';
+        screen[((row * SCREEN_COLS + col) << 1) + 1] = ATTRIB;
+    }
+}
+
+/* milliseconds since boot */
+static uint32_t now_ms (void)
+{
+    struct timespec ts;
+
+    if (-1 == ece391_gettime(&ts, sizeof(ts)))
+        return 0;
+    return ts.sec * 1000 + ts.nsec / 1000000;
+}
+
+int main ()
+{
+    static const uint8_t states[] = "RrBW";
+    struct proc_stat stats[MAX_PROCS];
+    uint32_t last_cpu[MAX_PROCS];   /* by process slot, the pid proc_stats reports */
+    uint8_t seen[MAX_PROCS];
+    uint32_t last_ms, ms, busy, total;
+    int32_t rounds = DEFAULT_ROUNDS;
+    int32_t round, n, i, row, rtc_fd, garbage, slot;
+    uint8_t buf[BUFSIZE];
+
+    if (0 == ece391_getargs(buf, BUFSIZE)) {
+        rounds = 0;
+        for (i = 0; buf[i] >= '0' && buf[i] <= '9'; i++)
+            rounds = rounds * 10 + (buf[i] - '0');
+        if (rounds <= 0)
+            rounds = DEFAULT_ROUNDS;
+    }
+
+    if (-1 == ece391_vidmap(&screen)) {
+        ece391_fdputs(1, (uint8_t*)"vidmap failed\n");
+        return 2;
+    }
+
+    rtc_fd = ece391_open((uint8_t*)"rtc");
+    garbage = RTC_FREQ;
+    if (-1 == rtc_fd || -1 == ece391_write(rtc_fd, &garbage, 4)) {
+        ece391_fdputs(1, (uint8_t*)"could not set up the rtc\n");
+        return 3;
+    }
+
+    for (row = 0; row < SCREEN_ROWS; row++)
+        clear_row(row);
+    for (i = 0; i < MAX_PROCS; i++)
+        last_cpu[i] = 0;
+    last_ms = now_ms();
+
+    for (round = 1; round <= rounds; round++) {
+        for (i = 0; i < RTC_FREQ; i++)
+            ece391_read(rtc_fd, &garbage, 4);
+
+        n = ece391_proc_stats(stats, sizeof(stats));
+        if (-1 == n) {
+            ece391_fdputs(1, (uint8_t*)"proc_stats failed\n");
+            return 3;
+        }
+        ms = now_ms();
+
+        clear_row(0);
+        put_str(0, 0, (uint8_t*)"top:");
+        put_num(0, 5, 1, n);
+        put_str(0, 7, (uint8_t*)"processes, up");
+        put_num(0, 21, 1, ms / 1000);
+        put_str(0, 21 + ece391_strlen(ece391_itoa(ms / 1000, buf, 10)), (uint8_t*)"s");
+        put_str(0, 60, (uint8_t*)"refresh");
+        put_num(0, 68, 3, round);
+        put_str(0, 71, (uint8_t*)"/");
+        put_num(0, 72, 1, rounds);
+
+        clear_row(TABLE_ROW - 1);
+        put_str(TABLE_ROW - 1, 0,
+            (uint8_t*)"PID PPID TTY S LVL   USER ms    SYS ms  %CPU   VCSW   ICSW SYSCALLS NAME");
+
+        for (i = 0; i < MAX_PROCS; i++)
+            clear_row(TABLE_ROW + i);
+
+        for (i = 0; i < MAX_PROCS; i++)
+            seen[i] = 0;
+
+        for (i = 0; i < n && i < MAX_PROCS; i++) {
+            row = TABLE_ROW + i;
+            slot = stats[i].pid;
+            total = stats[i].utime_ms + stats[i].stime_ms;
+            busy = 0;
+            if (slot >= 0 && slot < MAX_PROCS) {
+                seen[slot] = 1;
+                if (ms > last_ms && total >= last_cpu[slot])
+                    busy = (total - last_cpu[slot]) * 100 / (ms - last_ms);
+                last_cpu[slot] = total;
+            }
+
+            put_num(row, 0, 3, stats[i].pid);
+            put_num(row, 4, 4, stats[i].parent);
+            put_num(row, 9, 3, stats[i].term);
+            buf[0] = states[stats[i].state & 3];
+            buf[1] = '\0';
+            put_str(row, 13, buf);
+            put_num(row, 15, 3, stats[i].level);
+            put_num(row, 19, 10, stats[i].utime_ms);
+            put_num(row, 29, 10, stats[i].stime_ms);
+            put_num(row, 39, 5, busy);
+            put_num(row, 45, 6, stats[i].nvcsw);
+            put_num(row, 52, 6, stats[i].nivcsw);
+            put_num(row, 59, 8, stats[i].nsyscalls);
+            put_str(row, 68, stats[i].name);
+        }
+        /* a slot that was free this round starts over when it is reused */
+        for (i = 0; i < MAX_PROCS; i++)
+            if (!seen[i])
+                last_cpu[i] = 0;
+        last_ms = ms;
+    }
+
+    ece391_close(rtc_fd);
+    return 0;
+}